@@ -11,18 +11,13 @@ typedef struct {
     HWND*       handle;
     HDC         hdc;
     bool        initialized;
+    SrArena     frame_arena;
 } SrWindowContext;
 
 
 static SrWindowContext sr_context;
 
 
-static sr_u32 sr_pack_vec4_to_u32(sr_vec4 in);
-static sr_vec4 sr_rgba_to_argb(sr_vec4 in);
-
-
-
-
 /**
 * sr_init - initialize the win32 api context
 *
@@ -62,25 +57,37 @@ inline bool sr_present(SrFramebuffer* fb) {
         return false;
 
 
-    BITMAPINFO bmi {};
-    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-    bmi.bmiHeader.biWidth = width;
-    bmi.bmiHeader.biHeight = height;
-    bmi.bmiHeader.biPlanes = 1;
-    bmi.bmiHeader.biBitCount = 32;
-    bmi.bmiHeader.biCompression = BI_RGB;
-
-    sr_u32 size = width * height;
-
-    sr_u32* buffer = (sr_u32*)malloc(size * 4);
-
-    for (sr_u32 i = 0; i < size; i++) {
-        buffer[i] = sr_pack_vec4_to_u32(sr_rgba_to_argb(*(sr_vec4*)&fb->color_buffer[i]));
+    // 32-bit pixels with the channels in r, g, b, a byte order, which is
+    // the SR_COLOR_FORMAT_RGBA8_UNORM layout, so those framebuffers are
+    // handed to gdi without any conversion
+    struct {
+        BITMAPINFOHEADER header;
+        DWORD            masks[3];
+    } bmi {};
+
+    bmi.header.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.header.biWidth = width;
+    bmi.header.biHeight = height;
+    bmi.header.biPlanes = 1;
+    bmi.header.biBitCount = 32;
+    bmi.header.biCompression = BI_BITFIELDS;
+    bmi.masks[0] = 0x000000ff;
+    bmi.masks[1] = 0x0000ff00;
+    bmi.masks[2] = 0x00ff0000;
+
+    void* pixels = fb->color_buffer;
+
+    // the staging buffer comes from an arena that is reset every frame
+    // so presenting doesn't allocate once the arena is big enough
+    if (fb->spec.color_format != SR_COLOR_FORMAT_RGBA8_UNORM) {
+        pixels = sr_arena_alloc(&sr_context.frame_arena, width * height * 4);
+        sr_framebuffer_resolve_rgba8(fb, (sr_u32*)pixels);
     }
 
-    StretchDIBits(sr_context.hdc, 0, 0, width, height, 0, 0, width, height, buffer, &bmi, DIB_RGB_COLORS, SRCCOPY);
+    StretchDIBits(sr_context.hdc, 0, 0, width, height, 0, 0, width, height, pixels, 
+                  (BITMAPINFO*)&bmi, DIB_RGB_COLORS, SRCCOPY);
 
-    free(buffer);
+    sr_arena_reset(&sr_context.frame_arena);
 
     return true;
 }
@@ -89,28 +96,4 @@ inline bool sr_present(SrFramebuffer* fb) {
 
 
 
-static inline sr_u32 sr_pack_vec4_to_u32(sr_vec4 in) {
-
-    sr_u32 r = (sr_u32)(in.x * 255.0f);
-    sr_u32 g = (sr_u32)(in.y * 255.0f);
-    sr_u32 b = (sr_u32)(in.z * 255.0f);
-    sr_u32 a = (sr_u32)(in.w * 255.0f);
-
-    return r << 24 | g << 16 | b << 8 | a;
-}
-
-
-static inline sr_vec4 sr_rgba_to_argb(sr_vec4 in) {
-    sr_vec4 out;
-
-    out.x = in.w;
-    out.y = in.x;
-    out.z = in.y;
-    out.w = in.z;
-
-    return out;
-}
-
-
-
 #endif // __SR_WIN32_BACKEND_IMPL
\ No newline at end of file
@@ -0,0 +1,2835 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#define __SOFTWARE_RENDERER_IMPLEMENTATION
+#include "../src/software_renderer.h"
+
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "ext/utils.h"
+#include <vector>
+#include <string>
+#include <map>
+#include <chrono>
+
+
+// headless benchmarks for the renderer, every benchmark renders into an
+// offscreen framebuffer and prints its numbers to the console
+
+u32 width  = 800;
+u32 height = 600;
+u32 frames = 20;
+
+
+
+struct Vertex {
+    vec3 pos;
+    vec3 normal;
+    vec2 uv;
+};
+
+struct Variant {
+    vec3 world_pos;
+    vec3 normal;
+    vec2 uv;
+};
+
+struct UniformBuffer {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    vec3 view_pos;
+};
+
+
+
+static Vertex obj_to_vertex(objl::Vertex& in) {
+    Vertex vert;
+    vert.pos    = {in.Position.X, in.Position.Y, -in.Position.Z};
+    vert.normal = {in.Normal.X, in.Normal.Y, -in.Normal.Z};
+    vert.uv     = {in.TextureCoordinate.X, in.TextureCoordinate.Y};
+    return vert;
+}
+
+
+
+// expands the indices into a flat triangle list, the same way the other samples do
+void load_obj_file(const char* file_path, std::vector<Vertex>* out) {
+    objl::Loader loader;
+
+    if (!loader.LoadFile(file_path)) {
+        printf("Failed to load the model (%s)\n", file_path);
+        return;
+    }
+
+    for (auto& mesh : loader.LoadedMeshes)
+        for (u32 idx : mesh.Indices)
+            out->push_back(obj_to_vertex(mesh.Vertices[idx]));
+}
+
+
+
+// the obj loader emits one vertex per face corner, so identical vertices
+// are welded together to get an index buffer with shared vertices
+void load_obj_file_indexed(const char* file_path, std::vector<Vertex>* vertices, std::vector<u32>* indices) {
+    objl::Loader loader;
+
+    if (!loader.LoadFile(file_path)) {
+        printf("Failed to load the model (%s)\n", file_path);
+        return;
+    }
+
+    std::map<std::string, u32> unique;
+
+    for (auto& mesh : loader.LoadedMeshes) {
+        for (u32 idx : mesh.Indices) {
+            Vertex vert = obj_to_vertex(mesh.Vertices[idx]);
+            std::string key((const char*)&vert, sizeof(Vertex));
+
+            auto it = unique.find(key);
+            if (it == unique.end()) {
+                it = unique.insert({key, (u32)vertices->size()}).first;
+                vertices->push_back(vert);
+            }
+
+            indices->push_back(it->second);
+        }
+    }
+}
+
+
+
+sr_vec4 vertex_shader(SrVertex in, SrVariant out, SrGlobalRegistry* reg) {
+    Vertex* vertex = (Vertex*)in;
+
+    UniformBuffer& ubo = *sr_get_uniform_buffer(UniformBuffer, reg, 0);
+
+    vec4 world_pos = ubo.model * vec4(vertex->pos, 1.0f);
+
+    Variant variant;
+    variant.world_pos = vec3(world_pos.x, world_pos.y, world_pos.z);
+    variant.normal    = mat3(ubo.model) * vertex->normal;
+    variant.uv        = vertex->uv;
+
+    sr_upload_variant(out, variant);
+
+    vec4 pos = ubo.proj * ubo.view * world_pos;
+    return {pos.x, pos.y, pos.z, pos.w};
+}
+
+
+
+sr_vec4 lambert_pixel_shader(SrVariant variants, SrGlobalRegistry* reg) {
+    Variant* in = (Variant*)variants;
+
+    UniformBuffer& ubo = *sr_get_uniform_buffer(UniformBuffer, reg, 0);
+
+    sr_vec4 albedo = sr_texel(reg, 0, in->uv.x, in->uv.y);
+
+    vec3 normal    = normalize(in->normal);
+    vec3 light_dir = normalize(ubo.view_pos - in->world_pos);
+    f32 diffuse    = max(dot(normal, light_dir), 0.0f) + 0.03f;
+
+    return {albedo.x * diffuse, albedo.y * diffuse, albedo.z * diffuse, 1.0f};
+}
+
+
+
+static f64 time_now_ms() {
+    using namespace std::chrono;
+    return duration<f64, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+
+
+static u32 vertex_shader_invocations(SrPipeline* pipeline) {
+    u32 count = 0;
+    for (u32 i = 0; i < pipeline->stats.worker_count; i++)
+        count += pipeline->stats.workers[i].vertices_count;
+    return count;
+}
+
+
+
+static SrPipelineSpec default_pipeline_spec(SrFramebuffer* framebuffer) {
+    SrDepthInfo depth_info {};
+    depth_info.depth_test_enabled  = true;
+    depth_info.depth_write_enabled = true;
+    depth_info.depth_compare_op    = SR_COMPARE_OP_LESS_OR_EQUAL;
+    depth_info.min_depth           = 0.0f;
+    depth_info.max_depth           = 1.0f;
+
+    SrRasterizerInfo rasterizer_info {};
+    rasterizer_info.front_face   = SR_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer_info.cull_mode    = SR_CULL_MODE_BACK_FACE;
+    rasterizer_info.polygon_mode = SR_POLYGON_MODE_FILL;
+
+    SrVertexInputInfo vertex_input_info {};
+    vertex_input_info.byte_count = sizeof(Vertex);
+
+    SrVariantsInfo variants_info {};
+    variants_info.byte_count = sizeof(Variant);
+
+    SrColorBlendInfo color_blend_info {};
+    color_blend_info.blend_enabled = false;
+
+    SrPipelineSpec pipeline_specs {};
+    pipeline_specs.primitve_type     = SR_PRIMITIVE_TYPE_TRIANGLE_LIST;
+    pipeline_specs.depth_info        = depth_info;
+    pipeline_specs.rasterizer_info   = rasterizer_info;
+    pipeline_specs.vertex_input_info = vertex_input_info;
+    pipeline_specs.variants_info     = variants_info;
+    pipeline_specs.color_blend_info  = color_blend_info;
+    pipeline_specs.framebuffer       = framebuffer;
+    pipeline_specs.vertex_shader     = &vertex_shader;
+    pipeline_specs.pixel_shader      = &lambert_pixel_shader;
+
+    return pipeline_specs;
+}
+
+
+
+static UniformBuffer default_uniform_buffer() {
+    UniformBuffer ubo {};
+    ubo.view_pos = vec3(1.5f, 1.5f, -3.0f);
+    ubo.view     = look_at(ubo.view_pos, vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
+    ubo.model    = rotate(translate(mat4(1.0f), vec3(0.0f, 0.0f, 0.0f)), radians(-90.0f), vec3(1.0f, 0.0f, 0.0f));
+    ubo.proj     = perspective(radians(55.0f), (f32)width / height, 0.1f, 100.0f);
+    return ubo;
+}
+
+
+
+static void begin_frame(SrFramebuffer* framebuffer) {
+    sr_framebuffer_clear_color(framebuffer, {0.04f, 0.04f, 0.04f, 1.0f});
+    sr_framebuffer_clear_depth(framebuffer, 1.0f);
+}
+
+
+
+
+
+
+// ==================================================================
+// ===================== INDEXED DRAWING ============================
+// ==================================================================
+
+
+void bench_indexed_drawing() {
+    printf("\n== indexed drawing (helmet, %u frames) ==\n", frames);
+
+    std::vector<Vertex> expanded;
+    load_obj_file("./assets/models/helmet/helmet.obj", &expanded);
+
+    std::vector<Vertex> vertices;
+    std::vector<u32>    indices;
+    load_obj_file_indexed("./assets/models/helmet/helmet.obj", &vertices, &indices);
+
+    std::vector<u16> indices_u16(indices.begin(), indices.end());
+
+    SrTexture albedo = utils_load_texture_from_file("./assets/models/helmet/helmet_albedo.png");
+
+    SrFramebufferSpec framebuffer_specs {};
+    framebuffer_specs.width  = width;
+    framebuffer_specs.height = height;
+    SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+    UniformBuffer ubo = default_uniform_buffer();
+
+
+    const char* names[] = {"expanded", "indexed u32", "indexed u16"};
+
+    for (u32 mode = 0; mode < 3; mode++) {
+
+        // the u16 path only makes sense if every index fits in 16 bits
+        if (mode == 2 && vertices.size() > 0xffff)
+            continue;
+
+        SrPipelineSpec pipeline_specs = default_pipeline_spec(&framebuffer);
+        pipeline_specs.vertex_input_info.index_type = mode == 2 ? SR_INDEX_TYPE_U16 : SR_INDEX_TYPE_U32;
+
+        SrPipeline pipeline = sr_create_pipeline(pipeline_specs);
+        sr_pipeline_upload_uniform_buffer(&pipeline, &ubo, 0);
+        sr_pipeline_upload_texture(&pipeline, &albedo, 0);
+
+        f64 start = time_now_ms();
+
+        for (u32 frame = 0; frame < frames; frame++) {
+            begin_frame(&framebuffer);
+
+            switch (mode) {
+                case 0: sr_draw(&pipeline, expanded.size(), expanded.data()); break;
+                case 1: sr_draw_indexed(&pipeline, indices.data(), indices.size(), vertices.data(), vertices.size()); break;
+                case 2: sr_draw_indexed(&pipeline, indices_u16.data(), indices_u16.size(), vertices.data(), vertices.size()); break;
+            }
+        }
+
+        f64 frame_ms = (time_now_ms() - start) / frames;
+
+        printf("%-12s : %8u vertex shader invocations, %7.2f ms/frame\n",
+               names[mode], vertex_shader_invocations(&pipeline), frame_ms);
+
+        sr_destroy_pipeline(&pipeline);
+    }
+
+
+    sr_framebuffer_free(&framebuffer);
+    sr_texture_free(&albedo);
+}
+
+
+
+
+
+
+// ==================================================================
+// ==================== COVERAGE (SIMD) =============================
+// ==================================================================
+
+
+struct FlatVertex {
+    vec2 pos;
+};
+
+struct FlatVariant {
+    f32 shade;
+};
+
+
+
+sr_vec4 flat_vertex_shader(SrVertex in, SrVariant out, SrGlobalRegistry* reg) {
+    FlatVertex* vertex = (FlatVertex*)in;
+
+    FlatVariant variant;
+    variant.shade = 1.0f;
+    sr_upload_variant(out, variant);
+
+    return {vertex->pos.x, vertex->pos.y, 0.5f, 1.0f};
+}
+
+
+
+sr_vec4 flat_pixel_shader(SrVariant variants, SrGlobalRegistry* reg) {
+    FlatVariant* in = (FlatVariant*)variants;
+
+    return {in->shade, in->shade, in->shade, 1.0f};
+}
+
+
+
+// covers the screen with pairs of right triangles of the given size (in pixels),
+// the vertices are offset from the pixel centers so the edges cut through pixels
+static void build_triangle_grid(std::vector<FlatVertex>* out, u32 size) {
+    auto ndc = [](f32 x, f32 y) {
+        FlatVertex vert;
+        vert.pos = vec2((x + 0.25f) / width * 2.0f - 1.0f, (y + 0.25f) / height * 2.0f - 1.0f);
+        return vert;
+    };
+
+    for (u32 y = 0; y + size <= height; y += size) {
+        for (u32 x = 0; x + size <= width; x += size) {
+            out->push_back(ndc(x,        y));
+            out->push_back(ndc(x + size, y));
+            out->push_back(ndc(x,        y + size));
+
+            out->push_back(ndc(x + size, y));
+            out->push_back(ndc(x + size, y + size));
+            out->push_back(ndc(x,        y + size));
+        }
+    }
+}
+
+
+
+void bench_simd_coverage() {
+    printf("\n== simd coverage (single thread, %u frames) ==\n", frames);
+
+    SrFramebufferSpec framebuffer_specs {};
+    framebuffer_specs.width  = width;
+    framebuffer_specs.height = height;
+    SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+    const char* level_names[] = {"auto", "scalar", "sse2", "avx2"};
+    u32 sizes[] = {4, 16, 64, 256};
+
+    for (u32 size : sizes) {
+        std::vector<FlatVertex> vertices;
+        build_triangle_grid(&vertices, size);
+
+        for (u32 level = SR_SIMD_LEVEL_SCALAR; level <= SR_SIMD_LEVEL_AVX2; level++) {
+
+            SrPipelineSpec pipeline_specs = default_pipeline_spec(&framebuffer);
+            pipeline_specs.depth_info.depth_test_enabled  = false;
+            pipeline_specs.depth_info.depth_write_enabled = false;
+            pipeline_specs.vertex_input_info.byte_count   = sizeof(FlatVertex);
+            pipeline_specs.variants_info.byte_count       = sizeof(FlatVariant);
+            pipeline_specs.rasterizer_info.simd_level     = (SrSimdLevel)level;
+            pipeline_specs.threading_info.thread_count    = 1;
+            pipeline_specs.vertex_shader                  = &flat_vertex_shader;
+            pipeline_specs.pixel_shader                   = &flat_pixel_shader;
+
+            SrPipeline pipeline = sr_create_pipeline(pipeline_specs);
+
+            // the cpu doesn't support this level
+            if (pipeline.spec.rasterizer_info.simd_level != level) {
+                sr_destroy_pipeline(&pipeline);
+                continue;
+            }
+
+            f64 pixels = 0.0;
+            f64 start  = time_now_ms();
+
+            for (u32 frame = 0; frame < frames; frame++) {
+                sr_draw(&pipeline, vertices.size(), vertices.data());
+                pixels += pipeline.stats.workers[0].pixels_count;
+            }
+
+            f64 elapsed_ms = time_now_ms() - start;
+
+            printf("%3ux%-3u triangles, %-6s : %8.2f Mpixels/s\n",
+                   size, size, level_names[level], pixels / (elapsed_ms * 1e3));
+
+            sr_destroy_pipeline(&pipeline);
+        }
+    }
+
+    sr_framebuffer_free(&framebuffer);
+}
+
+
+
+
+
+
+// ==================================================================
+// ===================== BLOCK TRAVERSAL ============================
+// ==================================================================
+
+
+static u64 coverage_tests(SrPipeline* pipeline) {
+    u64 count = 0;
+    for (u32 i = 0; i < pipeline->stats.worker_count; i++)
+        count += pipeline->stats.workers[i].coverage_tests;
+    return count;
+}
+
+
+
+static u64 coverage_tests_skipped(SrPipeline* pipeline) {
+    u64 count = 0;
+    for (u32 i = 0; i < pipeline->stats.worker_count; i++)
+        count += pipeline->stats.workers[i].coverage_tests_skipped;
+    return count;
+}
+
+
+
+static void print_coverage_tests(const char* name, SrPipeline* pipeline) {
+    u64 tested  = coverage_tests(pipeline);
+    u64 skipped = coverage_tests_skipped(pipeline);
+
+    // without the blocks every pixel of the bounding boxes gets tested
+    printf("%-16s : %9llu bbox pixels, %9llu tested, %9llu skipped (%5.1f%% saved)\n", name,
+           (unsigned long long)(tested + skipped), (unsigned long long)tested, (unsigned long long)skipped,
+           100.0 * skipped / (f64)(tested + skipped));
+}
+
+
+
+void bench_block_traversal() {
+    printf("\n== block traversal coverage tests (one frame) ==\n");
+
+    SrFramebufferSpec framebuffer_specs {};
+    framebuffer_specs.width  = width;
+    framebuffer_specs.height = height;
+    SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+
+    struct {
+        const char* name;
+        const char* model_path;
+        const char* texture_path;
+        vec3        view_pos;
+        f32         rotation_x;
+
+    } meshes[] = {
+        {"helmet", "./assets/models/helmet/helmet.obj", "./assets/models/helmet/helmet_albedo.png", vec3(1.5f, 1.5f, -3.0f), -90.0f},
+        {"head",   "./assets/models/head/head.obj",     "./assets/models/head/head.png",            vec3(1.1f, 1.5f, -2.2f),   0.0f},
+    };
+
+    for (auto& mesh : meshes) {
+        std::vector<Vertex> vertices;
+        load_obj_file(mesh.model_path, &vertices);
+
+        SrTexture texture = utils_load_texture_from_file(mesh.texture_path);
+
+        UniformBuffer ubo = default_uniform_buffer();
+        ubo.view_pos = mesh.view_pos;
+        ubo.view     = look_at(ubo.view_pos, vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
+        ubo.model    = rotate(mat4(1.0f), radians(mesh.rotation_x), vec3(1.0f, 0.0f, 0.0f));
+
+        SrPipeline pipeline = sr_create_pipeline(default_pipeline_spec(&framebuffer));
+        sr_pipeline_upload_uniform_buffer(&pipeline, &ubo, 0);
+        sr_pipeline_upload_texture(&pipeline, &texture, 0);
+
+        begin_frame(&framebuffer);
+        sr_draw(&pipeline, vertices.size(), vertices.data());
+
+        print_coverage_tests(mesh.name, &pipeline);
+
+        sr_destroy_pipeline(&pipeline);
+        sr_texture_free(&texture);
+    }
+
+
+    // large triangles, where most of the blocks are fully inside
+    std::vector<FlatVertex> grid;
+    build_triangle_grid(&grid, 256);
+
+    SrPipelineSpec pipeline_specs = default_pipeline_spec(&framebuffer);
+    pipeline_specs.vertex_input_info.byte_count = sizeof(FlatVertex);
+    pipeline_specs.variants_info.byte_count     = sizeof(FlatVariant);
+    pipeline_specs.vertex_shader                = &flat_vertex_shader;
+    pipeline_specs.pixel_shader                 = &flat_pixel_shader;
+
+    SrPipeline pipeline = sr_create_pipeline(pipeline_specs);
+
+    begin_frame(&framebuffer);
+    sr_draw(&pipeline, grid.size(), grid.data());
+
+    print_coverage_tests("256x256 grid", &pipeline);
+
+    sr_destroy_pipeline(&pipeline);
+    sr_framebuffer_free(&framebuffer);
+}
+
+
+
+
+
+
+// ==================================================================
+// ===================== WATERTIGHT FAN =============================
+// ==================================================================
+
+
+sr_vec4 count_pixel_shader(SrVariant variants, SrGlobalRegistry* reg) {
+    return {1.0f / 16.0f, 0.0f, 0.0f, 1.0f};
+}
+
+
+
+// draws a fan of adjacent triangles covering the whole framebuffer with additive
+// blending, every pixel must be written exactly once: 0 writes is a crack between
+// two triangles and 2 writes is a shared edge that got shaded twice
+void bench_watertight_fan() {
+    printf("\n== watertight fan (every pixel must be written once) ==\n");
+
+    SrFramebufferSpec framebuffer_specs {};
+    framebuffer_specs.width  = width;
+    framebuffer_specs.height = height;
+    SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+
+    // irregular angles, with every vertex on a pixel center so a lot of
+    // pixel centers fall exactly on the shared edges
+    const u32 ring_count = 37;
+    f32 center_x = roundf(width  * 0.5f);
+    f32 center_y = roundf(height * 0.5f);
+    f32 radius   = (f32)(width + height);
+
+    auto ndc = [](f32 x, f32 y) {
+        FlatVertex vert;
+        vert.pos = vec2(x / width * 2.0f - 1.0f, y / height * 2.0f - 1.0f);
+        return vert;
+    };
+
+    std::vector<FlatVertex> ring;
+    for (u32 i = 0; i < ring_count; i++) {
+        f32 angle = 2.0f * PI * (i + 0.3f * sinf(i * 1.7f)) / ring_count;
+        ring.push_back(ndc(roundf(center_x + cosf(angle) * radius), roundf(center_y + sinf(angle) * radius)));
+    }
+
+    std::vector<FlatVertex> fan;
+    for (u32 i = 0; i < ring_count; i++) {
+        fan.push_back(ndc(center_x, center_y));
+        fan.push_back(ring[i]);
+        fan.push_back(ring[(i + 1) % ring_count]);
+    }
+
+
+    const char* names[] = {"floating point", "fixed point"};
+
+    for (u32 mode = 0; mode < 2; mode++) {
+        SrPipelineSpec pipeline_specs = default_pipeline_spec(&framebuffer);
+        pipeline_specs.depth_info.depth_test_enabled       = false;
+        pipeline_specs.depth_info.depth_write_enabled      = false;
+        pipeline_specs.rasterizer_info.fixed_point_enabled = mode == 1;
+        pipeline_specs.color_blend_info.blend_enabled      = true;
+        pipeline_specs.color_blend_info.src_blend_factor   = SR_BLEND_FACTOR_ONE;
+        pipeline_specs.color_blend_info.dst_blend_factor   = SR_BLEND_FACTOR_ONE;
+        pipeline_specs.color_blend_info.blend_op           = SR_BLEND_OP_ADD;
+        pipeline_specs.vertex_input_info.byte_count        = sizeof(FlatVertex);
+        pipeline_specs.variants_info.byte_count            = sizeof(FlatVariant);
+        pipeline_specs.vertex_shader                       = &flat_vertex_shader;
+        pipeline_specs.pixel_shader                        = &count_pixel_shader;
+
+        SrPipeline pipeline = sr_create_pipeline(pipeline_specs);
+
+        sr_framebuffer_clear_color(&framebuffer, {0.0f, 0.0f, 0.0f, 0.0f});
+        sr_draw(&pipeline, fan.size(), fan.data());
+
+        u32 counts[3] = {};
+        for (u32 y = 0; y < height; y++) {
+            for (u32 x = 0; x < width; x++) {
+                u32 writes = (u32)roundf(sr_framebuffer_get_color(&framebuffer, x, y).x * 16.0f);
+                counts[sr_min(writes, 2u)] += 1;
+            }
+        }
+
+        printf("%-14s : %7u pixels written once, %7u never, %7u more than once -> %s\n", names[mode],
+               counts[1], counts[0], counts[2], counts[1] == width * height ? "watertight" : "cracks or overlaps");
+
+        sr_destroy_pipeline(&pipeline);
+    }
+
+    sr_framebuffer_free(&framebuffer);
+}
+
+
+
+
+
+
+// ==================================================================
+// ======================== CLIPPING ================================
+// ==================================================================
+
+
+static void push_ground_quad(std::vector<Vertex>* out, f32 size, f32 y) {
+    Vertex corners[4];
+    corners[0] = {{-size, y, -size}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}};
+    corners[1] = {{ size, y, -size}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}};
+    corners[2] = {{ size, y,  size}, {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f}};
+    corners[3] = {{-size, y,  size}, {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f}};
+
+    u32 indices[6] = {0, 2, 1, 0, 3, 2};
+    for (u32 idx : indices)
+        out->push_back(corners[idx]);
+}
+
+
+
+// flies the camera straight through the helmet over a huge ground quad, so
+// a lot of triangles cross the near plane or go far off screen
+void bench_clipping_fly_through() {
+    printf("\n== clipping (camera flying through the helmet) ==\n");
+
+    std::vector<Vertex> scene;
+    load_obj_file("./assets/models/helmet/helmet.obj", &scene);
+    push_ground_quad(&scene, 500.0f, -1.0f);
+
+    SrTexture albedo = utils_load_texture_from_file("./assets/models/helmet/helmet_albedo.png");
+
+    SrFramebufferSpec framebuffer_specs {};
+    framebuffer_specs.width  = width;
+    framebuffer_specs.height = height;
+    SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+    UniformBuffer ubo = default_uniform_buffer();
+
+    SrPipeline pipeline = sr_create_pipeline(default_pipeline_spec(&framebuffer));
+    sr_pipeline_upload_uniform_buffer(&pipeline, &ubo, 0);
+    sr_pipeline_upload_texture(&pipeline, &albedo, 0);
+
+
+    const u32 path_frames = 60;
+    f64 total_ms = 0.0, worst_ms = 0.0;
+    u32 clipped = 0, rejected = 0;
+
+    for (u32 frame = 0; frame < path_frames; frame++) {
+        f32 t = (f32)frame / (path_frames - 1);
+
+        ubo.view_pos = vec3(0.05f, 0.1f, -4.0f + 8.0f * t);
+        ubo.view     = look_at(ubo.view_pos, ubo.view_pos + vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 1.0f, 0.0f));
+
+        begin_frame(&framebuffer);
+
+        f64 start = time_now_ms();
+        sr_draw(&pipeline, scene.size(), scene.data());
+        f64 elapsed = time_now_ms() - start;
+
+        total_ms += elapsed;
+        worst_ms  = sr_max(worst_ms, elapsed);
+        clipped  += pipeline.stats.triangles_clipped;
+        rejected += pipeline.stats.triangles_rejected;
+    }
+
+    printf("%u frames: avg %.2f ms, worst %.2f ms\n", path_frames, total_ms / path_frames, worst_ms);
+    printf("per frame: %.1f triangles clipped, %.1f rejected (of %zu)\n", 
+           (f64)clipped / path_frames, (f64)rejected / path_frames, scene.size() / 3);
+
+
+    // the guard band only changes which triangles get clipped on the sides, 
+    // clipping everything to the viewport must give the same image
+    ubo.view_pos = vec3(0.05f, 0.1f, -0.3f);
+    ubo.view     = look_at(ubo.view_pos, ubo.view_pos + vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 1.0f, 0.0f));
+
+    std::vector<sr_vec4> images[2];
+    f32 guard_bands[2] = {0.0f, 1.0f};
+
+    for (u32 i = 0; i < 2; i++) {
+        SrPipelineSpec pipeline_specs = default_pipeline_spec(&framebuffer);
+        pipeline_specs.rasterizer_info.guard_band_size = guard_bands[i];
+
+        SrPipeline guard_pipeline = sr_create_pipeline(pipeline_specs);
+        sr_pipeline_upload_uniform_buffer(&guard_pipeline, &ubo, 0);
+        sr_pipeline_upload_texture(&guard_pipeline, &albedo, 0);
+
+        begin_frame(&framebuffer);
+        sr_draw(&guard_pipeline, scene.size(), scene.data());
+
+        for (u32 y = 0; y < height; y++)
+            for (u32 x = 0; x < width; x++)
+                images[i].push_back(sr_framebuffer_get_color(&framebuffer, x, y));
+
+        printf("guard band %6.0f px : %u triangles clipped\n", 
+               guard_pipeline.spec.rasterizer_info.guard_band_size, guard_pipeline.stats.triangles_clipped);
+
+        sr_destroy_pipeline(&guard_pipeline);
+    }
+
+    u32 different = 0;
+    for (u32 i = 0; i < images[0].size(); i++) {
+        sr_vec4 a = images[0][i], b = images[1][i];
+        if (fabsf(a.x - b.x) > 0.02f || fabsf(a.y - b.y) > 0.02f || fabsf(a.z - b.z) > 0.02f)
+            different += 1;
+    }
+
+    printf("guard band vs viewport clipping: %u of %u pixels differ\n", different, width * height);
+
+
+    sr_destroy_pipeline(&pipeline);
+    sr_texture_free(&albedo);
+    sr_framebuffer_free(&framebuffer);
+}
+
+
+
+
+
+
+// ==================================================================
+// ========================= FRAME ARENA ============================
+// ==================================================================
+
+
+// the helmet split in a few hundred small draws, the transient storage of
+// every draw comes from the pipeline's frame arena instead of malloc/free
+void bench_frame_arena() {
+    printf("\n== frame arena (helmet split into small draws, %u frames) ==\n", frames);
+
+    std::vector<Vertex> vertices;
+    load_obj_file("./assets/models/helmet/helmet.obj", &vertices);
+
+    SrTexture albedo = utils_load_texture_from_file("./assets/models/helmet/helmet_albedo.png");
+
+    SrFramebufferSpec framebuffer_specs {};
+    framebuffer_specs.width  = width;
+    framebuffer_specs.height = height;
+    SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+    UniformBuffer ubo = default_uniform_buffer();
+
+    SrPipeline pipeline = sr_create_pipeline(default_pipeline_spec(&framebuffer));
+    sr_pipeline_upload_uniform_buffer(&pipeline, &ubo, 0);
+    sr_pipeline_upload_texture(&pipeline, &albedo, 0);
+
+
+    const u32 draw_size = 150 * 3;
+    u32 draws_count = (vertices.size() + draw_size - 1) / draw_size;
+
+    f64 total_ms = 0.0;
+    u32 first_frame_reallocations = 0;
+
+    for (u32 frame = 0; frame < frames; frame++) {
+        begin_frame(&framebuffer);
+
+        f64 start = time_now_ms();
+
+        for (u32 i = 0; i < vertices.size(); i += draw_size)
+            sr_draw(&pipeline, sr_min((u32)vertices.size() - i, draw_size), &vertices[i]);
+
+        total_ms += time_now_ms() - start;
+
+        if (frame == 0)
+            first_frame_reallocations = pipeline.frame_arena.reallocations_count;
+    }
+
+    printf("%u draws per frame: avg %.2f ms per frame, %.2f us per draw\n", draws_count, 
+           total_ms / frames, total_ms / frames / draws_count * 1000.0);
+    printf("arena high water mark %.1f KB, %u reallocations after the first frame, %u after %u frames\n", 
+           pipeline.frame_arena.high_water_mark / 1024.0, first_frame_reallocations, 
+           pipeline.frame_arena.reallocations_count, frames);
+
+    sr_destroy_pipeline(&pipeline);
+    sr_texture_free(&albedo);
+    sr_framebuffer_free(&framebuffer);
+}
+
+
+
+
+
+
+// ==================================================================
+// ======================== COLOR FORMATS ===========================
+// ==================================================================
+
+
+// renders the helmet into every color format, the resolve is what a 
+// present has to do to get 8-bit pixels out of the framebuffer
+void bench_color_formats() {
+    printf("\n== color formats (helmet, %u frames) ==\n", frames);
+
+    std::vector<Vertex> vertices;
+    std::vector<u32>    indices;
+    load_obj_file_indexed("./assets/models/helmet/helmet.obj", &vertices, &indices);
+
+    SrTexture albedo = utils_load_texture_from_file("./assets/models/helmet/helmet_albedo.png");
+
+    UniformBuffer ubo = default_uniform_buffer();
+
+    const char* names[] = {"RGBA32F", "RGBA8_UNORM", "RGBA16F", "R32F"};
+    std::vector<sr_vec4> reference;
+
+    for (u32 format = SR_COLOR_FORMAT_RGBA32F; format <= SR_COLOR_FORMAT_R32F; format++) {
+        SrFramebufferSpec framebuffer_specs {};
+        framebuffer_specs.width        = width;
+        framebuffer_specs.height       = height;
+        framebuffer_specs.color_format = (SrColorFormat)format;
+        SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+        SrPipeline pipeline = sr_create_pipeline(default_pipeline_spec(&framebuffer));
+        sr_pipeline_upload_uniform_buffer(&pipeline, &ubo, 0);
+        sr_pipeline_upload_texture(&pipeline, &albedo, 0);
+
+        std::vector<u32> resolved(width * height);
+        f64 clear_ms = 0.0, draw_ms = 0.0, resolve_ms = 0.0;
+
+        for (u32 frame = 0; frame < frames; frame++) {
+            f64 start = time_now_ms();
+            begin_frame(&framebuffer);
+            f64 cleared = time_now_ms();
+            sr_draw_indexed(&pipeline, indices.data(), indices.size(), vertices.data(), vertices.size());
+            f64 drawn = time_now_ms();
+            sr_framebuffer_resolve_rgba8(&framebuffer, resolved.data());
+            f64 end = time_now_ms();
+
+            clear_ms   += cleared - start;
+            draw_ms    += drawn - cleared;
+            resolve_ms += end - drawn;
+        }
+
+
+        // how far the stored red channel is from the RGBA32F render
+        f32 max_error = 0.0f;
+        for (u32 y = 0; y < height; y++) {
+            for (u32 x = 0; x < width; x++) {
+                sr_vec4 color = sr_framebuffer_get_color(&framebuffer, x, y);
+
+                if (format == SR_COLOR_FORMAT_RGBA32F)
+                    reference.push_back(color);
+                else if (color.x == color.x)
+                    max_error = sr_max(max_error, fabsf(color.x - reference[y * width + x].x));
+            }
+        }
+
+        printf("%-11s : %5.2f MB, clear %5.2f ms, draw %6.2f ms, resolve %5.2f ms, max error %.4f\n", 
+               names[format], width * height * sr_color_format_get_size((SrColorFormat)format) / (1024.0 * 1024.0), 
+               clear_ms / frames, draw_ms / frames, resolve_ms / frames, max_error);
+
+        sr_destroy_pipeline(&pipeline);
+        sr_framebuffer_free(&framebuffer);
+    }
+
+    sr_texture_free(&albedo);
+}
+
+
+
+
+
+
+// ==================================================================
+// ======================== DEPTH FORMATS ===========================
+// ==================================================================
+
+
+// a row of helmets behind each other, most of the pixels get depth tested
+// several times. the clear only flags the depth blocks, so its cost is
+// paid by the tiles that get drawn
+void bench_depth_formats() {
+    printf("\n== depth formats (row of helmets, %u frames) ==\n", frames);
+
+    std::vector<Vertex> vertices;
+    std::vector<u32>    indices;
+    load_obj_file_indexed("./assets/models/helmet/helmet.obj", &vertices, &indices);
+
+    SrTexture albedo = utils_load_texture_from_file("./assets/models/helmet/helmet_albedo.png");
+
+    const u32 helmets_count = 4;
+    UniformBuffer ubos[helmets_count];
+
+    for (u32 i = 0; i < helmets_count; i++) {
+        ubos[i] = default_uniform_buffer();
+        ubos[i].model = rotate(translate(mat4(1.0f), vec3(0.3f * i, 0.0f, 1.5f * i)), radians(-90.0f), vec3(1.0f, 0.0f, 0.0f));
+    }
+
+    const char* names[] = {"D32F", "D24", "D16"};
+    std::vector<sr_vec4> reference;
+
+    for (u32 format = SR_DEPTH_FORMAT_D32F; format <= SR_DEPTH_FORMAT_D16; format++) {
+        SrFramebufferSpec framebuffer_specs {};
+        framebuffer_specs.width        = width;
+        framebuffer_specs.height       = height;
+        framebuffer_specs.depth_format = (SrDepthFormat)format;
+        SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+        SrPipeline pipeline = sr_create_pipeline(default_pipeline_spec(&framebuffer));
+        sr_pipeline_upload_texture(&pipeline, &albedo, 0);
+
+        f64 clear_ms = 0.0, draw_ms = 0.0;
+
+        for (u32 frame = 0; frame < frames; frame++) {
+            f64 start = time_now_ms();
+            sr_framebuffer_clear_depth(&framebuffer, 1.0f);
+            f64 cleared = time_now_ms();
+
+            sr_framebuffer_clear_color(&framebuffer, {0.04f, 0.04f, 0.04f, 1.0f});
+
+            f64 draw_start = time_now_ms();
+
+            // front to back, so most of the farther helmets fail the depth test
+            for (u32 i = 0; i < helmets_count; i++) {
+                sr_pipeline_upload_uniform_buffer(&pipeline, &ubos[i], 0);
+                sr_draw_indexed(&pipeline, indices.data(), indices.size(), vertices.data(), vertices.size());
+            }
+
+            clear_ms += cleared - start;
+            draw_ms  += time_now_ms() - draw_start;
+        }
+
+
+        u32 different = 0;
+        for (u32 y = 0; y < height; y++) {
+            for (u32 x = 0; x < width; x++) {
+                sr_vec4 color = sr_framebuffer_get_color(&framebuffer, x, y);
+
+                if (format == SR_DEPTH_FORMAT_D32F)
+                    reference.push_back(color);
+                else if (fabsf(color.x - reference[y * width + x].x) > 0.01f)
+                    different += 1;
+            }
+        }
+
+        printf("%-4s : %5.2f MB, clear %.3f ms, draw %6.2f ms, %u pixels differ from D32F\n", names[format], 
+               width * height * sr_depth_format_get_size((SrDepthFormat)format) / (1024.0 * 1024.0), 
+               clear_ms / frames, draw_ms / frames, different);
+
+        sr_destroy_pipeline(&pipeline);
+        sr_framebuffer_free(&framebuffer);
+    }
+
+    sr_texture_free(&albedo);
+}
+
+
+
+
+
+
+// ==================================================================
+// ====================== HIERARCHICAL Z ============================
+// ==================================================================
+
+
+static u32 hiz_blocks_rejected(SrPipeline* pipeline) {
+    u32 count = 0;
+    for (u32 i = 0; i < pipeline->stats.worker_count; i++)
+        count += pipeline->stats.workers[i].hiz_blocks_rejected;
+    return count;
+}
+
+
+
+static u32 shaded_pixels(SrPipeline* pipeline) {
+    u32 count = 0;
+    for (u32 i = 0; i < pipeline->stats.worker_count; i++)
+        count += pipeline->stats.workers[i].pixels_count;
+    return count;
+}
+
+
+
+void bench_hierarchical_z() {
+    printf("\n== hierarchical z (stack of helmets, %u frames) ==\n", frames);
+
+    std::vector<Vertex> vertices;
+    std::vector<u32>    indices;
+    load_obj_file_indexed("./assets/models/helmet/helmet.obj", &vertices, &indices);
+
+    SrTexture albedo = utils_load_texture_from_file("./assets/models/helmet/helmet_albedo.png");
+
+    // every helmet sits right behind the previous one so most of the
+    // stack is hidden by the first helmet
+    const u32 helmets_count = 8;
+    UniformBuffer ubos[helmets_count];
+
+    for (u32 i = 0; i < helmets_count; i++) {
+        ubos[i] = default_uniform_buffer();
+        ubos[i].model = rotate(translate(mat4(1.0f), vec3(0.1f * i, 0.0f, 2.0f * i)), radians(-90.0f), vec3(1.0f, 0.0f, 0.0f));
+    }
+
+    SrFramebufferSpec framebuffer_specs {};
+    framebuffer_specs.width  = width;
+    framebuffer_specs.height = height;
+    SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+    SrPipeline pipeline = sr_create_pipeline(default_pipeline_spec(&framebuffer));
+    sr_pipeline_upload_texture(&pipeline, &albedo, 0);
+
+    const char* names[] = {"back to front", "front to back"};
+    std::vector<sr_vec4> reference;
+
+    for (u32 order = 0; order < 2; order++) {
+        f64 draw_ms  = 0.0;
+        u32 rejected = 0;
+        u64 walked   = 0;
+        u32 shaded   = 0;
+
+        for (u32 frame = 0; frame < frames; frame++) {
+            begin_frame(&framebuffer);
+
+            f64 start = time_now_ms();
+
+            for (u32 i = 0; i < helmets_count; i++) {
+                u32 helmet = order == 0 ? helmets_count - 1 - i : i;
+
+                sr_pipeline_upload_uniform_buffer(&pipeline, &ubos[helmet], 0);
+                sr_draw_indexed(&pipeline, indices.data(), indices.size(), vertices.data(), vertices.size());
+
+                rejected += hiz_blocks_rejected(&pipeline);
+                walked   += coverage_tests(&pipeline) + coverage_tests_skipped(&pipeline);
+                shaded   += shaded_pixels(&pipeline);
+            }
+
+            draw_ms += time_now_ms() - start;
+        }
+
+
+        // the depth test keeps the nearest helmet either way
+        u32 different = 0;
+        for (u32 y = 0; y < height; y++) {
+            for (u32 x = 0; x < width; x++) {
+                sr_vec4 color = sr_framebuffer_get_color(&framebuffer, x, y);
+
+                if (order == 0)
+                    reference.push_back(color);
+                else if (fabsf(color.x - reference[y * width + x].x) > 0.01f)
+                    different += 1;
+            }
+        }
+
+        // the rejected blocks are neither walked nor depth tested, the 
+        // shaded pixels stay the same as without the hierarchical z
+        printf("%-13s : draw %6.2f ms, %5u blocks rejected, %8llu pixels walked, %7u shaded, %u pixels differ\n", 
+               names[order], draw_ms / frames, rejected / frames, (unsigned long long)(walked / frames), 
+               shaded / frames, different);
+    }
+
+    sr_destroy_pipeline(&pipeline);
+    sr_framebuffer_free(&framebuffer);
+    sr_texture_free(&albedo);
+}
+
+
+
+
+
+
+// ==================================================================
+// ===================== VISIBILITY BUFFER ==========================
+// ==================================================================
+
+
+// same shading as the pbr sample
+
+static vec3 pow5(const vec3 &v) { return v * v * v * v * v; }
+
+static vec3 f_schlick(vec3 f0, float u) {
+    return f0 + (1.0f - f0) * pow5(1.0f - u);
+}
+
+
+static f32 d_ggx(f32 ndoth, f32 roughness) {
+    f32 a = ndoth * roughness;
+    f32 k = roughness / sr_max((1.0f - ndoth * ndoth + a * a), RM_EP);
+    return k * k * (1.0f / PI);
+}
+
+
+static f32 v_smith_ggx(f32 ndotv, f32 ndotl, f32 roughness) {
+    f32 a = roughness * roughness;
+    f32 a2 = a * a;
+    f32 ggxl = ndotv * sqrt((-ndotl * a2 + ndotl) * ndotl + a2);
+    f32 ggxv = ndotl * sqrt((-ndotv * a2 + ndotv) * ndotv + a2);
+
+    return 0.5f / (ggxv + ggxl);
+}
+
+
+
+static sr_vec4 pbr_lighting(Variant* in, SrGlobalRegistry* reg, sr_vec4 albedo_t, sr_vec4 emission_t,
+                            f32 occlusion, f32 roughness, f32 metalness) {
+
+    UniformBuffer& ubo = *sr_get_uniform_buffer(UniformBuffer, reg, 0);
+    vec3 view_pos  = ubo.view_pos;
+    vec3 light_pos = ubo.view_pos;
+
+    vec3 albedo   = {albedo_t.x, albedo_t.y, albedo_t.z};
+    vec3 emission = {emission_t.x, emission_t.y, emission_t.z};
+    roughness     = clamp(roughness, 0.089f, 1.0f);
+
+    vec3 radiance = vec3(1.0f, 1.0f, 1.0f) * 2.0f;
+
+    vec3 normal    = normalize(in->normal);
+    vec3 view_dir  = normalize(view_pos - in->world_pos);
+    vec3 light_dir = normalize(light_pos);
+    vec3 halfway   = normalize(light_dir + view_dir);
+
+    f32 ndoth = sr_max(dot(normal, halfway), 0.0f);
+    f32 ndotv = sr_max(dot(normal, view_dir), 0.0f);
+    f32 ndotl = sr_max(dot(normal, light_dir), 0.0f);
+    f32 ldoth = sr_max(dot(halfway, view_dir), 0.0f);
+
+    vec3 f0 = lerp(vec3(0.4f), albedo, metalness);
+    f32 d  = d_ggx(ndoth, roughness);
+    f32 v  = v_smith_ggx(ndotv, ndotl, roughness);
+    vec3 f = f_schlick(f0, ldoth);
+
+    vec3 base_color  = albedo * (1.0f - metalness);
+    vec3 difuse      = base_color / PI;
+    vec3 specular    = (d * v * f);
+    vec3 final_color = (difuse + specular) * radiance * ndotl;
+
+    vec3 ambient = vec3(0.03f) * albedo * occlusion;
+    final_color += ambient + emission * 2.0f;
+    final_color = gamma2_2(final_color);
+
+    return {final_color.x, final_color.y, final_color.z, 1.0f};
+}
+
+
+
+sr_vec4 pbr_pixel_shader(SrVariant variants, SrGlobalRegistry* reg) {
+    Variant* in = (Variant*)variants;
+
+    sr_vec4 albedo_t    = sr_texel(reg, 0, in->uv.x, in->uv.y);
+    sr_vec4 roughness_t = sr_texel(reg, 1, in->uv.x, in->uv.y);
+    sr_vec4 metalness_t = sr_texel(reg, 2, in->uv.x, in->uv.y);
+    sr_vec4 occlusion_t = sr_texel(reg, 3, in->uv.x, in->uv.y);
+    sr_vec4 emission_t  = sr_texel(reg, 4, in->uv.x, in->uv.y);
+
+    return pbr_lighting(in, reg, albedo_t, emission_t, occlusion_t.x, roughness_t.x, metalness_t.x);
+}
+
+
+
+// occlusion, roughness and metalness packed in the texture of slot 1
+sr_vec4 pbr_packed_pixel_shader(SrVariant variants, SrGlobalRegistry* reg) {
+    Variant* in = (Variant*)variants;
+
+    sr_vec4 albedo_t   = sr_texel(reg, 0, in->uv.x, in->uv.y);
+    sr_vec4 orm_t      = sr_texel(reg, 1, in->uv.x, in->uv.y);
+    sr_vec4 emission_t = sr_texel(reg, 2, in->uv.x, in->uv.y);
+
+    return pbr_lighting(in, reg, albedo_t, emission_t, orm_t.x, orm_t.y, orm_t.z);
+}
+
+
+
+// the pbr helmet on its own and then the stack of helmets, the forward path
+// runs the pixel shader for every fragment that passes the depth test at the
+// time it's drawn while the visibility path runs it once per visible pixel
+void bench_visibility_buffer() {
+    printf("\n== visibility buffer (pbr helmet, %u frames) ==\n", frames);
+
+    std::vector<Vertex> vertices;
+    std::vector<u32>    indices;
+    load_obj_file_indexed("./assets/models/helmet/helmet.obj", &vertices, &indices);
+
+    const char* texture_names[] = {"albedo", "roughness", "metalness", "occlusion", "emission"};
+    SrTexture textures[5];
+
+    for (u32 i = 0; i < 5; i++) {
+        char path[256];
+        snprintf(path, sizeof(path), "./assets/models/helmet/helmet_%s.png", texture_names[i]);
+        textures[i] = utils_load_texture_from_file(path);
+    }
+
+    const u32 helmets_count = 8;
+    UniformBuffer ubos[helmets_count];
+
+    for (u32 i = 0; i < helmets_count; i++) {
+        ubos[i] = default_uniform_buffer();
+        ubos[i].model = rotate(translate(mat4(1.0f), vec3(0.1f * i, 0.0f, 2.0f * i)), radians(-90.0f), vec3(1.0f, 0.0f, 0.0f));
+    }
+
+    SrFramebufferSpec framebuffer_specs {};
+    framebuffer_specs.width  = width;
+    framebuffer_specs.height = height;
+    SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+    const char* mode_names[]  = {"forward", "visibility"};
+    const char* scene_names[] = {"1 helmet", "8 helmets"};
+    u32 scene_helmets[]       = {1, helmets_count};
+
+    for (u32 scene = 0; scene < 2; scene++) {
+        std::vector<sr_vec4> reference;
+
+        for (u32 mode = SR_SHADING_MODE_FORWARD; mode <= SR_SHADING_MODE_VISIBILITY; mode++) {
+            SrPipelineSpec pipeline_specs = default_pipeline_spec(&framebuffer);
+            pipeline_specs.pixel_shader = &pbr_pixel_shader;
+            pipeline_specs.shading_mode = (SrShadingMode)mode;
+
+            SrPipeline pipeline = sr_create_pipeline(pipeline_specs);
+
+            for (u32 i = 0; i < 5; i++)
+                sr_pipeline_upload_texture(&pipeline, &textures[i], i);
+
+            f64 draw_ms = 0.0;
+            u32 shaded  = 0;
+
+            for (u32 frame = 0; frame < frames; frame++) {
+                begin_frame(&framebuffer);
+
+                f64 start = time_now_ms();
+
+                // back to front, the worst case for the forward path
+                for (u32 i = 0; i < scene_helmets[scene]; i++) {
+                    sr_pipeline_upload_uniform_buffer(&pipeline, &ubos[scene_helmets[scene] - 1 - i], 0);
+                    sr_draw_indexed(&pipeline, indices.data(), indices.size(), vertices.data(), vertices.size());
+
+                    shaded += shaded_pixels(&pipeline);
+                }
+
+                draw_ms += time_now_ms() - start;
+            }
+
+
+            u32 different = 0;
+            for (u32 y = 0; y < height; y++) {
+                for (u32 x = 0; x < width; x++) {
+                    sr_vec4 color = sr_framebuffer_get_color(&framebuffer, x, y);
+
+                    if (mode == SR_SHADING_MODE_FORWARD)
+                        reference.push_back(color);
+                    else if (fabsf(color.x - reference[y * width + x].x) > 0.01f)
+                        different += 1;
+                }
+            }
+
+            printf("%-9s %-10s : draw %6.2f ms, %7u pixel shader invocations, %u pixels differ\n", 
+                   scene_names[scene], mode_names[mode], draw_ms / frames, shaded / frames, different);
+
+            sr_destroy_pipeline(&pipeline);
+        }
+    }
+
+    sr_framebuffer_free(&framebuffer);
+
+    for (u32 i = 0; i < 5; i++)
+        sr_texture_free(&textures[i]);
+}
+
+
+
+
+
+
+// ==================================================================
+// ================= SPECIALIZED FRAGMENT FUNCTIONS =================
+// ==================================================================
+
+
+struct BlendVertex {
+    vec3 pos;
+    vec4 color;
+};
+
+struct BlendVariant {
+    vec4 color;
+};
+
+
+
+sr_vec4 blend_vertex_shader(SrVertex in, SrVariant out, SrGlobalRegistry* reg) {
+    BlendVertex* vertex = (BlendVertex*)in;
+
+    BlendVariant variant;
+    variant.color = vertex->color;
+    sr_upload_variant(out, variant);
+
+    return {vertex->pos.x, vertex->pos.y, vertex->pos.z, 1.0f};
+}
+
+
+
+sr_vec4 blend_pixel_shader(SrVariant variants, SrGlobalRegistry* reg) {
+    BlendVariant* in = (BlendVariant*)variants;
+
+    return {in->color.x, in->color.y, in->color.z, in->color.w};
+}
+
+
+
+// the fragment stage the way every pipeline ran it before the specialization,
+// the depth and blend state are looked up for each pixel
+static sr_u32 dynamic_fragment_function(SrPipeline* pipeline, SrTriangle* tri, SrPixelBatch* batch, 
+                                        SrVariant current_variant, SrVisibilityTile* vis, 
+                                        sr_u32 x, sr_u32 y, sr_u32 mask, sr_f32* e) {
+    SrDepthInfo*      depth_info = &pipeline->spec.depth_info;
+    SrColorBlendInfo* blend_info = &pipeline->spec.color_blend_info;
+
+    sr_u32 depth_test = depth_info->depth_test_enabled ? depth_info->depth_compare_op : SR_DEPTH_TEST_DISABLED;
+    SrBlendMode blend_mode = blend_info->blend_enabled ? SR_BLEND_MODE_GENERIC : SR_BLEND_MODE_NONE;
+
+    return sr_process_fragments(pipeline, tri, batch, current_variant, vis, x, y, mask, e,
+                                depth_test, depth_info->depth_write_enabled, blend_mode);
+}
+
+
+
+// layers of screen covering quads drawn back to front, every pixel is depth
+// tested and alpha blended once per layer
+void bench_fragment_functions() {
+    const u32 layers = 8;
+
+    printf("\n== specialized fragment functions (%u alpha blended layers, %u frames) ==\n", layers, frames);
+
+    std::vector<BlendVertex> vertices;
+    for (u32 i = 0; i < layers; i++) {
+        f32 z = 0.9f - 0.1f * i;
+        vec4 color = vec4((i & 1) ? 1.0f : 0.2f, (i & 2) ? 1.0f : 0.2f, (i & 4) ? 1.0f : 0.2f, 0.5f);
+
+        BlendVertex quad[6] = {
+            {vec3(-1.0f, -1.0f, z), color}, {vec3( 1.0f, -1.0f, z), color}, {vec3( 1.0f,  1.0f, z), color},
+            {vec3(-1.0f, -1.0f, z), color}, {vec3( 1.0f,  1.0f, z), color}, {vec3(-1.0f,  1.0f, z), color},
+        };
+        vertices.insert(vertices.end(), quad, quad + 6);
+    }
+
+    SrFramebufferSpec framebuffer_specs {};
+    framebuffer_specs.width  = width;
+    framebuffer_specs.height = height;
+    SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+
+    const char* names[] = {"dynamic", "specialized"};
+    std::vector<sr_vec4> reference;
+
+    for (u32 mode = 0; mode < 2; mode++) {
+        SrPipelineSpec pipeline_specs = default_pipeline_spec(&framebuffer);
+        pipeline_specs.vertex_input_info.byte_count       = sizeof(BlendVertex);
+        pipeline_specs.variants_info.byte_count           = sizeof(BlendVariant);
+        pipeline_specs.color_blend_info.blend_enabled     = true;
+        pipeline_specs.color_blend_info.src_blend_factor  = SR_BLEND_FACTOR_SRC_ALPHA;
+        pipeline_specs.color_blend_info.dst_blend_factor  = SR_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        pipeline_specs.color_blend_info.blend_op          = SR_BLEND_OP_ADD;
+        pipeline_specs.vertex_shader                      = &blend_vertex_shader;
+        pipeline_specs.pixel_shader                       = &blend_pixel_shader;
+
+        SrPipeline pipeline = sr_create_pipeline(pipeline_specs);
+        if (mode == 0)
+            pipeline.fragment_function = &dynamic_fragment_function;
+
+        f64 start = time_now_ms();
+
+        for (u32 frame = 0; frame < frames; frame++) {
+            begin_frame(&framebuffer);
+            sr_draw(&pipeline, vertices.size(), vertices.data());
+        }
+
+        f64 frame_ms = (time_now_ms() - start) / frames;
+
+
+        u32 different = 0;
+        for (u32 y = 0; y < height; y++) {
+            for (u32 x = 0; x < width; x++) {
+                sr_vec4 color = sr_framebuffer_get_color(&framebuffer, x, y);
+
+                if (mode == 0)
+                    reference.push_back(color);
+                else if (fabsf(color.x - reference[y * width + x].x) > 0.01f)
+                    different++;
+            }
+        }
+
+        printf("%-11s : %7.2f ms/frame, %7.2f Mfragments/s, %u pixels differ\n", names[mode], frame_ms, 
+               (f64)width * height * layers / (frame_ms * 1000.0), different);
+
+        sr_destroy_pipeline(&pipeline);
+    }
+
+    sr_framebuffer_free(&framebuffer);
+}
+
+
+
+
+
+
+// ==================================================================
+// ========================== MIPMAPPING ============================
+// ==================================================================
+
+
+sr_vec4 trilinear_pixel_shader(SrVariant variants, SrGlobalRegistry* reg) {
+    Variant* in = (Variant*)variants;
+
+    UniformBuffer& ubo = *sr_get_uniform_buffer(UniformBuffer, reg, 0);
+
+    sr_vec4 albedo = sr_texel_grad(reg, 0, in->uv.x, in->uv.y, sr_ddx(Variant, in, uv), sr_ddy(Variant, in, uv));
+
+    vec3 normal    = normalize(in->normal);
+    vec3 light_dir = normalize(ubo.view_pos - in->world_pos);
+    f32 diffuse    = max(dot(normal, light_dir), 0.0f) + 0.03f;
+
+    return {albedo.x * diffuse, albedo.y * diffuse, albedo.z * diffuse, 1.0f};
+}
+
+
+
+// the helmet pushed further away so its 1024x1024 albedo gets minified,
+// shimmer is the average color change when it turns by a tenth of a degree,
+// the aliased level 0 reads change a lot more than the filtered mips
+void bench_mipmapping() {
+    printf("\n== mipmapping (helmet, %u frames) ==\n", frames);
+
+    std::vector<Vertex> vertices;
+    std::vector<u32>    indices;
+    load_obj_file_indexed("./assets/models/helmet/helmet.obj", &vertices, &indices);
+
+    SrTexture albedo = utils_load_texture_from_file("./assets/models/helmet/helmet_albedo.png");
+
+    printf("albedo : %u mip levels, %.2f MB with the chain\n", albedo.levels_count, 
+           (albedo.levels[albedo.levels_count - 1].offset + 1) * albedo.texel_size / (1024.0 * 1024.0));
+
+    SrFramebufferSpec framebuffer_specs {};
+    framebuffer_specs.width  = width;
+    framebuffer_specs.height = height;
+    SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+
+    // the level 0 bilinear reads are the trilinear texture sampled without derivatives
+    const char* names[] = {"nearest", "bilinear", "trilinear"};
+    f32 distances[] = {0.0f, 4.0f, 12.0f};
+
+    for (f32 distance : distances) {
+        for (u32 mode = 0; mode < 3; mode++) {
+            sr_texture_set_filter_mode(&albedo, mode == 0 ? SR_FILTER_NEAREST : SR_FILTER_TRILINEAR);
+
+            SrPipelineSpec pipeline_specs = default_pipeline_spec(&framebuffer);
+            pipeline_specs.variants_info.derivatives = mode == 2;
+            pipeline_specs.pixel_shader = mode == 2 ? &trilinear_pixel_shader : &lambert_pixel_shader;
+
+            SrPipeline pipeline = sr_create_pipeline(pipeline_specs);
+            sr_pipeline_upload_texture(&pipeline, &albedo, 0);
+
+            UniformBuffer ubo = default_uniform_buffer();
+            std::vector<sr_vec4> turned[2];
+
+            f64 start = time_now_ms();
+
+            for (u32 frame = 0; frame < frames; frame++) {
+                ubo.model = rotate(translate(mat4(1.0f), vec3(0.0f, 0.0f, distance)), radians(-90.0f), vec3(1.0f, 0.0f, 0.0f));
+                ubo.model = rotate(ubo.model, radians(0.1f * (frame & 1)), vec3(0.0f, 0.0f, 1.0f));
+                sr_pipeline_upload_uniform_buffer(&pipeline, &ubo, 0);
+
+                begin_frame(&framebuffer);
+                sr_draw_indexed(&pipeline, indices.data(), indices.size(), vertices.data(), vertices.size());
+
+                if (frame < 2)
+                    for (u32 i = 0; i < width * height; i++)
+                        turned[frame].push_back(sr_framebuffer_get_color(&framebuffer, i % width, i / width));
+            }
+
+            f64 frame_ms = (time_now_ms() - start) / frames;
+
+
+            f64 shimmer = 0.0;
+            for (u32 i = 0; i < width * height; i++)
+                shimmer += fabsf(turned[0][i].x - turned[1][i].x) + fabsf(turned[0][i].y - turned[1][i].y) + 
+                           fabsf(turned[0][i].z - turned[1][i].z);
+
+            printf("distance %4.1f, %-9s : %7.2f ms/frame, shimmer %.5f\n", distance, names[mode], frame_ms, 
+                   shimmer / (width * height));
+
+            sr_destroy_pipeline(&pipeline);
+        }
+    }
+
+    sr_framebuffer_free(&framebuffer);
+    sr_texture_free(&albedo);
+}
+
+
+
+
+
+
+// ==================================================================
+// ======================== TEXTURE LAYOUTS =========================
+// ==================================================================
+
+
+// set associative cache with 64 byte lines and lru replacement
+struct CacheModel {
+    u32 sets;
+    u32 ways;
+    std::vector<u64> tags;
+    u32 misses;
+};
+
+
+
+static CacheModel cache_create(u32 size_kb, u32 ways) {
+    CacheModel cache {};
+    cache.sets = size_kb * 1024 / 64 / ways;
+    cache.ways = ways;
+    cache.tags.assign(cache.sets * ways, ~0ull);
+    return cache;
+}
+
+
+
+static void cache_access(CacheModel* cache, const void* address) {
+    u64 line = (u64)address / 64;
+    u64* set = &cache->tags[(line % cache->sets) * cache->ways];
+
+    u32 hit = cache->ways - 1;
+    for (u32 i = 0; i < cache->ways; i++) {
+        if (set[i] == line) {
+            hit = i;
+            break;
+        }
+    }
+
+    if (set[hit] != line)
+        cache->misses++;
+
+    memmove(&set[1], &set[0], sizeof(u64) * hit);
+    set[0] = line;
+}
+
+
+
+// a 512x512 screen region mapped to the albedo at one texel per pixel and
+// rotated by the given angle, scanned row by row like the rasterizer does.
+// at 90 degrees every pixel of a screen row walks down a texture column
+void bench_texture_layouts() {
+    const u32 size = 512;
+    const u32 passes = 8;
+
+    printf("\n== texture layouts (%ux%u bilinear samples, %u passes) ==\n", size, size, passes);
+
+    stbi_set_flip_vertically_on_load(true);
+    i32 tex_width, tex_height, channels;
+    u8* pixels = stbi_load("./assets/models/helmet/helmet_albedo.png", &tex_width, &tex_height, &channels, 0);
+
+    const char* names[] = {"linear", "tiled 4x4", "morton"};
+    f32 angles[] = {0.0f, 45.0f, 90.0f};
+
+    for (f32 angle : angles) {
+        f32 c = cosf(radians(angle));
+        f32 s = sinf(radians(angle));
+
+        for (u32 layout = SR_TEXTURE_LAYOUT_LINEAR; layout <= SR_TEXTURE_LAYOUT_MORTON; layout++) {
+            SrTextureSpec specs {};
+            specs.format        = (SrFormat)channels;
+            specs.filter        = SR_FILTER_TRILINEAR;
+            specs.sampling_mode = SR_SAMPLING_MODE_REPEAT;
+            specs.layout        = (SrTextureLayout)layout;
+            specs.width         = tex_width;
+            specs.height        = tex_height;
+            SrTexture texture = sr_texture_create(specs, pixels);
+
+            auto uv_at = [&](u32 x, u32 y) {
+                f32 dx = (f32)x - size * 0.5f;
+                f32 dy = (f32)y - size * 0.5f;
+                return vec2(0.5f + (dx * c - dy * s) / tex_width, 0.5f + (dx * s + dy * c) / tex_height);
+            };
+
+
+            // the addresses of the 2x2 footprints run through a 32 KB l1 
+            // and a 1 MB l2 model
+            CacheModel l1 = cache_create(32, 8);
+            CacheModel l2 = cache_create(1024, 16);
+            for (u32 y = 0; y < size; y++) {
+                for (u32 x = 0; x < size; x++) {
+                    vec2 uv = uv_at(x, y);
+                    i32 tx = (i32)floorf(uv.x * tex_width  - 0.5f);
+                    i32 ty = (i32)floorf(uv.y * tex_height - 0.5f);
+
+                    for (u32 i = 0; i < 4; i++) {
+                        u32 index = sr_texture_texel_index(&texture, 0, (tx + (i & 1)) & (tex_width - 1), 
+                                                                        (ty + (i >> 1)) & (tex_height - 1));
+                        u32 l1_misses = l1.misses;
+                        cache_access(&l1, &texture.buffer[index * texture.texel_size]);
+
+                        if (l1.misses != l1_misses)
+                            cache_access(&l2, &texture.buffer[index * texture.texel_size]);
+                    }
+                }
+            }
+
+
+            f32 sum = 0.0f;
+            f64 start = time_now_ms();
+
+            for (u32 pass = 0; pass < passes; pass++) {
+                for (u32 y = 0; y < size; y++) {
+                    for (u32 x = 0; x < size; x++) {
+                        vec2 uv = uv_at(x, y);
+                        sum += sr_texture_sample(&texture, uv.x, uv.y).x;
+                    }
+                }
+            }
+
+            f64 elapsed_ms = time_now_ms() - start;
+
+            printf("%4.0f degrees, %-9s : %7.2f Msamples/s, l1 misses/sample %5.3f, l2 misses/sample %5.3f (checksum %.0f)\n", 
+                   angle, names[layout], (f64)size * size * passes / (elapsed_ms * 1000.0), 
+                   (f64)l1.misses / (size * size), (f64)l2.misses / (size * size), sum / passes);
+
+            sr_texture_free(&texture);
+        }
+    }
+
+    stbi_image_free(pixels);
+}
+
+
+
+
+
+
+// ==================================================================
+// ======================= TEXTURE STORAGE ==========================
+// ==================================================================
+
+
+// the five helmet maps sampled the way the pbr shader reads them, 
+// a trilinear fetch of every map per pixel at a few levels of detail
+void bench_texture_storage() {
+    const u32 size = 512;
+
+    printf("\n== texture storage (5 pbr maps, %ux%u trilinear fetches of each) ==\n", size, size);
+
+    const char* paths[] = {
+        "./assets/models/helmet/helmet_albedo.png",   "./assets/models/helmet/helmet_roughness.png",
+        "./assets/models/helmet/helmet_metalness.png", "./assets/models/helmet/helmet_occlusion.png",
+        "./assets/models/helmet/helmet_emission.png",
+    };
+
+    SrTexture textures[5];
+    f64 total_mb = 0.0;
+
+    for (u32 i = 0; i < 5; i++) {
+        textures[i] = utils_load_texture_from_file(paths[i]);
+        sr_texture_set_filter_mode(&textures[i], SR_FILTER_TRILINEAR);
+
+        SrMipLevel* last = &textures[i].levels[textures[i].levels_count - 1];
+        total_mb += (last->offset + 1) * textures[i].texel_size / (1024.0 * 1024.0);
+    }
+
+    printf("memory : %.2f MB with the mip chains\n", total_mb);
+
+
+    f32 lods[] = {0.0f, 1.5f, 3.0f};
+
+    for (f32 lod : lods) {
+        f32 step = exp2f(lod) / textures[0].spec.width;
+        f32 sum  = 0.0f;
+
+        f64 start = time_now_ms();
+
+        for (u32 y = 0; y < size; y++) {
+            for (u32 x = 0; x < size; x++) {
+                for (u32 i = 0; i < 5; i++)
+                    sum += sr_texture_sample_grad(&textures[i], x * step, y * step, step, 0.0f, 0.0f, step).x;
+            }
+        }
+
+        f64 elapsed_ms = time_now_ms() - start;
+
+        printf("lod %.1f : %7.2f Mfetches/s (checksum %.0f)\n", lod, (f64)size * size * 5 / (elapsed_ms * 1000.0), sum);
+    }
+
+    for (u32 i = 0; i < 5; i++)
+        sr_texture_free(&textures[i]);
+}
+
+
+
+
+
+
+// ==================================================================
+// ======================= CHANNEL PACKING ==========================
+// ==================================================================
+
+
+static f64 texture_mb(SrTexture* texture) {
+    SrMipLevel* last = &texture->levels[texture->levels_count - 1];
+
+    // the last level of the compressed ones is a whole padded block
+    if (texture->block_size)
+        return (last->offset / 16 + 1) * texture->block_size / (1024.0 * 1024.0);
+
+    return (last->offset + 1) * texture->texel_size / (1024.0 * 1024.0);
+}
+
+
+
+// the pbr helmet with its five maps bound separately and then with
+// occlusion, roughness and metalness packed in one RGB texture
+void bench_channel_packing() {
+    printf("\n== channel packing (pbr helmet, %u frames) ==\n", frames);
+
+    std::vector<Vertex> vertices;
+    std::vector<u32>    indices;
+    load_obj_file_indexed("./assets/models/helmet/helmet.obj", &vertices, &indices);
+
+    const char* names[] = {"albedo", "roughness", "metalness", "occlusion", "emission"};
+    SrTexture separate[5];
+
+    for (u32 i = 0; i < 5; i++) {
+        char path[256];
+        snprintf(path, sizeof(path), "./assets/models/helmet/helmet_%s.png", names[i]);
+        separate[i] = utils_load_texture_from_file(path);
+    }
+
+    const char* orm_paths[] = {
+        "./assets/models/helmet/helmet_occlusion.png",
+        "./assets/models/helmet/helmet_roughness.png",
+        "./assets/models/helmet/helmet_metalness.png",
+    };
+
+    SrTexture packed[3] = {separate[0], utils_load_packed_texture_from_files(orm_paths, 3), separate[4]};
+
+
+    SrFramebufferSpec framebuffer_specs {};
+    framebuffer_specs.width  = width;
+    framebuffer_specs.height = height;
+    SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+    UniformBuffer ubo = default_uniform_buffer();
+    std::vector<sr_vec4> reference;
+
+    for (u32 mode = 0; mode < 2; mode++) {
+        SrPipelineSpec pipeline_specs = default_pipeline_spec(&framebuffer);
+        pipeline_specs.pixel_shader = mode == 0 ? &pbr_pixel_shader : &pbr_packed_pixel_shader;
+
+        SrPipeline pipeline = sr_create_pipeline(pipeline_specs);
+        sr_pipeline_upload_uniform_buffer(&pipeline, &ubo, 0);
+
+        u32 textures_count = mode == 0 ? 5 : 3;
+        SrTexture* textures = mode == 0 ? separate : packed;
+        f64 memory_mb = 0.0;
+
+        for (u32 i = 0; i < textures_count; i++) {
+            sr_pipeline_upload_texture(&pipeline, &textures[i], i);
+            memory_mb += texture_mb(&textures[i]);
+        }
+
+        f64 start = time_now_ms();
+
+        for (u32 frame = 0; frame < frames; frame++) {
+            begin_frame(&framebuffer);
+            sr_draw_indexed(&pipeline, indices.data(), indices.size(), vertices.data(), vertices.size());
+        }
+
+        f64 frame_ms = (time_now_ms() - start) / frames;
+
+
+        u32 different = 0;
+        for (u32 y = 0; y < height; y++) {
+            for (u32 x = 0; x < width; x++) {
+                sr_vec4 color = sr_framebuffer_get_color(&framebuffer, x, y);
+
+                if (mode == 0)
+                    reference.push_back(color);
+                else if (fabsf(color.x - reference[y * width + x].x) > 0.01f)
+                    different++;
+            }
+        }
+
+        printf("%-8s : %u textures, %6.2f MB, %7.2f ms/frame, %u pixels differ\n", mode == 0 ? "separate" : "packed", 
+               textures_count, memory_mb, frame_ms, different);
+
+        sr_destroy_pipeline(&pipeline);
+    }
+
+    sr_framebuffer_free(&framebuffer);
+
+    for (u32 i = 0; i < 5; i++)
+        sr_texture_free(&separate[i]);
+    sr_texture_free(&packed[1]);
+}
+
+
+
+
+
+
+// the helmet maps compressed offline to the BC formats against their 8 bit
+// versions, memory, error of the top level and trilinear fetch throughput
+void bench_block_compression() {
+    const u32 size = 512;
+
+    printf("\n== block compression (helmet maps, %ux%u trilinear fetches) ==\n", size, size);
+
+    const char* albedo_path    = "./assets/models/helmet/helmet_albedo.png";
+    const char* roughness_path = "./assets/models/helmet/helmet_roughness.png";
+    const char* rm_paths[]     = {roughness_path, "./assets/models/helmet/helmet_metalness.png"};
+
+    SrTexture sources[3] = {
+        utils_load_texture_from_file(albedo_path),
+        utils_load_packed_texture_from_files(&roughness_path, 1),
+        utils_load_packed_texture_from_files(rm_paths, 2),
+    };
+
+    struct Case { const char* name; u32 source; SrFormat format; u32 channels; };
+    Case cases[] = {
+        {"albedo rgba8",   0, SR_FORMAT_RGBA, 4},
+        {"albedo bc1",     0, SR_FORMAT_BC1,  3},
+        {"albedo bc7",     0, SR_FORMAT_BC7,  4},
+        {"roughness r8",   1, SR_FORMAT_R,    1},
+        {"roughness bc4",  1, SR_FORMAT_BC4,  1},
+        {"rough/metal rg8", 2, SR_FORMAT_RG,  2},
+        {"rough/metal bc5", 2, SR_FORMAT_BC5, 2},
+    };
+
+    for (Case& c : cases) {
+        SrTexture* source = &sources[c.source];
+        SrTexture  texture = *source;
+        f64 encode_ms = 0.0;
+
+        if (c.format >= SR_FORMAT_BC1) {
+            f64 start = time_now_ms();
+
+            sr_usize blocks_size;
+            sr_u8* blocks = sr_texture_compress(source, c.format, &blocks_size);
+            encode_ms = time_now_ms() - start;
+
+            SrTextureSpec specs = source->spec;
+            specs.format = c.format;
+            texture = sr_texture_create(specs, blocks);
+            free(blocks);
+        }
+
+        sr_texture_set_filter_mode(&texture, SR_FILTER_TRILINEAR);
+
+
+        f64 squared_error = 0.0;
+        for (u32 y = 0; y < texture.spec.height; y++) {
+            for (u32 x = 0; x < texture.spec.width; x++) {
+                sr_vec4 a = sr_texture_get_pixel(source, x, y);
+                sr_vec4 b = sr_texture_get_pixel(&texture, x, y);
+                f32 d[4] = {a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w};
+
+                for (u32 i = 0; i < c.channels; i++)
+                    squared_error += d[i] * d[i];
+            }
+        }
+
+        f64 mse  = squared_error / ((f64)texture.spec.width * texture.spec.height * c.channels);
+        f64 psnr = mse > 0.0 ? 10.0 * log10(1.0 / mse) : 99.0;
+
+
+        f64 rates[2];
+        f32 lods[] = {0.0f, 2.0f};
+        f32 sum    = 0.0f;
+
+        for (u32 l = 0; l < 2; l++) {
+            f32 step = exp2f(lods[l]) / texture.spec.width;
+
+            f64 start = time_now_ms();
+
+            for (u32 y = 0; y < size; y++)
+                for (u32 x = 0; x < size; x++)
+                    sum += sr_texture_sample_grad(&texture, x * step, y * step, step, 0.0f, 0.0f, step).x;
+
+            rates[l] = (f64)size * size / ((time_now_ms() - start) * 1000.0);
+        }
+
+        printf("%-16s : %6.2f MB, psnr %5.2f dB, %6.2f / %6.2f Msamples/s at lod 0 / 2, encoded in %6.1f ms (checksum %.0f)\n", 
+               c.name, texture_mb(&texture), psnr, rates[0], rates[1], encode_ms, sum);
+
+        if (c.format >= SR_FORMAT_BC1)
+            sr_texture_free(&texture);
+    }
+
+    for (u32 i = 0; i < 3; i++)
+        sr_texture_free(&sources[i]);
+}
+
+
+
+
+
+
+// the same rotated 512x512 walk over the helmet albedo and roughness
+// sampled one uv at a time and in batches of 16, with and without gathers
+void bench_batched_sampling() {
+    const u32 size = 512;
+
+    printf("\n== batched sampling (%ux%u rotated walk, batches of %u) ==\n", size, size, SR_SAMPLE_BATCH_MAX);
+
+    const char* roughness_path = "./assets/models/helmet/helmet_roughness.png";
+    SrTexture textures[2] = {
+        utils_load_texture_from_file("./assets/models/helmet/helmet_albedo.png"),
+        utils_load_packed_texture_from_files(&roughness_path, 1),
+    };
+
+    const char* names[]   = {"albedo rgba8", "roughness r8"};
+    SrFilter    filters[] = {SR_FILTER_NEAREST, SR_FILTER_TRILINEAR};
+
+    // uv of every pixel of the walk, 30 degrees and 1.5 texels per pixel,
+    // offset so the uvs stay positive
+    std::vector<f32> us(size * size), vs(size * size);
+    f32 step = 1.5f / textures[0].spec.width;
+    f32 c = cosf(0.52f) * step, s = sinf(0.52f) * step;
+
+    for (u32 y = 0; y < size; y++) {
+        for (u32 x = 0; x < size; x++) {
+            us[y * size + x] = 0.5f + x * c - y * s;
+            vs[y * size + x] = 0.5f + x * s + y * c;
+        }
+    }
+
+    SrSimdLevel supported = sr_get_supported_simd_level();
+    SrSimdLevel resolved  = sr_sampling_simd_level;
+
+    for (u32 t = 0; t < 2; t++) {
+        for (SrFilter filter : filters) {
+            SrTexture* texture = &textures[t];
+            sr_texture_set_filter_mode(texture, filter);
+
+            f32 sum = 0.0f;
+            f64 start = time_now_ms();
+
+            for (u32 i = 0; i < size * size; i++)
+                sum += sr_texture_sample(texture, us[i], vs[i]).x;
+
+            f64 single_ms = time_now_ms() - start;
+
+            // sse2 addressing with scalar fetches, then the avx2 gathers
+            f64 batch_ms[2] = {0.0, 0.0};
+
+            for (u32 level = 0; level < 2; level++) {
+                if (level == 1 && supported != SR_SIMD_LEVEL_AVX2)
+                    break;
+
+                sr_sampling_simd_level = level == 0 ? SR_SIMD_LEVEL_SSE2 : SR_SIMD_LEVEL_AVX2;
+                SrSampleBatch batch;
+
+                start = time_now_ms();
+
+                for (u32 i = 0; i < size * size; i += SR_SAMPLE_BATCH_MAX) {
+                    sr_texture_sample_batch(texture, &us[i], &vs[i], SR_SAMPLE_BATCH_MAX, &batch);
+
+                    for (u32 j = 0; j < SR_SAMPLE_BATCH_MAX; j++)
+                        sum -= batch.r[j];
+                }
+
+                batch_ms[level] = time_now_ms() - start;
+            }
+
+            sr_sampling_simd_level = resolved;
+
+            f64 samples = (f64)size * size / 1000.0;
+            printf("%-12s %-9s : single %6.2f, batch %6.2f, batch + gather %6.2f Msamples/s (checksum %.0f)\n", 
+                   names[t], filter == SR_FILTER_NEAREST ? "nearest" : "trilinear", samples / single_ms, 
+                   samples / batch_ms[0], batch_ms[1] > 0.0 ? samples / batch_ms[1] : 0.0, sum);
+        }
+    }
+
+
+    // the borders, where the second row and column of the footprint wrap,
+    // on the albedo, a single texel and a morton r8 texture of one block
+    u8 texel[4] = {200, 100, 50, 255};
+    u8 block[16 * 16];
+    for (u32 i = 0; i < 16 * 16; i++)
+        block[i] = (u8)(i * 7);
+
+    SrTextureSpec specs {};
+    specs.format = SR_FORMAT_RGBA;
+    specs.width  = 1;
+    specs.height = 1;
+
+    SrTexture borders[3] = {textures[0], sr_texture_create(specs, texel)};
+
+    specs.format = SR_FORMAT_R;
+    specs.layout = SR_TEXTURE_LAYOUT_MORTON;
+    specs.width  = 16;
+    specs.height = 16;
+    borders[2] = sr_texture_create(specs, block);
+
+    f32 edge_us[SR_SAMPLE_BATCH_MAX], edge_vs[SR_SAMPLE_BATCH_MAX];
+    f32 edges[] = {0.0f, 1.0f, -0.25f, 1.25f};
+
+    for (u32 i = 0; i < SR_SAMPLE_BATCH_MAX; i++) {
+        edge_us[i] = edges[i % 4];
+        edge_vs[i] = edges[i / 4];
+    }
+
+    u32 different = 0;
+    for (SrTexture& texture : borders) {
+        for (SrSamplingMode mode : {SR_SAMPLING_MODE_CLAMP_TO_EDGE, SR_SAMPLING_MODE_REPEAT}) {
+            for (SrFilter filter : {SR_FILTER_BILINEAR, SR_FILTER_TRILINEAR}) {
+                sr_texture_set_sampling_mode(&texture, mode);
+                sr_texture_set_filter_mode(&texture, filter);
+
+                SrSampleBatch batch;
+                sr_texture_sample_batch(&texture, edge_us, edge_vs, SR_SAMPLE_BATCH_MAX, &batch);
+
+                for (u32 i = 0; i < SR_SAMPLE_BATCH_MAX; i++) {
+                    sr_vec4 single = sr_texture_sample(&texture, edge_us[i], edge_vs[i]);
+                    if (single.x != batch.r[i] || single.y != batch.g[i] || single.z != batch.b[i] || single.w != batch.a[i])
+                        different += 1;
+                }
+            }
+        }
+    }
+
+    printf("borders : %u of %u samples differ between single and batch\n", different, 3 * 2 * 2 * SR_SAMPLE_BATCH_MAX);
+
+    for (u32 i = 1; i < 3; i++)
+        sr_texture_free(&borders[i]);
+
+    for (u32 i = 0; i < 2; i++)
+        sr_texture_free(&textures[i]);
+}
+
+
+
+
+
+
+// ==================================================================
+// ===================== PLANE EQUATIONS ============================
+// ==================================================================
+
+
+template <u32 N>
+struct WideVariant {
+    f32 values[N];
+};
+
+
+
+// every float of the variant gets its own gradient and a perspective
+// w so the interpolation can't be reduced to an affine one
+template <u32 N>
+sr_vec4 wide_vertex_shader(SrVertex in, SrVariant out, SrGlobalRegistry* reg) {
+    FlatVertex* vertex = (FlatVertex*)in;
+
+    WideVariant<N> variant;
+    for (u32 i = 0; i < N; i++)
+        variant.values[i] = vertex->pos.x * (f32)(i + 1) + vertex->pos.y;
+
+    sr_upload_variant(out, variant);
+
+    f32 w = 1.5f + vertex->pos.x * 0.5f;
+    return {vertex->pos.x * w, vertex->pos.y * w, 0.5f * w, w};
+}
+
+
+
+template <u32 N>
+sr_vec4 wide_pixel_shader(SrVariant variants, SrGlobalRegistry* reg) {
+    WideVariant<N>* in = (WideVariant<N>*)variants;
+
+    f32 sum = 0.0f;
+    for (u32 i = 0; i < N; i++)
+        sum += in->values[i];
+
+    return {sum, sum, sum, 1.0f};
+}
+
+
+
+// the pixel shader only sums the variant, so most of the time per pixel is
+// the interpolation of 2, 8 (the Variant of the samples) and 16 floats
+void bench_plane_equations() {
+    printf("\n== plane equations (single thread, %u frames) ==\n", frames);
+
+    SrFramebufferSpec framebuffer_specs {};
+    framebuffer_specs.width  = width;
+    framebuffer_specs.height = height;
+    SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+    u32 floats[] = {2, 8, 16};
+    u32 sizes[]  = {4, 64};
+
+    sr_vec4 (*vertex_shaders[])(SrVertex, SrVariant, SrGlobalRegistry*) = {
+        &wide_vertex_shader<2>, &wide_vertex_shader<8>, &wide_vertex_shader<16>
+    };
+    sr_vec4 (*pixel_shaders[])(SrVariant, SrGlobalRegistry*) = {
+        &wide_pixel_shader<2>, &wide_pixel_shader<8>, &wide_pixel_shader<16>
+    };
+
+    for (u32 size : sizes) {
+        std::vector<FlatVertex> vertices;
+        build_triangle_grid(&vertices, size);
+
+        for (u32 i = 0; i < 3; i++) {
+            SrPipelineSpec pipeline_specs = default_pipeline_spec(&framebuffer);
+            pipeline_specs.depth_info.depth_test_enabled  = false;
+            pipeline_specs.depth_info.depth_write_enabled = false;
+            pipeline_specs.vertex_input_info.byte_count   = sizeof(FlatVertex);
+            pipeline_specs.variants_info.byte_count       = sizeof(f32) * floats[i];
+            pipeline_specs.threading_info.thread_count    = 1;
+            pipeline_specs.vertex_shader                  = vertex_shaders[i];
+            pipeline_specs.pixel_shader                   = pixel_shaders[i];
+
+            SrPipeline pipeline = sr_create_pipeline(pipeline_specs);
+
+            f64 pixels = 0.0;
+            f64 start  = time_now_ms();
+
+            for (u32 frame = 0; frame < frames; frame++) {
+                sr_draw(&pipeline, vertices.size(), vertices.data());
+                pixels += pipeline.stats.workers[0].pixels_count;
+            }
+
+            f64 elapsed_ms = time_now_ms() - start;
+
+            printf("%3ux%-3u triangles, %2u floats : %8.2f Mpixels/s\n",
+                   size, size, floats[i], pixels / (elapsed_ms * 1e3));
+
+            sr_destroy_pipeline(&pipeline);
+        }
+    }
+
+    sr_framebuffer_free(&framebuffer);
+}
+
+
+
+
+
+
+
+// ==================================================================
+// ===================== BATCHED PIXEL SHADERS ======================
+// ==================================================================
+
+
+// lambert_pixel_shader over a whole batch, every float of the variant is
+// read as SR_PIXEL_BATCH_SIZE contiguous lanes so the loop vectorizes
+void lambert_batch_pixel_shader(SrPixelBatch* batch, SrGlobalRegistry* reg) {
+    UniformBuffer& ubo = *sr_get_uniform_buffer(UniformBuffer, reg, 0);
+
+    f32* px = sr_batch_variant(Variant, batch, world_pos.x);
+    f32* py = sr_batch_variant(Variant, batch, world_pos.y);
+    f32* pz = sr_batch_variant(Variant, batch, world_pos.z);
+    f32* nx = sr_batch_variant(Variant, batch, normal.x);
+    f32* ny = sr_batch_variant(Variant, batch, normal.y);
+    f32* nz = sr_batch_variant(Variant, batch, normal.z);
+
+    SrSampleBatch albedo;
+    sr_texel_batch(reg, 0, sr_batch_variant(Variant, batch, uv.x), 
+                   sr_batch_variant(Variant, batch, uv.y), SR_PIXEL_BATCH_SIZE, &albedo);
+
+    for (u32 i = 0; i < SR_PIXEL_BATCH_SIZE; i++) {
+        f32 lx = ubo.view_pos.x - px[i];
+        f32 ly = ubo.view_pos.y - py[i];
+        f32 lz = ubo.view_pos.z - pz[i];
+
+        f32 n_length = sqrtf(nx[i] * nx[i] + ny[i] * ny[i] + nz[i] * nz[i]);
+        f32 l_length = sqrtf(lx * lx + ly * ly + lz * lz);
+
+        f32 ndotl   = (nx[i] * lx + ny[i] * ly + nz[i] * lz) / (n_length * l_length);
+        f32 diffuse = max(ndotl, 0.0f) + 0.03f;
+
+        batch->r[i] = albedo.r[i] * diffuse;
+        batch->g[i] = albedo.g[i] * diffuse;
+        batch->b[i] = albedo.b[i] * diffuse;
+        batch->a[i] = 1.0f;
+    }
+}
+
+
+
+// the helmet shaded with the per pixel lambert shader (through the adapter)
+// and with its batch version, in forward and visibility mode
+void bench_batched_pixel_shaders() {
+    printf("\n== batched pixel shaders (lambert helmet, %u frames) ==\n", frames);
+
+    std::vector<Vertex> vertices;
+    std::vector<u32>    indices;
+    load_obj_file_indexed("./assets/models/helmet/helmet.obj", &vertices, &indices);
+
+    SrTexture albedo = utils_load_texture_from_file("./assets/models/helmet/helmet_albedo.png");
+
+    SrFramebufferSpec framebuffer_specs {};
+    framebuffer_specs.width  = width;
+    framebuffer_specs.height = height;
+    SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+    // the close up has bigger triangles, so more covered pixels per batch
+    UniformBuffer ubos[2] = { default_uniform_buffer(), default_uniform_buffer() };
+    ubos[1].view_pos = vec3(0.5f, 0.5f, -1.0f);
+    ubos[1].view     = look_at(ubos[1].view_pos, vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
+
+    const char* scene_names[] = {"helmet", "close up"};
+    const char* mode_names[]  = {"forward", "visibility"};
+
+    for (u32 scene = 0; scene < 2; scene++)
+    for (u32 mode = SR_SHADING_MODE_FORWARD; mode <= SR_SHADING_MODE_VISIBILITY; mode++) {
+        std::vector<sr_vec4> reference;
+
+        for (u32 batched = 0; batched < 2; batched++) {
+            SrPipelineSpec pipeline_specs = default_pipeline_spec(&framebuffer);
+            pipeline_specs.shading_mode       = (SrShadingMode)mode;
+            pipeline_specs.batch_pixel_shader = batched ? &lambert_batch_pixel_shader : NULL;
+
+            SrPipeline pipeline = sr_create_pipeline(pipeline_specs);
+            sr_pipeline_upload_texture(&pipeline, &albedo, 0);
+            sr_pipeline_upload_uniform_buffer(&pipeline, &ubos[scene], 0);
+
+            f64 draw_ms = 0.0;
+
+            for (u32 frame = 0; frame < frames; frame++) {
+                begin_frame(&framebuffer);
+
+                f64 start = time_now_ms();
+                sr_draw_indexed(&pipeline, indices.data(), indices.size(), vertices.data(), vertices.size());
+                draw_ms += time_now_ms() - start;
+            }
+
+
+            u32 different = 0;
+            for (u32 y = 0; y < height; y++) {
+                for (u32 x = 0; x < width; x++) {
+                    sr_vec4 color = sr_framebuffer_get_color(&framebuffer, x, y);
+
+                    if (!batched)
+                        reference.push_back(color);
+                    else if (fabsf(color.x - reference[y * width + x].x) > 0.01f)
+                        different += 1;
+                }
+            }
+
+            printf("%-8s %-10s %-9s : draw %6.2f ms, %7u pixels, %u pixels differ\n", scene_names[scene], mode_names[mode], 
+                   batched ? "batch" : "per pixel", draw_ms / frames, shaded_pixels(&pipeline), different);
+
+            sr_destroy_pipeline(&pipeline);
+        }
+    }
+
+    sr_texture_free(&albedo);
+    sr_framebuffer_free(&framebuffer);
+}
+
+
+
+
+
+
+
+// ==================================================================
+// ===================== BATCHED VERTEX SHADERS =====================
+// ==================================================================
+
+
+// vertex_shader over a whole batch, the matrices only depend on the draw
+// so they are multiplied once per batch instead of once per vertex
+void batch_vertex_shader(SrVertexBatch* batch, SrGlobalRegistry* reg) {
+    UniformBuffer& ubo = *sr_get_uniform_buffer(UniformBuffer, reg, 0);
+
+    mat4 view_proj    = ubo.proj * ubo.view;
+    mat3 normal_model = mat3(ubo.model);
+
+    for (u32 i = 0; i < batch->count; i++) {
+        Vertex* vertex = sr_batch_vertex(Vertex, batch, i);
+
+        vec4 world_pos = ubo.model * vec4(vertex->pos, 1.0f);
+
+        Variant* variant   = sr_batch_output(Variant, batch, i);
+        variant->world_pos = vec3(world_pos.x, world_pos.y, world_pos.z);
+        variant->normal    = normal_model * vertex->normal;
+        variant->uv        = vertex->uv;
+
+        vec4 pos = view_proj * world_pos;
+        batch->positions[i] = {pos.x, pos.y, pos.z, pos.w};
+    }
+}
+
+
+
+static f64 vertex_stage_ms(SrPipeline* pipeline) {
+    f64 ms = 0.0;
+    for (u32 i = 0; i < pipeline->stats.worker_count; i++)
+        ms += pipeline->stats.workers[i].vertex_ms;
+    return ms;
+}
+
+
+
+// the helmet drawn expanded and indexed with the per vertex shader and its
+// batch version, the vertex stage time comes from the pipeline stats
+void bench_batched_vertex_shaders() {
+    printf("\n== batched vertex shaders (helmet, %u frames) ==\n", frames);
+
+    std::vector<Vertex> expanded;
+    load_obj_file("./assets/models/helmet/helmet.obj", &expanded);
+
+    std::vector<Vertex> vertices;
+    std::vector<u32>    indices;
+    load_obj_file_indexed("./assets/models/helmet/helmet.obj", &vertices, &indices);
+
+    SrTexture albedo = utils_load_texture_from_file("./assets/models/helmet/helmet_albedo.png");
+
+    SrFramebufferSpec framebuffer_specs {};
+    framebuffer_specs.width  = width;
+    framebuffer_specs.height = height;
+    SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+    UniformBuffer ubo = default_uniform_buffer();
+
+    const char* draw_names[] = {"expanded", "indexed"};
+
+    for (u32 indexed = 0; indexed < 2; indexed++) {
+        std::vector<sr_vec4> reference;
+
+        for (u32 batched = 0; batched < 2; batched++) {
+            SrPipelineSpec pipeline_specs = default_pipeline_spec(&framebuffer);
+            pipeline_specs.batch_vertex_shader = batched ? &batch_vertex_shader : NULL;
+
+            SrPipeline pipeline = sr_create_pipeline(pipeline_specs);
+            sr_pipeline_upload_texture(&pipeline, &albedo, 0);
+            sr_pipeline_upload_uniform_buffer(&pipeline, &ubo, 0);
+
+            f64 vertex_ms = 0.0;
+
+            for (u32 frame = 0; frame < frames; frame++) {
+                begin_frame(&framebuffer);
+
+                if (indexed)
+                    sr_draw_indexed(&pipeline, indices.data(), indices.size(), vertices.data(), vertices.size());
+                else
+                    sr_draw(&pipeline, expanded.size(), expanded.data());
+
+                vertex_ms += vertex_stage_ms(&pipeline);
+            }
+
+
+            // both shaders do the same float operations in the same order
+            u32 different = 0;
+            for (u32 y = 0; y < height; y++) {
+                for (u32 x = 0; x < width; x++) {
+                    sr_vec4 color = sr_framebuffer_get_color(&framebuffer, x, y);
+
+                    if (!batched)
+                        reference.push_back(color);
+                    else if (color.x != reference[y * width + x].x)
+                        different += 1;
+                }
+            }
+
+            printf("%-8s %-10s : vertex stage %6.3f ms, %7u vertices, %u pixels differ\n", draw_names[indexed], 
+                   batched ? "batch" : "per vertex", vertex_ms / frames, vertex_shader_invocations(&pipeline), different);
+
+            sr_destroy_pipeline(&pipeline);
+        }
+    }
+
+    sr_texture_free(&albedo);
+    sr_framebuffer_free(&framebuffer);
+}
+
+
+
+
+
+
+
+// ==================================================================
+// ========================== DRAW PROLOGUE =========================
+// ==================================================================
+
+
+struct DrawConstants {
+    mat4 view_proj;
+    mat3 normal_model;
+};
+
+
+
+void draw_prologue(void* out, SrGlobalRegistry* reg) {
+    UniformBuffer& ubo       = *sr_get_uniform_buffer(UniformBuffer, reg, 0);
+    DrawConstants* constants = (DrawConstants*)out;
+
+    constants->view_proj    = ubo.proj * ubo.view;
+    constants->normal_model = mat3(ubo.model);
+}
+
+
+
+// vertex_shader with the matrices it derives from the uniform buffer 
+// read from the constants of the draw
+sr_vec4 prologue_vertex_shader(SrVertex in, SrVariant out, SrGlobalRegistry* reg) {
+    Vertex* vertex = (Vertex*)in;
+
+    UniformBuffer& ubo       = *sr_get_uniform_buffer(UniformBuffer, reg, 0);
+    DrawConstants* constants = sr_get_constants(DrawConstants, reg);
+
+    vec4 world_pos = ubo.model * vec4(vertex->pos, 1.0f);
+
+    Variant variant;
+    variant.world_pos = vec3(world_pos.x, world_pos.y, world_pos.z);
+    variant.normal    = constants->normal_model * vertex->normal;
+    variant.uv        = vertex->uv;
+
+    sr_upload_variant(out, variant);
+
+    vec4 pos = constants->view_proj * world_pos;
+    return {pos.x, pos.y, pos.z, pos.w};
+}
+
+
+
+// the expanded helmet with the per vertex shader recomputing its matrices 
+// and with them computed once by the prologue of the draw
+void bench_draw_prologue() {
+    printf("\n== draw prologue (expanded helmet, %u frames) ==\n", frames);
+
+    std::vector<Vertex> vertices;
+    load_obj_file("./assets/models/helmet/helmet.obj", &vertices);
+
+    SrTexture albedo = utils_load_texture_from_file("./assets/models/helmet/helmet_albedo.png");
+
+    SrFramebufferSpec framebuffer_specs {};
+    framebuffer_specs.width  = width;
+    framebuffer_specs.height = height;
+    SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+    UniformBuffer ubo = default_uniform_buffer();
+
+    std::vector<sr_vec4> reference;
+
+    for (u32 with_prologue = 0; with_prologue < 2; with_prologue++) {
+        SrPipelineSpec pipeline_specs = default_pipeline_spec(&framebuffer);
+
+        if (with_prologue) {
+            pipeline_specs.constants_info.byte_count = sizeof(DrawConstants);
+            pipeline_specs.prologue      = &draw_prologue;
+            pipeline_specs.vertex_shader = &prologue_vertex_shader;
+        }
+
+        SrPipeline pipeline = sr_create_pipeline(pipeline_specs);
+        sr_pipeline_upload_texture(&pipeline, &albedo, 0);
+        sr_pipeline_upload_uniform_buffer(&pipeline, &ubo, 0);
+
+        f64 vertex_ms = 0.0;
+
+        for (u32 frame = 0; frame < frames; frame++) {
+            begin_frame(&framebuffer);
+            sr_draw(&pipeline, vertices.size(), vertices.data());
+            vertex_ms += vertex_stage_ms(&pipeline);
+        }
+
+
+        // the prologue computes the same matrices, so the output is identical
+        u32 different = 0;
+        for (u32 y = 0; y < height; y++) {
+            for (u32 x = 0; x < width; x++) {
+                sr_vec4 color = sr_framebuffer_get_color(&framebuffer, x, y);
+
+                if (!with_prologue)
+                    reference.push_back(color);
+                else if (color.x != reference[y * width + x].x)
+                    different += 1;
+            }
+        }
+
+        printf("%-11s : vertex stage %6.3f ms, %7u vertices, %u pixels differ\n", with_prologue ? "prologue" : "per vertex", 
+               vertex_ms / frames, vertex_shader_invocations(&pipeline), different);
+
+        sr_destroy_pipeline(&pipeline);
+    }
+
+    sr_texture_free(&albedo);
+    sr_framebuffer_free(&framebuffer);
+}
+
+
+
+
+
+
+
+// ==================================================================
+// ======================== INSTANCED DRAWING =======================
+// ==================================================================
+
+
+struct Instance {
+    mat4 model;
+};
+
+
+
+// vertex_shader with the model matrix read from the instance stream
+sr_vec4 instanced_vertex_shader(SrVertex in, SrVariant out, SrGlobalRegistry* reg) {
+    Vertex* vertex = (Vertex*)in;
+
+    UniformBuffer& ubo = *sr_get_uniform_buffer(UniformBuffer, reg, 0);
+    Instance* instance = sr_get_instance(Instance, reg);
+
+    vec4 world_pos = instance->model * vec4(vertex->pos, 1.0f);
+
+    Variant variant;
+    variant.world_pos = vec3(world_pos.x, world_pos.y, world_pos.z);
+    variant.normal    = mat3(instance->model) * vertex->normal;
+    variant.uv        = vertex->uv;
+
+    sr_upload_variant(out, variant);
+
+    vec4 pos = ubo.proj * ubo.view * world_pos;
+    return {pos.x, pos.y, pos.z, pos.w};
+}
+
+
+
+// a unit cube with 4 vertices per face so every face gets its own normal
+static void build_cube(std::vector<Vertex>* vertices, std::vector<u32>* indices) {
+    vec3 normals[] = { vec3( 1, 0, 0), vec3(-1, 0, 0), vec3(0,  1, 0), 
+                       vec3( 0,-1, 0), vec3( 0, 0, 1), vec3(0,  0,-1) };
+
+    for (vec3 n : normals) {
+        vec3 u = n.x != 0.0f ? vec3(0, n.x, 0) : (n.y != 0.0f ? vec3(0, 0, n.y) : vec3(n.z, 0, 0));
+        vec3 v = cross(n, u);
+
+        u32 first = vertices->size();
+        vec2 corners[] = { vec2(-1, -1), vec2(1, -1), vec2(1, 1), vec2(-1, 1) };
+
+        for (vec2 c : corners) {
+            Vertex vert;
+            vert.pos    = (n + u * c.x + v * c.y) * 0.5f;
+            vert.normal = n;
+            vert.uv     = vec2(c.x * 0.5f + 0.5f, c.y * 0.5f + 0.5f);
+            vertices->push_back(vert);
+        }
+
+        u32 quad[] = {0, 1, 2, 0, 2, 3};
+        for (u32 idx : quad)
+            indices->push_back(first + idx);
+    }
+}
+
+
+
+// a side x side grid of copies of the mesh, drawn with one sr_draw_indexed 
+// per copy (the model matrix uploaded before each of them) and with a 
+// single instanced draw
+static void instanced_drawing_case(const char* name, std::vector<Vertex>& vertices, std::vector<u32>& indices, 
+                                   u32 side, SrFramebuffer* framebuffer, SrTexture* albedo) {
+
+    UniformBuffer ubo = default_uniform_buffer();
+    mat4 model = ubo.model;
+
+    std::vector<Instance> instances;
+
+    for (u32 y = 0; y < side; y++) {
+        for (u32 x = 0; x < side; x++) {
+            vec3 offset = vec3(((f32)x + 0.5f) / side * 3.0f - 1.5f, ((f32)y + 0.5f) / side * 3.0f - 1.5f, 0.0f);
+
+            Instance instance;
+            instance.model = scale(translate(mat4(1.0f), offset), 1.5f / side) * model;
+            instances.push_back(instance);
+        }
+    }
+
+    std::vector<sr_vec4> reference;
+
+    for (u32 instanced = 0; instanced < 2; instanced++) {
+        SrPipelineSpec pipeline_specs = default_pipeline_spec(framebuffer);
+
+        if (instanced) {
+            pipeline_specs.vertex_input_info.instance_byte_count = sizeof(Instance);
+            pipeline_specs.vertex_shader = &instanced_vertex_shader;
+        }
+
+        SrPipeline pipeline = sr_create_pipeline(pipeline_specs);
+        sr_pipeline_upload_texture(&pipeline, albedo, 0);
+        sr_pipeline_upload_uniform_buffer(&pipeline, &ubo, 0);
+
+        f64 start = time_now_ms();
+
+        for (u32 frame = 0; frame < frames; frame++) {
+            begin_frame(framebuffer);
+
+            if (instanced) {
+                sr_draw_indexed_instanced(&pipeline, indices.data(), indices.size(), vertices.data(), vertices.size(), 
+                                          instances.size(), instances.data());
+                continue;
+            }
+
+            for (Instance& instance : instances) {
+                ubo.model = instance.model;
+                sr_pipeline_upload_uniform_buffer(&pipeline, &ubo, 0);
+                sr_draw_indexed(&pipeline, indices.data(), indices.size(), vertices.data(), vertices.size());
+            }
+        }
+
+        f64 frame_ms = (time_now_ms() - start) / frames;
+
+
+        // the instances are drawn in order with the same math, so the
+        // image matches the separate draws exactly
+        u32 different = 0;
+        for (u32 y = 0; y < height; y++) {
+            for (u32 x = 0; x < width; x++) {
+                sr_vec4 color = sr_framebuffer_get_color(framebuffer, x, y);
+
+                if (!instanced)
+                    reference.push_back(color);
+                else if (color.x != reference[y * width + x].x)
+                    different += 1;
+            }
+        }
+
+        printf("%5u %-7s %-9s : %7.2f ms/frame, %u pixels differ\n", side * side, name,
+               instanced ? "instanced" : "per draw", frame_ms, different);
+
+        sr_destroy_pipeline(&pipeline);
+    }
+}
+
+
+
+void bench_instanced_drawing() {
+    printf("\n== instanced drawing (grids of meshes, %u frames) ==\n", frames);
+
+    std::vector<Vertex> helmet_vertices;
+    std::vector<u32>    helmet_indices;
+    load_obj_file_indexed("./assets/models/helmet/helmet.obj", &helmet_vertices, &helmet_indices);
+
+    std::vector<Vertex> cube_vertices;
+    std::vector<u32>    cube_indices;
+    build_cube(&cube_vertices, &cube_indices);
+
+    SrTexture albedo = utils_load_texture_from_file("./assets/models/helmet/helmet_albedo.png");
+
+    SrFramebufferSpec framebuffer_specs {};
+    framebuffer_specs.width  = width;
+    framebuffer_specs.height = height;
+    SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+    // the draw overhead only matters next to small meshes
+    instanced_drawing_case("helmets", helmet_vertices, helmet_indices, 4,  &framebuffer, &albedo);
+    instanced_drawing_case("cubes",   cube_vertices,   cube_indices,   16, &framebuffer, &albedo);
+    instanced_drawing_case("cubes",   cube_vertices,   cube_indices,   48, &framebuffer, &albedo);
+
+    sr_texture_free(&albedo);
+    sr_framebuffer_free(&framebuffer);
+}
+
+
+
+
+
+
+
+// ==================================================================
+// ======================== COMMAND BUFFERS =========================
+// ==================================================================
+
+
+
+// the same side x side grid of cubes drawn with one sr_draw_indexed per
+// cube, then recorded in a command buffer (a uniform buffer bound before
+// each draw) and submitted. with the fence the next frame is recorded
+// while the previous one runs. when mixed, every other cube is drawn
+// larger by a second pipeline without depth test, so the cubes overlap
+// and the image depends on the order of the draws
+static void command_buffers_case(std::vector<Vertex>& vertices, std::vector<u32>& indices, u32 side, 
+                                 bool mixed, SrFramebuffer* framebuffer, SrTexture* albedo, SrTexture* overlay) {
+
+    UniformBuffer ubo = default_uniform_buffer();
+    mat4 model = ubo.model;
+
+    // the command buffers point to the uniform buffers until they're submitted
+    std::vector<UniformBuffer> ubos;
+
+    for (u32 y = 0; y < side; y++) {
+        for (u32 x = 0; x < side; x++) {
+            vec3 offset = vec3(((f32)x + 0.5f) / side * 3.0f - 1.5f, ((f32)y + 0.5f) / side * 3.0f - 1.5f, 0.0f);
+
+            f32 size = mixed && (ubos.size() % 2) ? 3.0f : 1.5f;
+
+            UniformBuffer cube = ubo;
+            cube.model = scale(translate(mat4(1.0f), offset), size / side) * model;
+            ubos.push_back(cube);
+        }
+    }
+
+    const char* names[] = {"per draw", "submit", "fenced"};
+
+    std::vector<sr_vec4> reference;
+
+    for (u32 mode = 0; mode < 3; mode++) {
+        SrPipeline pipeline = sr_create_pipeline(default_pipeline_spec(framebuffer));
+        sr_pipeline_upload_texture(&pipeline, albedo, 0);
+        sr_pipeline_upload_uniform_buffer(&pipeline, &ubo, 0);
+
+        SrPipelineSpec overlay_specs = default_pipeline_spec(framebuffer);
+        overlay_specs.depth_info.depth_test_enabled = false;
+
+        SrPipeline overlay_pipeline = sr_create_pipeline(overlay_specs);
+        sr_pipeline_upload_texture(&overlay_pipeline, overlay, 0);
+        sr_pipeline_upload_uniform_buffer(&overlay_pipeline, &ubo, 0);
+
+        SrPipeline* pipelines[] = { &pipeline, mixed ? &overlay_pipeline : &pipeline };
+
+        SrCommandBuffer cmds[2] = { sr_command_buffer_create(), sr_command_buffer_create() };
+        SrFence* fence = sr_fence_create();
+
+        f64 start = time_now_ms();
+
+        for (u32 frame = 0; frame < frames; frame++) {
+
+            if (mode == 0) {
+                begin_frame(framebuffer);
+
+                for (u32 i = 0; i < ubos.size(); i++) {
+                    sr_pipeline_upload_uniform_buffer(pipelines[i % 2], &ubos[i], 0);
+                    sr_draw_indexed(pipelines[i % 2], indices.data(), indices.size(), vertices.data(), vertices.size());
+                }
+                continue;
+            }
+
+            SrCommandBuffer* cmd = &cmds[frame % 2];
+            sr_command_buffer_reset(cmd);
+
+            sr_cmd_clear_color(cmd, framebuffer, {0.04f, 0.04f, 0.04f, 1.0f});
+            sr_cmd_clear_depth(cmd, framebuffer, 1.0f);
+
+            for (u32 i = 0; i < ubos.size(); i++) {
+                if (i == 0 || pipelines[i % 2] != pipelines[(i - 1) % 2])
+                    sr_cmd_bind_pipeline(cmd, pipelines[i % 2]);
+
+                sr_cmd_bind_uniform_buffer(cmd, &ubos[i], 0);
+                sr_cmd_draw_indexed(cmd, indices.data(), indices.size(), vertices.data(), vertices.size());
+            }
+
+            sr_submit(cmd, 1, mode == 2 ? fence : NULL);
+        }
+
+        sr_fence_wait(fence);
+
+        f64 frame_ms = (time_now_ms() - start) / frames;
+
+
+        // the draws keep their order in the merged raster passes, so the
+        // image matches the separate draws exactly
+        u32 different = 0;
+        for (u32 y = 0; y < height; y++) {
+            for (u32 x = 0; x < width; x++) {
+                sr_vec4 color = sr_framebuffer_get_color(framebuffer, x, y);
+
+                if (mode == 0)
+                    reference.push_back(color);
+                else if (color.x != reference[y * width + x].x)
+                    different += 1;
+            }
+        }
+
+        printf("%5u cubes %-5s %-8s : %7.2f ms/frame, %u pixels differ\n", side * side, mixed ? "mixed" : "",
+               names[mode], frame_ms, different);
+
+        sr_fence_destroy(fence);
+        sr_command_buffer_free(&cmds[0]);
+        sr_command_buffer_free(&cmds[1]);
+        sr_destroy_pipeline(&overlay_pipeline);
+        sr_destroy_pipeline(&pipeline);
+    }
+}
+
+
+
+void bench_command_buffers() {
+    printf("\n== command buffers (grids of cubes, %u frames) ==\n", frames);
+
+    std::vector<Vertex> cube_vertices;
+    std::vector<u32>    cube_indices;
+    build_cube(&cube_vertices, &cube_indices);
+
+    SrTexture albedo   = utils_load_texture_from_file("./assets/models/helmet/helmet_albedo.png");
+    SrTexture emission = utils_load_texture_from_file("./assets/models/helmet/helmet_emission.png");
+
+    SrFramebufferSpec framebuffer_specs {};
+    framebuffer_specs.width  = width;
+    framebuffer_specs.height = height;
+    SrFramebuffer framebuffer = sr_framebuffer_create(framebuffer_specs);
+
+    command_buffers_case(cube_vertices, cube_indices, 16, false, &framebuffer, &albedo, &emission);
+    command_buffers_case(cube_vertices, cube_indices, 48, false, &framebuffer, &albedo, &emission);
+    command_buffers_case(cube_vertices, cube_indices, 16, true,  &framebuffer, &albedo, &emission);
+    command_buffers_case(cube_vertices, cube_indices, 48, true,  &framebuffer, &albedo, &emission);
+
+    sr_texture_free(&emission);
+    sr_texture_free(&albedo);
+    sr_framebuffer_free(&framebuffer);
+}
+
+
+
+
+
+
+
+
+int main(void) {
+
+    bench_indexed_drawing();
+    bench_simd_coverage();
+    bench_block_traversal();
+    bench_watertight_fan();
+    bench_clipping_fly_through();
+    bench_frame_arena();
+    bench_color_formats();
+    bench_depth_formats();
+    bench_hierarchical_z();
+    bench_visibility_buffer();
+    bench_fragment_functions();
+    bench_mipmapping();
+    bench_texture_layouts();
+    bench_texture_storage();
+    bench_channel_packing();
+    bench_block_compression();
+    bench_batched_sampling();
+    bench_plane_equations();
+    bench_batched_pixel_shaders();
+    bench_batched_vertex_shaders();
+    bench_draw_prologue();
+    bench_instanced_drawing();
+    bench_command_buffers();
+
+    return 0;
+}
@@ -32,13 +32,98 @@ inline SrTexture utils_load_texture_from_file(const char* path) {
 }
 
 
+// packs the first channel of every file into one texture, 
+// e.g. an occlusion / roughness / metalness map
+inline SrTexture utils_load_packed_texture_from_files(const char** paths, u32 count) {
+    stbi_set_flip_vertically_on_load(true);
+
+    sr_u8* sources[4];
+    sr_u32 sources_channels[4];
+    sr_i32 width, height;
+
+    for (u32 i = 0; i < count; i++) {
+        sr_i32 channels;
+        sources[i] = stbi_load(paths[i], &width, &height, &channels, 0);
+        sources_channels[i] = channels;
+
+        if (!sources[i]) 
+            assert(false && "Failed to load the texture correctly! \n");
+    }
+
+    SrTextureSpec specs {};
+    specs.filter        = SR_FILTER_NEAREST;
+    specs.sampling_mode = SR_SAMPLING_MODE_REPEAT;
+    specs.format        = (SrFormat)count;
+    specs.width         = width;
+    specs.height        = height;
+
+    SrTexture texture = sr_texture_create_packed(specs, sources, sources_channels);
+
+    for (u32 i = 0; i < count; i++)
+        stbi_image_free(sources[i]);
+
+    return texture;
+}
+
+
+// offline step of the block compressed textures, encodes the image and its 
+// mips to format and writes the blocks after a width, height, format header
+inline void utils_compress_texture_file(const char* src_path, const char* dst_path, SrFormat format) {
+    SrTexture texture = utils_load_texture_from_file(src_path);
+
+    sr_usize size;
+    sr_u8* blocks = sr_texture_compress(&texture, format, &size);
+
+    FILE* file = fopen(dst_path, "wb");
+    assert(file && "Failed to open the compressed texture file! \n");
+
+    u32 header[3] = { texture.spec.width, texture.spec.height, (u32)format };
+    fwrite(header, sizeof(header), 1, file);
+    fwrite(blocks, 1, size, file);
+    fclose(file);
+
+    free(blocks);
+    sr_texture_free(&texture);
+}
+
+
+inline SrTexture utils_load_compressed_texture_from_file(const char* path) {
+    FILE* file = fopen(path, "rb");
+    assert(file && "Failed to open the compressed texture file! \n");
+
+    u32 header[3];
+    fread(header, sizeof(header), 1, file);
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file) - (long)sizeof(header);
+    fseek(file, sizeof(header), SEEK_SET);
+
+    sr_u8* blocks = (sr_u8*)malloc(size);
+    fread(blocks, 1, size, file);
+    fclose(file);
+
+    SrTextureSpec specs {};
+    specs.filter        = SR_FILTER_NEAREST;
+    specs.sampling_mode = SR_SAMPLING_MODE_REPEAT;
+    specs.format        = (SrFormat)header[2];
+    specs.width         = header[0];
+    specs.height        = header[1];
+
+    SrTexture texture = sr_texture_create(specs, blocks);
+    free(blocks);
+
+    return texture;
+}
+
+
 inline void write_framebuffer_to_file(SrFramebuffer* fb, const char* file_path) {
     u32 size = fb->spec.width * fb->spec.height;
 
     u32* buffer = (u32*)malloc(size * 4);
 
     for (u32 i = 0; i < size; i++) {
-        buffer[i] = pack_vec4_to_u32(rgba_to_argb(*(vec4*)&fb->color_buffer[i]));
+        sr_vec4 color = sr_framebuffer_get_color(fb, i % fb->spec.width, i / fb->spec.width);
+        buffer[i] = pack_vec4_to_u32(rgba_to_argb(*(vec4*)&color));
     }
 
     write_bmp(file_path, (u8*)buffer, fb->spec.width, fb->spec.height);
@@ -82,6 +82,14 @@ struct UniformBuffer {
     vec3 view_pos;
 };
 
+// everything the shaders derive from the uniform buffer, computed once
+// per draw by the prologue
+struct Constants {
+    mat4 mvp;
+    mat3 normal_model;
+    vec3 light_dir;
+};
+
 
 
 void load_obj_file(const char* file_path, std::vector<Vertex>* out)
@@ -148,27 +156,29 @@ f32 v_smith_ggx_fast(f32 ndotv, f32 ndotl, f32 roughness) {
 sr_vec4 pbr_pixel_shader(SrVariant variants, SrGlobalRegistry* reg) {
     Variant* in = (Variant*)variants;
 
-    UniformBuffer& ubo = *sr_get_uniform_buffer(UniformBuffer, reg, 0);
+    UniformBuffer& ubo   = *sr_get_uniform_buffer(UniformBuffer, reg, 0);
+    Constants* constants = sr_get_constants(Constants, reg);
     vec3 view_pos  = ubo.view_pos;
-    vec3 light_pos = ubo.view_pos;
 
-    sr_vec4 albedo_t    = sr_texel(reg, 0, in->uv.x, in->uv.y);
-    sr_vec4 roughness_t = sr_texel(reg, 1, in->uv.x, in->uv.y);
-    sr_vec4 metalness_t = sr_texel(reg, 2, in->uv.x, in->uv.y);
-    sr_vec4 occlusion_t = sr_texel(reg, 3, in->uv.x, in->uv.y);
-    sr_vec4 emission_t  = sr_texel(reg, 4, in->uv.x, in->uv.y);
+    vec2 ddx = sr_ddx(Variant, in, uv);
+    vec2 ddy = sr_ddy(Variant, in, uv);
+
+    // occlusion, roughness and metalness are packed in a single texture
+    sr_vec4 albedo_t    = sr_texel_grad(reg, 0, in->uv.x, in->uv.y, ddx, ddy);
+    sr_vec4 orm_t       = sr_texel_grad(reg, 1, in->uv.x, in->uv.y, ddx, ddy);
+    sr_vec4 emission_t  = sr_texel_grad(reg, 2, in->uv.x, in->uv.y, ddx, ddy);
 
     vec3 albedo   = {albedo_t.x, albedo_t.y, albedo_t.z};
     vec3 emission = {emission_t.x, emission_t.y, emission_t.z};
-    f32 roughness = clamp(roughness_t.x, 0.089f, 1.0f);
-    f32 metalness = metalness_t.x;
-    f32 occlusion = occlusion_t.x;
+    f32 roughness = clamp(orm_t.y, 0.089f, 1.0f);
+    f32 metalness = orm_t.z;
+    f32 occlusion = orm_t.x;
 
     vec3 radiance = vec3(1.0f, 1.0f, 1.0f) * 2.0f;
 
     vec3 normal       = normalize(in->normal);
     vec3 view_dir     = normalize(view_pos - in->world_pos);
-    vec3 light_dir    = normalize(light_pos);
+    vec3 light_dir    = constants->light_dir;
     vec3 halfway      = normalize(light_dir + view_dir);
 
 
@@ -202,22 +212,35 @@ sr_vec4 pbr_pixel_shader(SrVariant variants, SrGlobalRegistry* reg) {
 
 
 
-sr_vec4 vertex_shader(SrVertex in, SrVariant out, SrGlobalRegistry* reg) {
-    Vertex* vertex = (Vertex*)in;
+void prologue(void* out, SrGlobalRegistry* reg) {
+    UniformBuffer& ubo   = *sr_get_uniform_buffer(UniformBuffer, reg, 0);
+    Constants* constants = (Constants*)out;
+
+    constants->mvp          = ubo.proj * ubo.view * ubo.model;
+    constants->normal_model = mat3(ubo.model);
+    constants->light_dir    = normalize(ubo.view_pos);
+}
+
 
-    UniformBuffer& ubo = *sr_get_uniform_buffer(UniformBuffer, reg, 0);
 
-    vec4 pos = vec4(vertex->pos, 1.0f);
+void vertex_shader(SrVertexBatch* batch, SrGlobalRegistry* reg) {
+    UniformBuffer& ubo   = *sr_get_uniform_buffer(UniformBuffer, reg, 0);
+    Constants* constants = sr_get_constants(Constants, reg);
 
-    Variant variant;
-    variant.world_pos = (ubo.model * vec4(vertex->pos, 1.0f)).xyz;
-    variant.normal    = mat3(ubo.model) * vertex->normal;
-    variant.uv        = vertex->uv;
+    for (u32 i = 0; i < batch->count; i++) {
+        Vertex* vertex = sr_batch_vertex(Vertex, batch, i);
+        vec4 pos = vec4(vertex->pos, 1.0f);
 
-    sr_upload_variant(out, variant);
+        Variant variant;
+        variant.world_pos = (ubo.model * pos).xyz;
+        variant.normal    = constants->normal_model * vertex->normal;
+        variant.uv        = vertex->uv;
 
-    pos = ubo.proj * ubo.view * ubo.model * pos;
-    return {pos.x, pos.y, pos.z, pos.w};
+        sr_upload_variant(sr_batch_output(Variant, batch, i), variant);
+
+        pos = constants->mvp * pos;
+        batch->positions[i] = {pos.x, pos.y, pos.z, pos.w};
+    }
 }
 
 
@@ -255,16 +278,25 @@ int main(void) {
     std::vector<Vertex> buff;
     load_obj_file("./assets/models/helmet/helmet.obj", &buff);
 
-    SrTexture textures[5];
+    const char* orm_paths[] = {
+        "./assets/models/helmet/helmet_occlusion.png",
+        "./assets/models/helmet/helmet_roughness.png",
+        "./assets/models/helmet/helmet_metalness.png",
+    };
+
+    SrTexture textures[3];
     textures[0] = utils_load_texture_from_file("./assets/models/helmet/helmet_albedo.png");
-    textures[1] = utils_load_texture_from_file("./assets/models/helmet/helmet_roughness.png");
-    textures[2] = utils_load_texture_from_file("./assets/models/helmet/helmet_metalness.png");
-    textures[3] = utils_load_texture_from_file("./assets/models/helmet/helmet_occlusion.png");
-    textures[4] = utils_load_texture_from_file("./assets/models/helmet/helmet_emission.png");
+    textures[1] = utils_load_packed_texture_from_files(orm_paths, 3);
+    textures[2] = utils_load_texture_from_file("./assets/models/helmet/helmet_emission.png");
+
+    for (u32 i = 0; i < 3; i++)
+        sr_texture_set_filter_mode(&textures[i], SR_FILTER_TRILINEAR);
 
     SrFramebufferSpec framebuffer_specs;
     framebuffer_specs.width  = width;
     framebuffer_specs.height = height;
+    framebuffer_specs.color_format = SR_COLOR_FORMAT_RGBA8_UNORM;
+    framebuffer_specs.depth_format = SR_DEPTH_FORMAT_D32F;
 
     framebuffer = sr_framebuffer_create(framebuffer_specs);
 
@@ -287,21 +319,28 @@ int main(void) {
     vertex_input_info.byte_count = sizeof(Vertex);
 
     SrVariantsInfo variants_info {};
-    variants_info.byte_count = sizeof(Variant);
+    variants_info.byte_count  = sizeof(Variant);
+    variants_info.derivatives = true;
 
     SrColorBlendInfo color_blend_info {};
     color_blend_info.blend_enabled    = false;
 
+    SrConstantsInfo constants_info {};
+    constants_info.byte_count = sizeof(Constants);
+
     SrPipelineSpec pipeline_specs {};
-    pipeline_specs.primitve_type     = SR_PRIMITIVE_TYPE_TRIANGLE_LIST;
-    pipeline_specs.depth_info        = depth_info;
-    pipeline_specs.rasterizer_info   = rasterizer_info;
-    pipeline_specs.vertex_input_info = vertex_input_info;
-    pipeline_specs.variants_info     = variants_info;
-    pipeline_specs.color_blend_info  = color_blend_info;
-    pipeline_specs.framebuffer       = &framebuffer;
-    pipeline_specs.vertex_shader     = &vertex_shader;
-    pipeline_specs.pixel_shader      = &pbr_pixel_shader;
+    pipeline_specs.primitve_type       = SR_PRIMITIVE_TYPE_TRIANGLE_LIST;
+    pipeline_specs.depth_info          = depth_info;
+    pipeline_specs.rasterizer_info     = rasterizer_info;
+    pipeline_specs.vertex_input_info   = vertex_input_info;
+    pipeline_specs.variants_info       = variants_info;
+    pipeline_specs.color_blend_info    = color_blend_info;
+    pipeline_specs.shading_mode        = SR_SHADING_MODE_VISIBILITY;
+    pipeline_specs.framebuffer         = &framebuffer;
+    pipeline_specs.constants_info      = constants_info;
+    pipeline_specs.prologue            = &prologue;
+    pipeline_specs.batch_vertex_shader = &vertex_shader;
+    pipeline_specs.pixel_shader        = &pbr_pixel_shader;
 
 
 
@@ -320,8 +359,6 @@ int main(void) {
     sr_pipeline_upload_texture(&pipeline, &textures[0], 0);
     sr_pipeline_upload_texture(&pipeline, &textures[1], 1);
     sr_pipeline_upload_texture(&pipeline, &textures[2], 2);
-    sr_pipeline_upload_texture(&pipeline, &textures[3], 3);
-    sr_pipeline_upload_texture(&pipeline, &textures[4], 4);
 
 
     MSG msg = { };
@@ -353,6 +390,7 @@ int main(void) {
 
 
     // cleanup
+    sr_destroy_pipeline(&pipeline);
     sr_framebuffer_free(&framebuffer);
     for (u32 i = 0; i < sizeof(textures) / sizeof(textures[0]); i++) {
         if (textures[i].buffer)
@@ -82,6 +82,13 @@ struct UniformBuffer {
     vec3 view_pos;
 };
 
+// everything the shaders derive from the uniform buffer, computed once
+// per draw by the prologue
+struct Constants {
+    mat4 mvp;
+    mat3 normal_model;
+};
+
 
 
 void load_obj_file(const char* file_path, std::vector<Vertex>* out)
@@ -146,21 +153,32 @@ sr_vec4 phong_pixel_shader(SrVariant variants, SrGlobalRegistry* reg) {
 
 
 
+void prologue(void* out, SrGlobalRegistry* reg) {
+    UniformBuffer& ubo   = *sr_get_uniform_buffer(UniformBuffer, reg, 0);
+    Constants* constants = (Constants*)out;
+
+    constants->mvp          = ubo.proj * ubo.view * ubo.model;
+    constants->normal_model = mat3(ubo.model);
+}
+
+
+
 sr_vec4 vertex_shader(SrVertex in, SrVariant out, SrGlobalRegistry* reg) {
     Vertex* vertex = (Vertex*)in;
 
-    UniformBuffer& ubo = *sr_get_uniform_buffer(UniformBuffer, reg, 0);
+    UniformBuffer& ubo   = *sr_get_uniform_buffer(UniformBuffer, reg, 0);
+    Constants* constants = sr_get_constants(Constants, reg);
 
     vec4 pos = vec4(vertex->pos, 1.0f);
 
     Variant variant;
-    variant.world_pos = (ubo.model * vec4(vertex->pos, 1.0f)).xyz;
-    variant.normal    = mat3(ubo.model) * vertex->normal;
+    variant.world_pos = (ubo.model * pos).xyz;
+    variant.normal    = constants->normal_model * vertex->normal;
     variant.uv        = vertex->uv;
 
     sr_upload_variant(out, variant);
 
-    pos = ubo.proj * ubo.view * ubo.model * pos;
+    pos = constants->mvp * pos;
     return {pos.x, pos.y, pos.z, pos.w};
 }
 
@@ -206,6 +224,8 @@ int main(void) {
     SrFramebufferSpec framebuffer_specs;
     framebuffer_specs.width  = width;
     framebuffer_specs.height = height;
+    framebuffer_specs.color_format = SR_COLOR_FORMAT_RGBA8_UNORM;
+    framebuffer_specs.depth_format = SR_DEPTH_FORMAT_D32F;
 
     framebuffer = sr_framebuffer_create(framebuffer_specs);
 
@@ -233,6 +253,9 @@ int main(void) {
     SrColorBlendInfo color_blend_info {};
     color_blend_info.blend_enabled    = false;
 
+    SrConstantsInfo constants_info {};
+    constants_info.byte_count = sizeof(Constants);
+
     SrPipelineSpec pipeline_specs {};
     pipeline_specs.primitve_type     = SR_PRIMITIVE_TYPE_TRIANGLE_LIST;
     pipeline_specs.depth_info        = depth_info;
@@ -241,6 +264,8 @@ int main(void) {
     pipeline_specs.variants_info     = variants_info;
     pipeline_specs.color_blend_info  = color_blend_info;
     pipeline_specs.framebuffer       = &framebuffer;
+    pipeline_specs.constants_info    = constants_info;
+    pipeline_specs.prologue          = &prologue;
     pipeline_specs.vertex_shader     = &vertex_shader;
     pipeline_specs.pixel_shader      = &phong_pixel_shader;
 
@@ -289,6 +314,7 @@ int main(void) {
 
 
     // cleanup
+    sr_destroy_pipeline(&pipeline);
     sr_framebuffer_free(&framebuffer);
     sr_texture_free(&texture);
 
@@ -164,6 +164,8 @@ int main(void) {
     SrFramebufferSpec framebuffer_specs;
     framebuffer_specs.width  = width;
     framebuffer_specs.height = height;
+    framebuffer_specs.color_format = SR_COLOR_FORMAT_RGBA8_UNORM;
+    framebuffer_specs.depth_format = SR_DEPTH_FORMAT_D32F;
 
     framebuffer = sr_framebuffer_create(framebuffer_specs);
 
@@ -234,6 +236,7 @@ int main(void) {
 
 
     // cleanup
+    sr_destroy_pipeline(&pipeline);
     sr_framebuffer_free(&framebuffer);
     sr_texture_free(&texture);
 
@@ -126,6 +126,8 @@ int main(void) {
     SrFramebufferSpec framebuffer_specs;
     framebuffer_specs.width  = width;
     framebuffer_specs.height = height;
+    framebuffer_specs.color_format = SR_COLOR_FORMAT_RGBA8_UNORM;
+    framebuffer_specs.depth_format = SR_DEPTH_FORMAT_D32F;
 
     framebuffer = sr_framebuffer_create(framebuffer_specs);
     sr_framebuffer_clear_color(&framebuffer, {0.5f, 0.5f, 0.5f, 1.0f});
@@ -195,6 +197,7 @@ int main(void) {
 
 
     // cleanup
+    sr_destroy_pipeline(&pipeline);
     sr_framebuffer_free(&framebuffer);
 
 
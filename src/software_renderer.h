@@ -15,7 +15,9 @@ extern "C" {
 #include <assert.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <math.h>
+#include <float.h>
 
 typedef uint8_t                sr_u8;
 typedef uint16_t               sr_u16;
@@ -40,6 +42,10 @@ typedef intptr_t               sr_iptr;
 #define SR_EP                  0.0001f
 #define SR_MAX_TEXTURES_SLOTS  32
 #define SR_MAX_UNIFORMS_SLOTS  64
+#define SR_MAX_WORKERS         64
+#define SR_DEFAULT_TILE_SIZE   64
+#define SR_DEFAULT_CHUNK_SIZE  1024
+#define SR_DEFAULT_GUARD_BAND  4096.0f
 
 #define sr_min(a, b)           (a < b ? a : b)
 #define sr_max(a, b)           (a > b ? a : b)
@@ -92,6 +98,13 @@ typedef enum {
     SR_FORMAT_RGB  = 3,
     SR_FORMAT_RGBA = 4,
 
+    // block compressed, every 4x4 block of texels is stored in a fixed 
+    // number of bytes and only decoded when it's sampled
+    SR_FORMAT_BC1  = 16,  // RGB with 1 bit alpha, 8 bytes per block
+    SR_FORMAT_BC4  = 17,  // R, 8 bytes per block
+    SR_FORMAT_BC5  = 18,  // RG, 16 bytes per block
+    SR_FORMAT_BC7  = 19,  // RGBA, 16 bytes per block
+
 } SrFormat;
 
 
@@ -99,6 +112,7 @@ typedef enum {
 typedef enum {
     SR_FILTER_NEAREST,
     SR_FILTER_BILINEAR,
+    SR_FILTER_TRILINEAR,
 
 } SrFilter;
 
@@ -112,10 +126,23 @@ typedef enum {
 
 
 
+// order of the texels in memory. the tiled layouts keep the texels that are
+// close in both directions close in memory, so rotated and perspective
+// surfaces don't jump across rows on every fetch
+typedef enum {
+    SR_TEXTURE_LAYOUT_LINEAR    = 0,  // row major
+    SR_TEXTURE_LAYOUT_TILED_4X4 = 1,  // row major 4x4 blocks of row major texels
+    SR_TEXTURE_LAYOUT_MORTON    = 2,  // z-order curve
+
+} SrTextureLayout;
+
+
+
 typedef struct {
     SrFormat          format; 
     SrFilter          filter;
     SrSamplingMode    sampling_mode;
+    SrTextureLayout   layout;
     sr_u32            width;
     sr_u32            height;
 
@@ -123,17 +150,61 @@ typedef struct {
 
 
 
+#define SR_MAX_MIP_LEVELS 16
+
+
+
+// the level is stored as row major square blocks of (1 << block_shift) texels 
+// per side, linear is a block of a single texel. the block sides are padded
+typedef struct {
+    sr_u32 width;
+    sr_u32 height;
+    sr_u32 offset;
+    sr_u32 block_shift;
+    sr_u32 blocks_x;
+
+} SrMipLevel;
+
+
+
+// buffer holds every level of the mip chain one after the other, 
+// level 0 is the full size image. the texels are stored as 8 bit unorm 
+// channels and only converted to floats when sampled, R and RG textures
+// keep their channel count and RGB ones are padded to 4 bytes. the block
+// compressed formats always use the 4x4 tiled layout, so the texel index 
+// divided by 16 is the index of its block
 typedef struct {
     SrTextureSpec spec;
-    sr_vec4*    buffer;
+    sr_u8*        buffer;
+    sr_u32        texel_size;
+    sr_u32        block_size;   // bytes per 4x4 block, 0 if uncompressed
+    sr_u32        id;           // tells textures apart in the decoded blocks cache
+    SrMipLevel    levels[SR_MAX_MIP_LEVELS];
+    sr_u32        levels_count;
 
 } SrTexture;
 
 
 
+// buffer is specs.format interleaved 8 bit channels, or for the block 
+// compressed formats the blocks of the whole mip chain as returned by 
+// sr_texture_compress
 SrTexture sr_texture_create(SrTextureSpec specs, sr_u8* buffer);
 
 
+// encodes every level of an uncompressed texture to a block compressed 
+// format. the result is malloc'd and meant to be done offline, saved and 
+// later passed to sr_texture_create. size receives the byte count
+sr_u8* sr_texture_compress(SrTexture* texture, SrFormat format, sr_usize* size);
+
+
+// packs the first channel of specs.format different images into a single
+// texture (e.g. occlusion, roughness and metalness into an RGB one), so the
+// shader reads all of them with one fetch. sources_channels is the 
+// channel count of every source image
+SrTexture sr_texture_create_packed(SrTextureSpec specs, sr_u8** sources, sr_u32* sources_channels);
+
+
 void sr_texture_set_sampling_mode(SrTexture* texture, SrSamplingMode sampling_mode);
 
 
@@ -149,6 +220,37 @@ sr_vec4 sr_texture_get_pixel(SrTexture* texture, sr_u32 x, sr_u32 y);
 sr_vec4 sr_texture_sample(SrTexture* texture, sr_f32 u, sr_f32 v);
 
 
+// du/dx, dv/dx, du/dy and dv/dy are the uv derivatives along the screen axes, 
+// the trilinear filter uses them to pick the mip level. the other filters 
+// sample the level 0 like sr_texture_sample
+sr_vec4 sr_texture_sample_grad(SrTexture* texture, sr_f32 u, sr_f32 v, 
+                               sr_f32 dudx, sr_f32 dvdx, sr_f32 dudy, sr_f32 dvdy);
+
+
+
+#define SR_SAMPLE_BATCH_MAX 16
+
+
+
+// channels of a batched sample in SoA order, lane i of every array is 
+// the result of the uv pair i
+typedef struct {
+    sr_f32 r[SR_SAMPLE_BATCH_MAX];
+    sr_f32 g[SR_SAMPLE_BATCH_MAX];
+    sr_f32 b[SR_SAMPLE_BATCH_MAX];
+    sr_f32 a[SR_SAMPLE_BATCH_MAX];
+
+} SrSampleBatch;
+
+
+
+// samples count uv pairs (up to SR_SAMPLE_BATCH_MAX, best in multiples of 4)
+// with the same results as count calls to sr_texture_sample. the filter and
+// sampling mode are dispatched once and the texel addresses are computed 
+// 4 lanes at a time
+void sr_texture_sample_batch(SrTexture* texture, const sr_f32* u, const sr_f32* v, sr_u32 count, SrSampleBatch* out);
+
+
 
 
 
@@ -158,26 +260,79 @@ sr_vec4 sr_texture_sample(SrTexture* texture, sr_f32 u, sr_f32 v);
 
 
 
-// TODO(redone): add support for multiple buffers and formats
+// layout of a single pixel in the color buffer, the channels are always
+// stored in r, g, b, a order. R32F only keeps the red channel and reads
+// back with 0 for green and blue and 1 for alpha
+typedef enum {
+    SR_COLOR_FORMAT_RGBA32F     = 0,
+    SR_COLOR_FORMAT_RGBA8_UNORM = 1,
+    SR_COLOR_FORMAT_RGBA16F     = 2,
+    SR_COLOR_FORMAT_R32F        = 3,
+
+} SrColorFormat;
+
+
+
+// D24 and D16 store the depth as unsigned normalized integers so the
+// values get clamped to [0, 1], D24 takes the low 24 bits of 32-bit pixels
+typedef enum {
+    SR_DEPTH_FORMAT_D32F = 0,
+    SR_DEPTH_FORMAT_D24  = 1,
+    SR_DEPTH_FORMAT_D16  = 2,
+
+} SrDepthFormat;
+
+
+
+#define SR_DEPTH_BLOCK_SIZE 8
+
+
+
+// TODO(redone): add support for multiple buffers
 typedef struct {
-    sr_u32   width;
-    sr_u32   height;
-    // SrFormat color_format;
-    // SrFormat depth_format;
+    sr_u32        width;
+    sr_u32        height;
+    SrColorFormat color_format;
+    SrDepthFormat depth_format;
 
 } SrFramebufferSpec;
 
 
 
+// color_buffer and depth_buffer hold width * height pixels laid out as
+// spec.color_format and spec.depth_format
+//
+// clearing the depth only flags its SR_DEPTH_BLOCK_SIZE blocks, the
+// blocks are filled the first time a draw or sr_framebuffer_set_depth
+// touches them, so depth_buffer must be read through sr_framebuffer_get_depth
+//
+// every block also keeps a conservative range of the depths it holds 
+// (as stored, so the integers of the unorm formats), that the rasterizer
+// uses to skip the blocks a triangle can't pass the depth test in. a write
+// that overwrites one of the range ends flags the range as stale and it
+// gets recomputed the next time the rasterizer needs it
 typedef struct {
     SrFramebufferSpec spec;
-    sr_vec4*          color_buffer;
-    sr_f32*           depth_buffer;
+    void*             color_buffer;
+    void*             depth_buffer;
+    sr_u8*            depth_clear_pending;
+    sr_f32            depth_clear_value;
+    sr_u32            depth_blocks_x;
+    sr_f32*           depth_block_min;
+    sr_f32*           depth_block_max;
+    sr_u8*            depth_block_stale;
 
 } SrFramebuffer;
 
 
 
+sr_u32 sr_color_format_get_size(SrColorFormat format);
+
+
+sr_u32 sr_depth_format_get_size(SrDepthFormat format);
+
+
+
 SrFramebuffer sr_framebuffer_create(SrFramebufferSpec spec);
 
 
@@ -202,6 +357,11 @@ sr_vec4 sr_framebuffer_get_color(SrFramebuffer* fb, sr_u32 x, sr_u32 y);
 sr_f32 sr_framebuffer_get_depth(SrFramebuffer* fb, sr_u32 x, sr_u32 y);
 
 
+// converts the color buffer to tightly packed 8-bit rgba pixels, 
+// for SR_COLOR_FORMAT_RGBA8_UNORM framebuffers it's a plain copy
+void sr_framebuffer_resolve_rgba8(SrFramebuffer* fb, sr_u32* out);
+
+
 void sr_framebuffer_free(SrFramebuffer* fb);
 
 
@@ -209,6 +369,57 @@ void sr_framebuffer_free(SrFramebuffer* fb);
 
 
 
+// ==================================================================
+// =========================== ARENA ================================
+// ==================================================================
+
+
+
+#define SR_ARENA_ALIGNMENT     64
+#define SR_ARENA_MIN_BLOCK     (64 * 1024)
+
+
+
+typedef struct SrArenaBlock SrArenaBlock;
+
+
+
+// growable linear allocator for transient storage, allocations are only
+// released all at once by sr_arena_reset. when a block runs out a new one
+// is chained so the previous allocations never move, and the next reset
+// merges the chain into a single block as big as the high water mark, so
+// after a few frames the arena stops touching the system allocator
+typedef struct {
+    SrArenaBlock* block;
+    sr_usize      used;
+    sr_usize      high_water_mark;
+    sr_u32        reallocations_count;
+
+} SrArena;
+
+
+
+SrArena sr_arena_create(sr_usize capacity);
+
+
+void* sr_arena_alloc(SrArena* arena, sr_usize size);
+
+
+// grows the last allocation in place when it can, otherwise it gets copied
+// to a new allocation and the old one is only reclaimed on the next reset
+void* sr_arena_realloc(SrArena* arena, void* ptr, sr_usize old_size, sr_usize new_size);
+
+
+void sr_arena_reset(SrArena* arena);
+
+
+void sr_arena_free(SrArena* arena);
+
+
+
+
+
+
 // ==================================================================
 // ========================= PIPELINE ===============================
 // ==================================================================
@@ -291,10 +502,35 @@ typedef enum {
 
 
 
+// instruction set used to test the pixels coverage, AUTO picks the widest one
+// the cpu supports and a level the cpu doesn't support falls back to it as well
+typedef enum {
+    SR_SIMD_LEVEL_AUTO   = 0,
+    SR_SIMD_LEVEL_SCALAR = 1,
+    SR_SIMD_LEVEL_SSE2   = 2,
+    SR_SIMD_LEVEL_AVX2   = 3,
+
+} SrSimdLevel;
+
+
+
+// fixed_point_enabled snaps the vertices to a 16.8 fixed point grid and
+// rasterizes them with exact integer edge functions and a top-left fill rule,
+// so triangles sharing an edge never cover the same pixel twice nor leave
+// holes between them
+//
+// triangles are always clipped against the near plane (z >= -w) and against
+// the far plane (z <= w) when far_clip_enabled is set. the sides are only 
+// clipped once a vertex goes further than guard_band_size pixels off screen,
+// guard_band_size = 0 uses SR_DEFAULT_GUARD_BAND
 typedef struct {
     SrPolygonMode polygon_mode;
     SrCullMode    cull_mode;
     SrFrontFace   front_face;
+    SrSimdLevel   simd_level;
+    bool          fixed_point_enabled;
+    bool          far_clip_enabled;
+    sr_f32        guard_band_size;
     // sr_f32        line_width;
     // bool          line_smooth;
 
@@ -333,32 +569,177 @@ typedef struct {
 
 
 
+// constants is the per draw block written by the prologue of the pipeline,
+// it's NULL when the pipeline has no prologue. the vertex shaders also get
+// the instance of the vertex and its element of the instance stream (NULL
+// outside of sr_draw_instanced)
 typedef struct {
     SrTexture*     textures[SR_MAX_TEXTURES_SLOTS];
     SrUniform      uniforms[SR_MAX_UNIFORMS_SLOTS];
+    void*          constants;
+    void*          instance_data;
+    sr_u32         instance;
 
 } SrGlobalRegistry;
 
 
 
+// byte_count is the size of the block of constants the prologue fills
+typedef struct {
+    sr_usize byte_count;
+
+} SrConstantsInfo;
+
+
+
 // TODO(redone): add support for multiple variants
 // and properly support Variants interpolation
 typedef struct {
     sr_usize byte_count;
 
+    // the variants are also interpolated over the 2x2 quad of every shaded
+    // pixel, the pixel shader can then read their screen space derivatives
+    // with sr_ddx and sr_ddy (byte_count has to be the size of the variant type)
+    bool     derivatives;
+
 } SrVariantsInfo;
 
 
 
+typedef enum {
+    SR_INDEX_TYPE_U32 = 0,
+    SR_INDEX_TYPE_U16 = 1,
+
+} SrIndexType;
+
+
+
+// instance_byte_count is the size of an element of the instance 
+// stream of sr_draw_instanced, one element is read per instance
 typedef struct {
-    sr_usize byte_count;
+    sr_usize    byte_count;
+    sr_usize    instance_byte_count;
+    SrIndexType index_type;
 
 } SrVertexInputInfo;
 
 
 
-#define VertexFunctionPtr sr_vec4 (*vertex_shader)(SrVertex, SrVariant, SrGlobalRegistry*)
-#define PixelFunctionPtr  sr_vec4 (*pixel_shader)(SrVariant, SrGlobalRegistry*)
+// thread_count = 0 uses every hardware thread (up to SR_MAX_WORKERS), 
+// tile_size = 0 uses SR_DEFAULT_TILE_SIZE and vertex_chunk_size = 0 uses 
+// SR_DEFAULT_CHUNK_SIZE. tile_size is rounded up to a multiple of 
+// SR_DEPTH_BLOCK_SIZE. the shaders may be invoked from any of the
+// workers so they must not write to shared state
+typedef struct {
+    sr_u32 thread_count;
+    sr_u32 tile_size;
+    sr_u32 vertex_chunk_size;
+
+} SrThreadingInfo;
+
+
+
+// timings of a single worker during the last sr_draw call
+typedef struct {
+    sr_f64 vertex_ms;
+    sr_u32 vertices_count;
+    sr_f64 raster_ms;
+    sr_u32 tiles_count;
+    sr_u32 pixels_count;
+    sr_u64 coverage_tests;
+    sr_u64 coverage_tests_skipped;
+    sr_u32 hiz_blocks_rejected;
+
+} SrWorkerStats;
+
+
+
+typedef struct {
+    sr_u32        worker_count;
+    SrWorkerStats workers[SR_MAX_WORKERS];
+    sr_u32        triangles_rejected;
+    sr_u32        triangles_clipped;
+
+} SrPipelineStats;
+
+
+
+// FORWARD runs the pixel shader for every fragment that passes the depth
+// test. VISIBILITY first rasterizes the whole draw into a per tile buffer of
+// triangle ids (and the depth buffer), then shades each visible pixel once.
+// blending needs every fragment so pipelines with blending stay FORWARD
+typedef enum {
+    SR_SHADING_MODE_FORWARD    = 0,
+    SR_SHADING_MODE_VISIBILITY = 1,
+
+} SrShadingMode;
+
+
+
+// the pixels are shaded one row of a SR_DEPTH_BLOCK_SIZE block at a time,
+// pixel i of the batch is (x + i, y) and it's covered if bit i of mask is
+// set. the variants are stored as structure of arrays, the lanes of every
+// float of the variant are contiguous (see sr_batch_variant) and so are the
+// quad derivatives in ddx and ddy (NULL without variants_info.derivatives). 
+// the shader writes the colors of the covered pixels to r, g, b and a
+#define SR_PIXEL_BATCH_SIZE SR_DEPTH_BLOCK_SIZE
+
+typedef struct {
+    sr_f32* variants;
+    sr_f32* ddx;
+    sr_f32* ddy;
+    sr_u32  mask;
+    sr_u32  x;
+    sr_u32  y;
+    sr_f32  r[SR_PIXEL_BATCH_SIZE];
+    sr_f32  g[SR_PIXEL_BATCH_SIZE];
+    sr_f32  b[SR_PIXEL_BATCH_SIZE];
+    sr_f32  a[SR_PIXEL_BATCH_SIZE];
+
+} SrPixelBatch;
+
+
+
+// a contiguous range of the vertices of a draw, vertex i of the batch is 
+// read from vertices + i * vertex_stride and its variant is written to 
+// variants + i * variants_stride, both straight into the draw's buffers. 
+// first is the index of the first vertex of the batch in the vertex buffer,
+// a batch never spans more than one instance
+typedef struct {
+    sr_u8*   vertices;
+    sr_u8*   variants;
+    sr_vec4* positions;
+    sr_u32   vertex_stride;
+    sr_u32   variants_stride;
+    sr_u32   first;
+    sr_u32   count;
+
+} SrVertexBatch;
+
+
+
+typedef struct SrJobSystem SrJobSystem;
+typedef struct SrPipeline SrPipeline;
+typedef struct SrTriangle SrTriangle;
+typedef struct SrVisibilityTile SrVisibilityTile;
+
+
+
+// depth test, shading and blending of the covered pixels of a batch, e holds
+// the edge functions of the pixels (e[edge * SR_PIXEL_BATCH_SIZE + i]) and 
+// the number of shaded pixels is returned. sr_create_pipeline picks a 
+// version of it compiled for the depth and blend state of the pipeline
+typedef sr_u32 (*SrFragmentFunction)(SrPipeline* pipeline, SrTriangle* tri, SrPixelBatch* batch, 
+                                     SrVariant current_variant, SrVisibilityTile* vis, 
+                                     sr_u32 x, sr_u32 y, sr_u32 mask, sr_f32* e);
+
+
+
+#define PrologueFunctionPtr    void (*prologue)(void*, SrGlobalRegistry*)
+#define VertexFunctionPtr      sr_vec4 (*vertex_shader)(SrVertex, SrVariant, SrGlobalRegistry*)
+#define PixelFunctionPtr       sr_vec4 (*pixel_shader)(SrVariant, SrGlobalRegistry*)
+#define BatchVertexFunctionPtr void (*batch_vertex_shader)(SrVertexBatch*, SrGlobalRegistry*)
+#define BatchPixelFunctionPtr  void (*batch_pixel_shader)(SrPixelBatch*, SrGlobalRegistry*)
 
 
 
@@ -370,18 +751,41 @@ typedef struct {
     SrVariantsInfo    variants_info;
     SrVertexInputInfo vertex_input_info;
     SrColorBlendInfo  color_blend_info;
+    SrThreadingInfo   threading_info;
+    SrShadingMode     shading_mode;
+    SrConstantsInfo   constants_info;
+
+    // runs once at the start of every draw, it gets the constants block
+    // to fill with whatever the shaders would otherwise recompute for
+    // every vertex or pixel (combined matrices and such)
+    PrologueFunctionPtr;
+
     VertexFunctionPtr; 
     PixelFunctionPtr;
 
+    // shades a whole SrVertexBatch per call, it's used instead of 
+    // vertex_shader when it's set
+    BatchVertexFunctionPtr;
+
+    // shades a whole SrPixelBatch per call, it's used instead of 
+    // pixel_shader when it's set
+    BatchPixelFunctionPtr;
+
 } SrPipelineSpec;
 
 
 
-typedef struct {
+// frame_arena holds everything a draw needs while it runs and it gets 
+// reset at the end of every sr_draw call
+struct SrPipeline {
     SrPipelineSpec     spec;
     SrGlobalRegistry   registry;
+    SrJobSystem*       job_system;
+    SrPipelineStats    stats;
+    SrArena            frame_arena;
+    SrFragmentFunction fragment_function;
 
-} SrPipeline;
+};
 
 
 
@@ -390,6 +794,9 @@ typedef struct {
 SrPipeline sr_create_pipeline(SrPipelineSpec specs);
 
 
+void sr_destroy_pipeline(SrPipeline* pipeline);
+
+
 void sr_pipeline_upload_texture(SrPipeline* pipeline, SrTexture* texture, sr_usize texture_slot);
 
 
@@ -401,15 +808,160 @@ void sr_pipeline_upload_uniform_buffer(SrPipeline* pipeline, void* data, sr_u32
                                                 (type*)reg->uniforms[slot].data )
 
 
+#define sr_get_constants(type, reg) ( assert((reg)->constants), (type*)(reg)->constants )
+
+
+#define sr_get_instance(type, reg) ( assert((reg)->instance_data), (type*)(reg)->instance_data )
+
+
 #define sr_upload_variant(out, variant) (memcpy(out, &variant, sizeof(variant)))
 
 
 #define sr_texel(reg, idx, u, v) (sr_texture_sample((reg)->textures[idx], u, v))
+#define sr_texel_batch(reg, idx, u, v, count, out) (sr_texture_sample_batch((reg)->textures[idx], u, v, count, out))
+
+
+#define sr_texel_grad(reg, idx, u, v, ddx, ddy) (sr_texture_sample_grad((reg)->textures[idx], u, v, \
+                                                 (ddx).x, (ddx).y, (ddy).x, (ddy).y))
+
+
+// differences of a variant member across the 2x2 quad of the pixel, 
+// needs variants_info.derivatives
+#define sr_ddx(type, variants, member) (((type*)(variants))[1].member)
+#define sr_ddy(type, variants, member) (((type*)(variants))[2].member)
+
+
+// the SR_PIXEL_BATCH_SIZE lanes of a float member of the variant in a batch
+#define sr_batch_lanes(type, values, member) (&(values)[offsetof(type, member) / sizeof(sr_f32) * SR_PIXEL_BATCH_SIZE])
+
+#define sr_batch_variant(type, batch, member) sr_batch_lanes(type, (batch)->variants, member)
+#define sr_batch_ddx(type, batch, member)     sr_batch_lanes(type, (batch)->ddx, member)
+#define sr_batch_ddy(type, batch, member)     sr_batch_lanes(type, (batch)->ddy, member)
+
+#define sr_batch_vertex(type, batch, i) ((type*)&(batch)->vertices[(i) * (batch)->vertex_stride])
+#define sr_batch_output(type, batch, i) ((type*)&(batch)->variants[(i) * (batch)->variants_stride])
 
 
 void sr_draw(SrPipeline* pipeline, sr_usize vertices_count, void* buff);
 
 
+// the indices are read as vertex_input_info.index_type, every unique vertex
+// referenced by the index buffer is shaded only once per draw
+void sr_draw_indexed(SrPipeline* pipeline, void* index_buffer, sr_usize index_count, 
+                     void* vertex_buffer, sr_usize vertices_count);
+
+
+// draws instances_count copies of the vertices in a single pass, instance n
+// reads element n of instance_buffer (vertex_input_info.instance_byte_count
+// bytes each) through sr_get_instance in the vertex shader. the instances 
+// are drawn in order, like separate draws would be
+void sr_draw_instanced(SrPipeline* pipeline, sr_usize vertices_count, void* vertex_buffer, 
+                       sr_usize instances_count, void* instance_buffer);
+
+
+void sr_draw_indexed_instanced(SrPipeline* pipeline, void* index_buffer, sr_usize index_count, 
+                               void* vertex_buffer, sr_usize vertices_count, 
+                               sr_usize instances_count, void* instance_buffer);
+
+
+
+
+
+
+// ==================================================================
+// ======================== COMMAND BUFFERS =========================
+// ==================================================================
+
+
+
+typedef struct SrCommand SrCommand;
+typedef struct SrFence SrFence;
+
+
+
+// a list of recorded commands, nothing runs until the command buffer is 
+// submitted. a command buffer must only be recorded by one thread at a 
+// time, but every thread can record its own command buffer in parallel
+typedef struct {
+    SrArena     arena;
+    SrCommand*  commands;
+    sr_u32      commands_count;
+    sr_u32      commands_capacity;
+    SrPipeline* pipeline;
+
+} SrCommandBuffer;
+
+
+
+SrCommandBuffer sr_command_buffer_create();
+
+
+void sr_command_buffer_reset(SrCommandBuffer* cmd);
+
+
+void sr_command_buffer_free(SrCommandBuffer* cmd);
+
+
+// the draws use the last pipeline bound in the command buffer, with the 
+// textures and uniform buffers uploaded to it when the command buffer is 
+// submitted. the bind commands replace a slot for the draws that follow
+// them in the same command buffer, until the next sr_cmd_bind_pipeline
+// which starts again from the bindings of the pipeline
+void sr_cmd_bind_pipeline(SrCommandBuffer* cmd, SrPipeline* pipeline);
+
+
+void sr_cmd_bind_texture(SrCommandBuffer* cmd, SrTexture* texture, sr_usize texture_slot);
+
+
+void sr_cmd_bind_uniform_buffer(SrCommandBuffer* cmd, void* data, sr_u32 slot);
+
+
+void sr_cmd_clear_color(SrCommandBuffer* cmd, SrFramebuffer* fb, sr_vec4 color);
+
+
+void sr_cmd_clear_depth(SrCommandBuffer* cmd, SrFramebuffer* fb, sr_f32 value);
+
+
+void sr_cmd_draw(SrCommandBuffer* cmd, sr_usize vertices_count, void* buff);
+
+
+void sr_cmd_draw_indexed(SrCommandBuffer* cmd, void* index_buffer, sr_usize index_count, 
+                         void* vertex_buffer, sr_usize vertices_count);
+
+
+void sr_cmd_draw_instanced(SrCommandBuffer* cmd, sr_usize vertices_count, void* vertex_buffer, 
+                           sr_usize instances_count, void* instance_buffer);
+
+
+void sr_cmd_draw_indexed_instanced(SrCommandBuffer* cmd, void* index_buffer, sr_usize index_count, 
+                                   void* vertex_buffer, sr_usize vertices_count, 
+                                   sr_usize instances_count, void* instance_buffer);
+
+
+// runs the commands of the command buffers in order. the consecutive clears
+// are merged, and each run of adjacent draws to the same framebuffer with
+// the same shading mode goes through a single binning and raster pass,
+// whatever their pipelines, with the same image as separate draws. the
+// commands are copied so the command buffers can be reset right away.
+// without a fence the submit blocks, with one it returns right away and
+// the commands run on their own thread, the pipelines and everything the
+// commands point to must stay untouched until sr_fence_wait
+void sr_submit(SrCommandBuffer* cmds, sr_u32 count, SrFence* fence);
+
+
+SrFence* sr_fence_create();
+
+
+bool sr_fence_is_signaled(SrFence* fence);
+
+
+// blocks until the submission of the fence is done
+void sr_fence_wait(SrFence* fence);
+
+
+void sr_fence_destroy(SrFence* fence);
+
+
 
 
 
@@ -428,6 +980,83 @@ void sr_draw(SrPipeline* pipeline, sr_usize vertices_count, void* buff);
 // #define __SOFTWARE_RENDERER_IMPLEMENTATION
 #ifdef __SOFTWARE_RENDERER_IMPLEMENTATION
 
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SR_FORCE_INLINE __forceinline
+#else
+#define SR_FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SR_ARCH_X86
+#include <immintrin.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define SR_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define SR_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#endif
+
+
+static SrSimdLevel sr_get_supported_simd_level() {
+#ifdef SR_ARCH_X86
+    sr_u32 eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuidex(info, 1, 0);
+    ecx = info[2];
+#else
+    __cpuid_count(1, 0, eax, ebx, ecx, edx);
+#endif
+
+    // avx needs the os to save the ymm registers (osxsave + xcr0 bits 1 and 2)
+    bool os_avx = false;
+    if (ecx & (1 << 27)) {
+#if defined(_MSC_VER) && !defined(__clang__)
+        os_avx = (_xgetbv(0) & 6) == 6;
+#else
+        __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        os_avx = (eax & 6) == 6;
+#endif
+    }
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    __cpuidex(info, 7, 0);
+    ebx = info[1];
+#else
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+#endif
+
+    if (os_avx && (ebx & (1 << 5)))
+        return SR_SIMD_LEVEL_AVX2;
+
+    return SR_SIMD_LEVEL_SSE2;
+#else
+    return SR_SIMD_LEVEL_SCALAR;
+#endif
+}
+
+
+
+// level of the batched texture sampling. it's resolved on the calling
+// thread when a texture or a pipeline is created, the workers only read it
+static SrSimdLevel sr_sampling_simd_level = SR_SIMD_LEVEL_AUTO;
+
+
+
+static void sr_resolve_sampling_simd_level() {
+    if (sr_sampling_simd_level == SR_SIMD_LEVEL_AUTO)
+        sr_sampling_simd_level = sr_get_supported_simd_level();
+}
+
+
+
 static sr_vec2 sr_vec2_sub(sr_vec2 lhs, sr_vec2 rhs) {
     return sr_vec2 {
         .x = lhs.x - rhs.x, 
@@ -475,547 +1104,4988 @@ static sr_vec4 sr_clamp01_vec4(sr_vec4 v) {
 }
 
 
-static sr_vec4 sr_bilinear(sr_f32 tx, sr_f32 ty, sr_vec4 c1, sr_vec4 c2, sr_vec4 c3, sr_vec4 c4) {
+static sr_f32 sr_edge_function(sr_vec4 p1, sr_vec4 p2, sr_vec4 p) {
+    return (p1.y - p2.y) * p.x + (p2.x - p1.x) * p.y + (p1.x * p2.y - p1.y * p2.x);
+}
+
 
-    // a = c1 * (1 - tx) + c2 * tx
-    // b = c3 * (1 - tx) + c4 * tx
-    // return a * (1 - ty) + b * ty
-    sr_vec4 a = sr_vec4_add(sr_vec4_mul_s(c1, 1 - tx), sr_vec4_mul_s(c2, tx));
-    sr_vec4 b = sr_vec4_add(sr_vec4_mul_s(c3, 1 - tx), sr_vec4_mul_s(c4, tx));
-    return sr_vec4_add(sr_vec4_mul_s(a, 1 - ty), sr_vec4_mul_s(b, ty));
 
+static sr_vec4 sr_unpack_rgba8(sr_u32 texel) {
+    return sr_vec4 {
+        .x = ((texel >>  0) & 0xff) / 255.0f,
+        .y = ((texel >>  8) & 0xff) / 255.0f,
+        .z = ((texel >> 16) & 0xff) / 255.0f,
+        .w = ((texel >> 24) & 0xff) / 255.0f,
+    };
 }
 
 
 
-static sr_f32 sr_edge_function(sr_vec4 p1, sr_vec4 p2, sr_vec4 p) {
-    return (p1.y - p2.y) * p.x + (p2.x - p1.x) * p.y + (p1.x * p2.y - p1.y * p2.x);
+// spreads the lower 16 bits of value to the even bits
+static sr_u32 sr_part_1_by_1(sr_u32 value) {
+    value &= 0x0000ffff;
+    value = (value | (value << 8)) & 0x00ff00ff;
+    value = (value | (value << 4)) & 0x0f0f0f0f;
+    value = (value | (value << 2)) & 0x33333333;
+    value = (value | (value << 1)) & 0x55555555;
+    return value;
 }
 
 
 
-SrTexture sr_texture_create(SrTextureSpec specs, sr_u8* buffer) {
-    SrTexture texture;
-    texture.spec = specs;
+static inline sr_u32 sr_texture_texel_index(SrTexture* texture, sr_u32 level, sr_u32 x, sr_u32 y) {
+    SrMipLevel* mip = &texture->levels[level];
 
-    texture.buffer = (sr_vec4*)malloc(specs.width * specs.height * sizeof(sr_vec4));
-    sr_u32 channels = texture.spec.format;
+    sr_u32 shift = mip->block_shift;
+    sr_u32 mask  = (1u << shift) - 1;
+    sr_u32 block = ((y >> shift) * mip->blocks_x + (x >> shift)) << (shift * 2);
 
-    for (sr_u32 i = 0; i < specs.width * specs.height; i += 1) {
-        sr_u32 idx = i * channels;
+    switch (texture->spec.layout) {
+        case SR_TEXTURE_LAYOUT_MORTON: return mip->offset + block + (sr_part_1_by_1(x & mask) | (sr_part_1_by_1(y & mask) << 1));
+        default:                       return mip->offset + block + (((y & mask) << shift) | (x & mask));
+    }
+}
 
 
-        switch (specs.format) {
-            case SR_FORMAT_R:
-            {
-                texture.buffer[i].x = buffer[idx+0] / 255.0f;
-                texture.buffer[i].y = 0.0f;
-                texture.buffer[i].z = 0.0f;
-                texture.buffer[i].w = 1.0f;
-            }
-            break;
-            case SR_FORMAT_RG:
-            {
-                texture.buffer[i].x = buffer[idx+0] / 255.0f;
-                texture.buffer[i].y = buffer[idx+1] / 255.0f;
-                texture.buffer[i].z = 0.0f;
-                texture.buffer[i].w = 1.0f;
-            }
-            break;
-            case SR_FORMAT_RGB:
-            {
-                texture.buffer[i].x = buffer[idx+0] / 255.0f;
-                texture.buffer[i].y = buffer[idx+1] / 255.0f;
-                texture.buffer[i].z = buffer[idx+2] / 255.0f;
-                texture.buffer[i].w = 1.0f;
-            }
+
+// the morton blocks are the largest power of two square that fits in 
+// the padded level, a 2048x1024 level is two 1024x1024 z-order blocks
+static sr_u32 sr_texture_block_shift(SrTextureLayout layout, sr_u32 width, sr_u32 height) {
+    switch (layout) {
+        case SR_TEXTURE_LAYOUT_LINEAR:    return 0;
+        case SR_TEXTURE_LAYOUT_TILED_4X4: return 2;
+        case SR_TEXTURE_LAYOUT_MORTON: {
+            sr_u32 shift = 0;
+            while ((1u << shift) < width && (1u << shift) < height)
+                shift++;
+
+            return shift;
+        }
+    }
+
+    return 0;
+}
+
+
+
+// ==================================================================
+// ======================= BLOCK COMPRESSION ========================
+// ==================================================================
+
+
+
+static sr_u32 sr_bc_block_size(SrFormat format) {
+    switch (format) {
+        case SR_FORMAT_BC1:
+        case SR_FORMAT_BC4: return 8;
+        case SR_FORMAT_BC5:
+        case SR_FORMAT_BC7: return 16;
+        default:            return 0;
+    }
+}
+
+
+
+static sr_u32 sr_pack_rgba8(sr_u32 r, sr_u32 g, sr_u32 b, sr_u32 a) {
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+
+
+// palette of a BC1 block from its two RGB565 endpoints, c0 > c1 selects the 
+// four colors mode and otherwise the third color is the midpoint and the 
+// fourth is transparent black
+static void sr_bc1_palette(sr_u32 c0, sr_u32 c1, sr_u32* palette) {
+    sr_u32 e[2][3];
+    for (sr_u32 i = 0; i < 2; i++) {
+        sr_u32 c = i == 0 ? c0 : c1;
+        sr_u32 r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+
+        e[i][0] = (r << 3) | (r >> 2);
+        e[i][1] = (g << 2) | (g >> 4);
+        e[i][2] = (b << 3) | (b >> 2);
+    }
+
+    palette[0] = sr_pack_rgba8(e[0][0], e[0][1], e[0][2], 255);
+    palette[1] = sr_pack_rgba8(e[1][0], e[1][1], e[1][2], 255);
+
+    if (c0 > c1) {
+        palette[2] = sr_pack_rgba8((2 * e[0][0] + e[1][0]) / 3, (2 * e[0][1] + e[1][1]) / 3, (2 * e[0][2] + e[1][2]) / 3, 255);
+        palette[3] = sr_pack_rgba8((e[0][0] + 2 * e[1][0]) / 3, (e[0][1] + 2 * e[1][1]) / 3, (e[0][2] + 2 * e[1][2]) / 3, 255);
+    }
+    else {
+        palette[2] = sr_pack_rgba8((e[0][0] + e[1][0]) / 2, (e[0][1] + e[1][1]) / 2, (e[0][2] + e[1][2]) / 2, 255);
+        palette[3] = 0;
+    }
+}
+
+
+
+// palette of a BC4 block, r0 > r1 selects eight interpolated values and 
+// otherwise six plus 0 and 255
+static void sr_bc4_palette(sr_u32 r0, sr_u32 r1, sr_u32* palette) {
+    palette[0] = r0;
+    palette[1] = r1;
+
+    if (r0 > r1) {
+        for (sr_u32 i = 2; i < 8; i++)
+            palette[i] = ((8 - i) * r0 + (i - 1) * r1) / 7;
+    }
+    else {
+        for (sr_u32 i = 2; i < 6; i++)
+            palette[i] = ((6 - i) * r0 + (i - 1) * r1) / 5;
+
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+
+
+static void sr_bc1_decode(const sr_u8* block, sr_u32* texels) {
+    sr_u32 palette[4];
+    sr_bc1_palette(block[0] | (block[1] << 8), block[2] | (block[3] << 8), palette);
+
+    sr_u32 indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((sr_u32)block[7] << 24);
+    for (sr_u32 i = 0; i < 16; i++)
+        texels[i] = palette[(indices >> (i * 2)) & 3];
+}
+
+
+
+// decodes a BC4 block into the byte at shift of every texel
+static void sr_bc4_decode(const sr_u8* block, sr_u32* texels, sr_u32 shift) {
+    sr_u32 palette[8];
+    sr_bc4_palette(block[0], block[1], palette);
+
+    sr_u64 indices = 0;
+    for (sr_u32 i = 0; i < 6; i++)
+        indices |= (sr_u64)block[2 + i] << (i * 8);
+
+    for (sr_u32 i = 0; i < 16; i++)
+        texels[i] |= palette[(indices >> (i * 3)) & 7] << shift;
+}
+
+
+
+typedef struct {
+    sr_u8 subsets;
+    sr_u8 partition_bits;
+    sr_u8 rotation_bits;
+    sr_u8 index_selection_bits;
+    sr_u8 color_bits;
+    sr_u8 alpha_bits;
+    sr_u8 endpoint_pbits;
+    sr_u8 shared_pbits;
+    sr_u8 index_bits;
+    sr_u8 index_bits2;
+
+} SrBc7Mode;
+
+
+
+static SrBc7Mode sr_bc7_modes[8] = {
+    { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+    { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+    { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+    { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+    { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+    { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+    { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+    { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+};
+
+
+
+static sr_u8 sr_bc7_weights2[4]  = { 0, 21, 43, 64 };
+static sr_u8 sr_bc7_weights3[8]  = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static sr_u8 sr_bc7_weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+
+
+// bit i is set when texel i belongs to the second subset
+static sr_u16 sr_bc7_partitions2[64] = {
+    0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+    0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+    0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+    0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+    0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+    0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+    0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+    0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22,
+};
+
+
+
+static sr_u8 sr_bc7_partitions3[64][16] = {
+    { 0,0,1,1, 0,0,1,1, 0,2,2,1, 2,2,2,2 }, { 0,0,0,1, 0,0,1,1, 2,2,1,1, 2,2,2,1 },
+    { 0,0,0,0, 2,0,0,1, 2,2,1,1, 2,2,1,1 }, { 0,2,2,2, 0,0,2,2, 0,0,1,1, 0,1,1,1 },
+    { 0,0,0,0, 0,0,0,0, 1,1,2,2, 1,1,2,2 }, { 0,0,1,1, 0,0,1,1, 0,0,2,2, 0,0,2,2 },
+    { 0,0,2,2, 0,0,2,2, 1,1,1,1, 1,1,1,1 }, { 0,0,1,1, 0,0,1,1, 2,2,1,1, 2,2,1,1 },
+    { 0,0,0,0, 0,0,0,0, 1,1,1,1, 2,2,2,2 }, { 0,0,0,0, 1,1,1,1, 1,1,1,1, 2,2,2,2 },
+    { 0,0,0,0, 1,1,1,1, 2,2,2,2, 2,2,2,2 }, { 0,0,1,2, 0,0,1,2, 0,0,1,2, 0,0,1,2 },
+    { 0,1,1,2, 0,1,1,2, 0,1,1,2, 0,1,1,2 }, { 0,1,2,2, 0,1,2,2, 0,1,2,2, 0,1,2,2 },
+    { 0,0,1,1, 0,1,1,2, 1,1,2,2, 1,2,2,2 }, { 0,0,1,1, 2,0,0,1, 2,2,0,0, 2,2,2,0 },
+    { 0,0,0,1, 0,0,1,1, 0,1,1,2, 1,1,2,2 }, { 0,1,1,1, 0,0,1,1, 2,0,0,1, 2,2,0,0 },
+    { 0,0,0,0, 1,1,2,2, 1,1,2,2, 1,1,2,2 }, { 0,0,2,2, 0,0,2,2, 0,0,2,2, 1,1,1,1 },
+    { 0,1,1,1, 0,1,1,1, 0,2,2,2, 0,2,2,2 }, { 0,0,0,1, 0,0,0,1, 2,2,2,1, 2,2,2,1 },
+    { 0,0,0,0, 0,0,1,1, 0,1,2,2, 0,1,2,2 }, { 0,0,0,0, 1,1,0,0, 2,2,1,0, 2,2,1,0 },
+    { 0,1,2,2, 0,1,2,2, 0,0,1,1, 0,0,0,0 }, { 0,0,1,2, 0,0,1,2, 1,1,2,2, 2,2,2,2 },
+    { 0,1,1,0, 1,2,2,1, 1,2,2,1, 0,1,1,0 }, { 0,0,0,0, 0,1,1,0, 1,2,2,1, 1,2,2,1 },
+    { 0,0,2,2, 1,1,0,2, 1,1,0,2, 0,0,2,2 }, { 0,1,1,0, 0,1,1,0, 2,0,0,2, 2,2,2,2 },
+    { 0,0,1,1, 0,1,2,2, 0,1,2,2, 0,0,1,1 }, { 0,0,0,0, 2,0,0,0, 2,2,1,1, 2,2,2,1 },
+    { 0,0,0,0, 0,0,0,2, 1,1,2,2, 1,2,2,2 }, { 0,2,2,2, 0,0,2,2, 0,0,1,2, 0,0,1,1 },
+    { 0,0,1,1, 0,0,1,2, 0,0,2,2, 0,2,2,2 }, { 0,1,2,0, 0,1,2,0, 0,1,2,0, 0,1,2,0 },
+    { 0,0,0,0, 1,1,1,1, 2,2,2,2, 0,0,0,0 }, { 0,1,2,0, 1,2,0,1, 2,0,1,2, 0,1,2,0 },
+    { 0,1,2,0, 2,0,1,2, 1,2,0,1, 0,1,2,0 }, { 0,0,1,1, 2,2,0,0, 1,1,2,2, 0,0,1,1 },
+    { 0,0,1,1, 1,1,2,2, 2,2,0,0, 0,0,1,1 }, { 0,1,0,1, 0,1,0,1, 2,2,2,2, 2,2,2,2 },
+    { 0,0,0,0, 0,0,0,0, 2,1,2,1, 2,1,2,1 }, { 0,0,2,2, 1,1,2,2, 0,0,2,2, 1,1,2,2 },
+    { 0,0,2,2, 0,0,1,1, 0,0,2,2, 0,0,1,1 }, { 0,2,2,0, 1,2,2,1, 0,2,2,0, 1,2,2,1 },
+    { 0,1,0,1, 2,2,2,2, 2,2,2,2, 0,1,0,1 }, { 0,0,0,0, 2,1,2,1, 2,1,2,1, 2,1,2,1 },
+    { 0,1,0,1, 0,1,0,1, 0,1,0,1, 2,2,2,2 }, { 0,2,2,2, 0,1,1,1, 0,2,2,2, 0,1,1,1 },
+    { 0,0,0,2, 1,1,1,2, 0,0,0,2, 1,1,1,2 }, { 0,0,0,0, 2,1,1,2, 2,1,1,2, 2,1,1,2 },
+    { 0,2,2,2, 0,1,1,1, 0,1,1,1, 0,2,2,2 }, { 0,0,0,2, 1,1,1,2, 1,1,1,2, 0,0,0,2 },
+    { 0,1,1,0, 0,1,1,0, 0,1,1,0, 2,2,2,2 }, { 0,0,0,0, 0,0,0,0, 2,1,1,2, 2,1,1,2 },
+    { 0,1,1,0, 0,1,1,0, 2,2,2,2, 2,2,2,2 }, { 0,0,2,2, 0,0,1,1, 0,0,1,1, 0,0,2,2 },
+    { 0,0,2,2, 1,1,2,2, 1,1,2,2, 0,0,2,2 }, { 0,0,0,0, 0,0,0,0, 0,0,0,0, 2,1,1,2 },
+    { 0,0,0,2, 0,0,0,1, 0,0,0,2, 0,0,0,1 }, { 0,2,2,2, 1,2,2,2, 0,2,2,2, 1,2,2,2 },
+    { 0,1,0,1, 2,2,2,2, 2,2,2,2, 2,2,2,2 }, { 0,1,1,1, 2,0,1,1, 2,2,0,1, 2,2,2,0 },
+};
+
+
+
+// texels whose index is stored with one bit less, the first texel of every 
+// subset other than the first
+static sr_u8 sr_bc7_anchors2[64] = {
+    15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15,
+    15, 2, 8, 2, 2, 8, 8,15,  2, 8, 2, 2, 8, 8, 2, 2,
+    15,15, 6, 8, 2, 8,15,15,  2, 8, 2, 2, 2,15,15, 6,
+     6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15,
+};
+
+static sr_u8 sr_bc7_anchors3a[64] = {
+     3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,
+     3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+     8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,
+     3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3,
+};
+
+static sr_u8 sr_bc7_anchors3b[64] = {
+    15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8,
+    15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+    15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8,
+    15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8,
+};
+
+
+
+static sr_u32 sr_bc7_read(sr_u64* bits, sr_u32* position, sr_u32 count) {
+    sr_u32 p = *position;
+    *position += count;
+
+    sr_u64 value;
+    if (p >= 64)               value = bits[1] >> (p - 64);
+    else if (p + count <= 64)  value = bits[0] >> p;
+    else                       value = (bits[0] >> p) | (bits[1] << (64 - p));
+
+    return (sr_u32)(value & ((1ull << count) - 1));
+}
+
+
+
+static sr_u32 sr_bc7_interpolate(sr_u32 e0, sr_u32 e1, sr_u32 index, sr_u32 index_bits) {
+    sr_u32 w = index_bits == 2 ? sr_bc7_weights2[index] : 
+               index_bits == 3 ? sr_bc7_weights3[index] : sr_bc7_weights4[index];
+
+    return ((64 - w) * e0 + w * e1 + 32) >> 6;
+}
+
+
+
+static void sr_bc7_decode(const sr_u8* block, sr_u32* texels) {
+    // the mode is the number of zeros before the first set bit, a block 
+    // without any is reserved and decodes to transparent black
+    if (block[0] == 0) {
+        memset(texels, 0, 16 * sizeof(sr_u32));
+        return;
+    }
+
+    sr_u32 mode = 0;
+    while (!(block[0] & (1u << mode)))
+        mode++;
+
+    SrBc7Mode* m = &sr_bc7_modes[mode];
+
+    sr_u64 bits[2];
+    memcpy(bits, block, sizeof(bits));
+    sr_u32 position = mode + 1;
+
+    sr_u32 partition = sr_bc7_read(bits, &position, m->partition_bits);
+    sr_u32 rotation  = sr_bc7_read(bits, &position, m->rotation_bits);
+    sr_u32 selection = sr_bc7_read(bits, &position, m->index_selection_bits);
+
+    // the endpoints are stored channel after channel, then the p-bits
+    sr_u32 endpoints[3][2][4];
+    for (sr_u32 c = 0; c < 3; c++)
+        for (sr_u32 s = 0; s < m->subsets; s++)
+            for (sr_u32 e = 0; e < 2; e++)
+                endpoints[s][e][c] = sr_bc7_read(bits, &position, m->color_bits);
+
+    for (sr_u32 s = 0; s < m->subsets; s++)
+        for (sr_u32 e = 0; e < 2; e++)
+            endpoints[s][e][3] = m->alpha_bits ? sr_bc7_read(bits, &position, m->alpha_bits) : 255;
+
+    sr_u32 color_bits = m->color_bits;
+    sr_u32 alpha_bits = m->alpha_bits;
+    sr_u32 channels   = m->alpha_bits ? 4 : 3;
+
+    if (m->endpoint_pbits || m->shared_pbits) {
+        for (sr_u32 s = 0; s < m->subsets; s++) {
+            sr_u32 shared = m->shared_pbits ? sr_bc7_read(bits, &position, 1) : 0;
+
+            for (sr_u32 e = 0; e < 2; e++) {
+                sr_u32 p = m->endpoint_pbits ? sr_bc7_read(bits, &position, 1) : shared;
+
+                for (sr_u32 c = 0; c < channels; c++)
+                    endpoints[s][e][c] = (endpoints[s][e][c] << 1) | p;
+            }
+        }
+
+        color_bits += 1;
+        alpha_bits += m->alpha_bits ? 1 : 0;
+    }
+
+    // replicate the high bits to fill the byte
+    for (sr_u32 s = 0; s < m->subsets; s++) {
+        for (sr_u32 e = 0; e < 2; e++) {
+            for (sr_u32 c = 0; c < channels; c++) {
+                sr_u32 count = c < 3 ? color_bits : alpha_bits;
+                sr_u32 value = endpoints[s][e][c] << (8 - count);
+                endpoints[s][e][c] = value | (value >> count);
+            }
+        }
+    }
+
+    sr_u32 subsets[16];
+    for (sr_u32 i = 0; i < 16; i++) {
+        switch (m->subsets) {
+            case 1:  subsets[i] = 0; break;
+            case 2:  subsets[i] = (sr_bc7_partitions2[partition] >> i) & 1; break;
+            default: subsets[i] = sr_bc7_partitions3[partition][i]; break;
+        }
+    }
+
+    sr_u32 indices[16];
+    for (sr_u32 i = 0; i < 16; i++) {
+        bool anchor = i == 0 || 
+                      (m->subsets == 2 && i == sr_bc7_anchors2[partition]) ||
+                      (m->subsets == 3 && (i == sr_bc7_anchors3a[partition] || i == sr_bc7_anchors3b[partition]));
+
+        indices[i] = sr_bc7_read(bits, &position, m->index_bits - (anchor ? 1 : 0));
+    }
+
+    sr_u32 indices2[16];
+    if (m->index_bits2) {
+        for (sr_u32 i = 0; i < 16; i++)
+            indices2[i] = sr_bc7_read(bits, &position, m->index_bits2 - (i == 0 ? 1 : 0));
+    }
+
+    for (sr_u32 i = 0; i < 16; i++) {
+        sr_u32 (*e)[4] = endpoints[subsets[i]];
+
+        // modes 4 and 5 have separate color and alpha indices, the 
+        // selection bit swaps which one uses the larger set
+        sr_u32 color_index = indices[i], color_index_bits = m->index_bits;
+        sr_u32 alpha_index = indices[i], alpha_index_bits = m->index_bits;
+        if (m->index_bits2) {
+            alpha_index = indices2[i];
+            alpha_index_bits = m->index_bits2;
+
+            if (selection) {
+                sr_u32 t = color_index; color_index = alpha_index; alpha_index = t;
+                t = color_index_bits; color_index_bits = alpha_index_bits; alpha_index_bits = t;
+            }
+        }
+
+        sr_u32 rgba[4];
+        for (sr_u32 c = 0; c < 3; c++)
+            rgba[c] = sr_bc7_interpolate(e[0][c], e[1][c], color_index, color_index_bits);
+        rgba[3] = sr_bc7_interpolate(e[0][3], e[1][3], alpha_index, alpha_index_bits);
+
+        if (rotation) {
+            sr_u32 t = rgba[3]; rgba[3] = rgba[rotation - 1]; rgba[rotation - 1] = t;
+        }
+
+        texels[i] = sr_pack_rgba8(rgba[0], rgba[1], rgba[2], rgba[3]);
+    }
+}
+
+
+
+static void sr_texture_decode_block(SrTexture* texture, const sr_u8* block, sr_u32* texels) {
+    switch (texture->spec.format) {
+        case SR_FORMAT_BC1: 
+            sr_bc1_decode(block, texels);
+            break;
+
+        case SR_FORMAT_BC4:
+            for (sr_u32 i = 0; i < 16; i++)
+                texels[i] = 0xff000000;
+            sr_bc4_decode(block, texels, 0);
+            break;
+
+        case SR_FORMAT_BC5:
+            for (sr_u32 i = 0; i < 16; i++)
+                texels[i] = 0xff000000;
+            sr_bc4_decode(block + 0, texels, 0);
+            sr_bc4_decode(block + 8, texels, 8);
+            break;
+
+        default:
+            sr_bc7_decode(block, texels);
             break;
-            case SR_FORMAT_RGBA:
-            {
-                texture.buffer[i].x = buffer[idx+0] / 255.0f;
-                texture.buffer[i].y = buffer[idx+1] / 255.0f;
-                texture.buffer[i].z = buffer[idx+2] / 255.0f;
-                texture.buffer[i].w = buffer[idx+3] / 255.0f;
+    }
+}
+
+
+
+#define SR_DECODED_BLOCKS_CACHE_SIZE 256  // 18 KB per thread
+
+
+
+typedef struct {
+    sr_u32 texture_id;
+    sr_u32 block;
+    sr_u32 texels[16];
+
+} SrDecodedBlock;
+
+
+
+// every worker thread decodes into its own direct mapped cache, so the four
+// texels of a bilinear footprint and the neighbouring pixels of the quad 
+// decode their block once instead of once per fetch
+static thread_local SrDecodedBlock sr_decoded_blocks[SR_DECODED_BLOCKS_CACHE_SIZE];
+
+
+
+static sr_u32 sr_texture_fetch_compressed(SrTexture* texture, sr_u32 index) {
+    sr_u32 block = index >> 4;
+
+    // fibonacci hash, the top 8 bits pick one of the 256 slots so the 
+    // blocks of neighbouring rows don't all land on the same one
+    sr_u32 slot  = ((block ^ (texture->id << 24)) * 2654435761u) >> 24;
+
+    SrDecodedBlock* entry = &sr_decoded_blocks[slot];
+    if (entry->block != block || entry->texture_id != texture->id) {
+        sr_texture_decode_block(texture, &texture->buffer[block * texture->block_size], entry->texels);
+        entry->block      = block;
+        entry->texture_id = texture->id;
+    }
+
+    return entry->texels[index & 15];
+}
+
+
+
+// reads a texel as RGBA8 (red in the lowest byte), the channels a texture 
+// doesn't store are 0 for green and blue and 1 for alpha
+static SR_FORCE_INLINE sr_u32 sr_texture_fetch(SrTexture* texture, sr_u32 index) {
+    if (texture->block_size)
+        return sr_texture_fetch_compressed(texture, index);
+
+    sr_u8* texel = &texture->buffer[index * texture->texel_size];
+
+    switch (texture->texel_size) {
+        case 1: return texel[0] | 0xff000000;
+        case 2: return texel[0] | (texel[1] << 8) | 0xff000000;
+        default: {
+            sr_u32 value;
+            memcpy(&value, texel, sizeof(value));
+            return value;
+        }
+    }
+}
+
+
+
+static void sr_texture_store(SrTexture* texture, sr_u32 index, sr_u32 value) {
+    memcpy(&texture->buffer[index * texture->texel_size], &value, texture->texel_size);
+}
+
+
+
+// every level is the 2x2 box filtered previous one, the odd rows and 
+// columns are clamped to the edge
+static void sr_texture_generate_mips(SrTexture* texture) {
+    for (sr_u32 l = 1; l < texture->levels_count; l++) {
+        SrMipLevel* src_level = &texture->levels[l - 1];
+        SrMipLevel* dst_level = &texture->levels[l];
+
+        for (sr_u32 y = 0; y < dst_level->height; y++) {
+            sr_u32 y0 = sr_min(y * 2 + 0, src_level->height - 1);
+            sr_u32 y1 = sr_min(y * 2 + 1, src_level->height - 1);
+
+            for (sr_u32 x = 0; x < dst_level->width; x++) {
+                sr_u32 x0 = sr_min(x * 2 + 0, src_level->width - 1);
+                sr_u32 x1 = sr_min(x * 2 + 1, src_level->width - 1);
+
+                sr_u32 c1 = sr_texture_fetch(texture, sr_texture_texel_index(texture, l - 1, x0, y0));
+                sr_u32 c2 = sr_texture_fetch(texture, sr_texture_texel_index(texture, l - 1, x1, y0));
+                sr_u32 c3 = sr_texture_fetch(texture, sr_texture_texel_index(texture, l - 1, x0, y1));
+                sr_u32 c4 = sr_texture_fetch(texture, sr_texture_texel_index(texture, l - 1, x1, y1));
+
+                // rounded average of every channel
+                sr_u32 result = 0;
+                for (sr_u32 shift = 0; shift < 32; shift += 8) {
+                    sr_u32 sum = ((c1 >> shift) & 0xff) + ((c2 >> shift) & 0xff) + 
+                                 ((c3 >> shift) & 0xff) + ((c4 >> shift) & 0xff);
+                    result |= ((sum + 2) >> 2) << shift;
+                }
+
+                sr_texture_store(texture, sr_texture_texel_index(texture, l, x, y), result);
             }
+        }
+    }
+}
+
+
+
+// defined with the jobs, textures can be created from any thread and the
+// decoded blocks cache tells them apart by id
+static sr_u32 sr_atomic_fetch_add(volatile sr_u32* target, sr_u32 value);
+
+static volatile sr_u32 sr_texture_next_id = 1;
+
+
+
+SrTexture sr_texture_create(SrTextureSpec specs, sr_u8* buffer) {
+    sr_resolve_sampling_simd_level();
+
+    sr_u32 block_size = sr_bc_block_size(specs.format);
+    if (block_size)
+        specs.layout = SR_TEXTURE_LAYOUT_TILED_4X4;
+
+    SrTexture texture;
+    texture.spec       = specs;
+    texture.block_size = block_size;
+    texture.id         = sr_atomic_fetch_add(&sr_texture_next_id, 1);
+
+    // the chain goes down to a 1x1 level
+    sr_u32 texels_count = 0;
+    texture.levels_count = 0;
+
+    for (sr_u32 w = specs.width, h = specs.height; texture.levels_count < SR_MAX_MIP_LEVELS; ) {
+        sr_u32 shift    = sr_texture_block_shift(specs.layout, w, h);
+        sr_u32 blocks_x = (w + (1u << shift) - 1) >> shift;
+        sr_u32 blocks_y = (h + (1u << shift) - 1) >> shift;
+
+        texture.levels[texture.levels_count++] = SrMipLevel {
+            .width = w, .height = h, .offset = texels_count, .block_shift = shift, .blocks_x = blocks_x,
+        };
+        texels_count += (blocks_x * blocks_y) << (shift * 2);
+
+        if (w == 1 && h == 1)
             break;
+
+        w = sr_max(w / 2, 1u);
+        h = sr_max(h / 2, 1u);
+    }
+
+    // the compressed chain is already in the block order of the layout
+    if (block_size) {
+        sr_usize size = (sr_usize)(texels_count / 16) * block_size;
+
+        texture.texel_size = 0;
+        texture.buffer     = (sr_u8*)malloc(size);
+        memcpy(texture.buffer, buffer, size);
+
+        return texture;
+    }
+
+    sr_u32 channels    = texture.spec.format;
+    texture.texel_size = channels == SR_FORMAT_RGB ? 4 : channels;
+
+    // one more word so the 4 byte gathers of the last R or RG texel stay 
+    // inside the buffer
+    texture.buffer     = (sr_u8*)malloc(texels_count * texture.texel_size + sizeof(sr_u32));
+
+    for (sr_u32 j = 0; j < specs.width * specs.height; j += 1) {
+        sr_u8* src = &buffer[j * channels];
+
+        sr_u32 r = src[0];
+        sr_u32 g = channels > 1 ? src[1] : 0;
+        sr_u32 b = channels > 2 ? src[2] : 0;
+        sr_u32 a = channels > 3 ? src[3] : 255;
+
+        sr_texture_store(&texture, sr_texture_texel_index(&texture, 0, j % specs.width, j / specs.width), 
+                         r | (g << 8) | (b << 16) | (a << 24));
+    }
+
+    sr_texture_generate_mips(&texture);
+
+    return texture;
+}
+
+
+
+SrTexture sr_texture_create_packed(SrTextureSpec specs, sr_u8** sources, sr_u32* sources_channels) {
+    sr_u32 channels = specs.format;
+    sr_u32 count    = specs.width * specs.height;
+
+    sr_u8* packed = (sr_u8*)malloc(count * channels);
+
+    for (sr_u32 i = 0; i < count; i++)
+        for (sr_u32 c = 0; c < channels; c++)
+            packed[i * channels + c] = sources[c][i * sources_channels[c]];
+
+    SrTexture texture = sr_texture_create(specs, packed);
+    free(packed);
+
+    return texture;
+}
+
+
+static sr_u32 sr_rgba8_distance(sr_u32 a, sr_u32 b, sr_u32 channels) {
+    sr_u32 distance = 0;
+    for (sr_u32 c = 0; c < channels; c++) {
+        sr_i32 d = (sr_i32)((a >> (c * 8)) & 0xff) - (sr_i32)((b >> (c * 8)) & 0xff);
+        distance += d * d;
+    }
+
+    return distance;
+}
+
+
+
+static sr_u32 sr_rgb565(sr_u32* rgb) {
+    return (((rgb[0] * 31 + 127) / 255) << 11) | (((rgb[1] * 63 + 127) / 255) << 5) | ((rgb[2] * 31 + 127) / 255);
+}
+
+
+
+// the encoders fit the endpoints to the bounding box of the block and pick 
+// the closest palette entry for every texel, fast and good enough for 
+// albedo and masks but far from what an offline optimizer reaches
+static void sr_bc1_encode(sr_u32* texels, sr_u8* block) {
+    sr_u32 lo[3] = { 255, 255, 255 };
+    sr_u32 hi[3] = { 0, 0, 0 };
+    bool transparent = false;
+
+    for (sr_u32 i = 0; i < 16; i++) {
+        if ((texels[i] >> 24) < 128) {
+            transparent = true;
+            continue;
+        }
+
+        for (sr_u32 c = 0; c < 3; c++) {
+            sr_u32 value = (texels[i] >> (c * 8)) & 0xff;
+            lo[c] = sr_min(lo[c], value);
+            hi[c] = sr_max(hi[c], value);
+        }
+    }
+
+    // inset the box a bit, the extremes are rarely worth a whole endpoint
+    for (sr_u32 c = 0; c < 3; c++) {
+        if (lo[c] > hi[c]) {
+            lo[c] = hi[c] = 0;
+            continue;
+        }
+
+        sr_u32 inset = (hi[c] - lo[c]) >> 4;
+        lo[c] += inset;
+        hi[c] -= inset;
+    }
+
+    // the four colors mode needs c0 > c1 and the transparent one c0 <= c1
+    sr_u32 c0 = sr_rgb565(hi);
+    sr_u32 c1 = sr_rgb565(lo);
+    if (transparent ? c0 > c1 : c0 < c1) {
+        sr_u32 t = c0; c0 = c1; c1 = t;
+    }
+
+    sr_u32 palette[4];
+    sr_bc1_palette(c0, c1, palette);
+    sr_u32 colors = c0 > c1 ? 4 : 3;
+
+    sr_u32 indices = 0;
+    for (sr_u32 i = 0; i < 16; i++) {
+        sr_u32 best = 3;
+
+        if (!transparent || (texels[i] >> 24) >= 128) {
+            sr_u32 best_distance = ~0u;
+            for (sr_u32 j = 0; j < colors; j++) {
+                sr_u32 distance = sr_rgba8_distance(texels[i], palette[j], 3);
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best = j;
+                }
+            }
+        }
+
+        indices |= best << (i * 2);
+    }
+
+    block[0] = c0 & 0xff; block[1] = c0 >> 8;
+    block[2] = c1 & 0xff; block[3] = c1 >> 8;
+    memcpy(&block[4], &indices, sizeof(indices));
+}
+
+
+
+// encodes the byte at shift of every texel
+static void sr_bc4_encode(sr_u32* texels, sr_u32 shift, sr_u8* block) {
+    sr_u32 lo = 255, hi = 0;
+    for (sr_u32 i = 0; i < 16; i++) {
+        sr_u32 value = (texels[i] >> shift) & 0xff;
+        lo = sr_min(lo, value);
+        hi = sr_max(hi, value);
+    }
+
+    sr_u32 palette[8];
+    sr_bc4_palette(hi, lo, palette);
+
+    sr_u64 indices = 0;
+    for (sr_u32 i = 0; i < 16; i++) {
+        sr_i32 value = (texels[i] >> shift) & 0xff;
+        sr_u32 best  = 0;
+
+        for (sr_u32 j = 1; j < 8; j++)
+            if (abs(value - (sr_i32)palette[j]) < abs(value - (sr_i32)palette[best]))
+                best = j;
+
+        indices |= (sr_u64)best << (i * 3);
+    }
+
+    block[0] = hi;
+    block[1] = lo;
+    for (sr_u32 i = 0; i < 6; i++)
+        block[2 + i] = (indices >> (i * 8)) & 0xff;
+}
+
+
+
+static void sr_bc7_write(sr_u64* bits, sr_u32* position, sr_u32 value, sr_u32 count) {
+    sr_u32 p = *position;
+    *position += count;
+
+    if (p >= 64) {
+        bits[1] |= (sr_u64)value << (p - 64);
+        return;
+    }
+
+    bits[0] |= (sr_u64)value << p;
+    if (p + count > 64)
+        bits[1] |= (sr_u64)value >> (64 - p);
+}
+
+
+
+// only mode 6, a single subset of 7 bit RGBA endpoints with a p-bit each 
+// and 4 bit indices. the other modes mostly pay off on blocks with several
+// distinct colors, which needs a partition search this encoder doesn't do
+static void sr_bc7_encode(sr_u32* texels, sr_u8* block) {
+    sr_u32 lo[4] = { 255, 255, 255, 255 };
+    sr_u32 hi[4] = { 0, 0, 0, 0 };
+
+    for (sr_u32 i = 0; i < 16; i++) {
+        for (sr_u32 c = 0; c < 4; c++) {
+            sr_u32 value = (texels[i] >> (c * 8)) & 0xff;
+            lo[c] = sr_min(lo[c], value);
+            hi[c] = sr_max(hi[c], value);
         }
+    }
+
+    // quantize both endpoints to 7 bits with the p-bit that fits them best
+    sr_u32 quantized[2][4];
+    sr_u32 pbits[2];
+    sr_u32 endpoints[2][4];
+
+    for (sr_u32 e = 0; e < 2; e++) {
+        sr_u32* source = e == 0 ? lo : hi;
+        sr_u32  best_error = ~0u;
+
+        for (sr_u32 p = 0; p < 2; p++) {
+            sr_u32 q[4];
+            sr_u32 error = 0;
+
+            for (sr_u32 c = 0; c < 4; c++) {
+                q[c] = sr_min((sr_max(source[c], p) - p + 1) >> 1, 127u);
+
+                sr_i32 d = (sr_i32)((q[c] << 1) | p) - (sr_i32)source[c];
+                error += d * d;
+            }
+
+            if (error < best_error) {
+                best_error = error;
+                pbits[e]   = p;
+                memcpy(quantized[e], q, sizeof(q));
+            }
+        }
+
+        for (sr_u32 c = 0; c < 4; c++)
+            endpoints[e][c] = (quantized[e][c] << 1) | pbits[e];
+    }
+
+    sr_u32 palette[16];
+    for (sr_u32 j = 0; j < 16; j++)
+        palette[j] = sr_pack_rgba8(sr_bc7_interpolate(endpoints[0][0], endpoints[1][0], j, 4),
+                                   sr_bc7_interpolate(endpoints[0][1], endpoints[1][1], j, 4),
+                                   sr_bc7_interpolate(endpoints[0][2], endpoints[1][2], j, 4),
+                                   sr_bc7_interpolate(endpoints[0][3], endpoints[1][3], j, 4));
+
+    sr_u32 indices[16];
+    for (sr_u32 i = 0; i < 16; i++) {
+        sr_u32 best_distance = ~0u;
+        for (sr_u32 j = 0; j < 16; j++) {
+            sr_u32 distance = sr_rgba8_distance(texels[i], palette[j], 4);
+            if (distance < best_distance) {
+                best_distance = distance;
+                indices[i]    = j;
+            }
+        }
+    }
+
+    // the index of the first texel has an implicit zero high bit
+    if (indices[0] & 8) {
+        for (sr_u32 c = 0; c < 4; c++) {
+            sr_u32 t = quantized[0][c]; quantized[0][c] = quantized[1][c]; quantized[1][c] = t;
+        }
+
+        sr_u32 t = pbits[0]; pbits[0] = pbits[1]; pbits[1] = t;
+
+        for (sr_u32 i = 0; i < 16; i++)
+            indices[i] = 15 - indices[i];
+    }
+
+    sr_u64 bits[2] = { 0, 0 };
+    sr_u32 position = 0;
+
+    sr_bc7_write(bits, &position, 1u << 6, 7);
+
+    for (sr_u32 c = 0; c < 4; c++)
+        for (sr_u32 e = 0; e < 2; e++)
+            sr_bc7_write(bits, &position, quantized[e][c], 7);
+
+    sr_bc7_write(bits, &position, pbits[0], 1);
+    sr_bc7_write(bits, &position, pbits[1], 1);
+
+    for (sr_u32 i = 0; i < 16; i++)
+        sr_bc7_write(bits, &position, indices[i], i == 0 ? 3 : 4);
+
+    memcpy(block, bits, sizeof(bits));
+}
+
+
+
+sr_u8* sr_texture_compress(SrTexture* texture, SrFormat format, sr_usize* size) {
+    assert(texture->block_size == 0 && sr_bc_block_size(format));
+
+    sr_u32   block_size = sr_bc_block_size(format);
+    sr_usize blocks     = 0;
+
+    for (sr_u32 l = 0; l < texture->levels_count; l++)
+        blocks += ((texture->levels[l].width + 3) / 4) * ((texture->levels[l].height + 3) / 4);
+
+    sr_u8* result = (sr_u8*)malloc(blocks * block_size);
+    sr_u8* block  = result;
+
+    // level after level of row major blocks, the tiled 4x4 order 
+    // sr_texture_create expects. the padding repeats the edge texels
+    for (sr_u32 l = 0; l < texture->levels_count; l++) {
+        SrMipLevel* level = &texture->levels[l];
+
+        for (sr_u32 by = 0; by < level->height; by += 4) {
+            for (sr_u32 bx = 0; bx < level->width; bx += 4) {
+                sr_u32 texels[16];
+
+                for (sr_u32 i = 0; i < 16; i++) {
+                    sr_u32 x = sr_min(bx + (i & 3), level->width  - 1);
+                    sr_u32 y = sr_min(by + (i >> 2), level->height - 1);
+                    texels[i] = sr_texture_fetch(texture, sr_texture_texel_index(texture, l, x, y));
+                }
+
+                switch (format) {
+                    case SR_FORMAT_BC1: sr_bc1_encode(texels, block); break;
+                    case SR_FORMAT_BC4: sr_bc4_encode(texels, 0, block); break;
+                    case SR_FORMAT_BC5: sr_bc4_encode(texels, 0, block); sr_bc4_encode(texels, 8, block + 8); break;
+                    default:            sr_bc7_encode(texels, block); break;
+                }
+
+                block += block_size;
+            }
+        }
+    }
+
+    *size = blocks * block_size;
+    return result;
+}
+
+
+
+void sr_texture_set_sampling_mode(SrTexture* texture, SrSamplingMode sampling_mode) {
+    assert(texture);
+
+    texture->spec.sampling_mode = sampling_mode;
+}
+
+
+void sr_texture_set_filter_mode(SrTexture* texture, SrFilter filter) {
+    assert(texture);
+
+    texture->spec.filter = filter;
+}
+
+
+
+sr_vec4 sr_texture_get_pixel(SrTexture* texture, sr_u32 x, sr_u32 y) {
+    assert((x < texture->spec.width) && (y < texture->spec.height));
+    
+    return sr_unpack_rgba8(sr_texture_fetch(texture, sr_texture_texel_index(texture, 0, x, y)));
+}
+
+
+
+void sr_texture_free(SrTexture* texture) {
+    free(texture->buffer);
+}
+
+
+
+// bilinear filtering of four RGBA8 texels in fixed point, wx and wy are the 
+// weights of c2 / c4 and c3 / c4 in 1/256 steps. the horizontal lerps fit 
+// in 16 bits and are halved so the vertical one can use signed 16 bit 
+// multiplies, which gives 15 fractional bits for every channel
+static sr_vec4 sr_bilinear_rgba8(sr_u32 c1, sr_u32 c2, sr_u32 c3, sr_u32 c4, sr_u32 wx, sr_u32 wy) {
+    const sr_f32 scale = 1.0f / (255.0f * 128.0f * 256.0f);
+
+#ifdef SR_ARCH_X86
+    __m128i zero  = _mm_setzero_si128();
+    __m128i quad  = _mm_setr_epi32(c1, c2, c3, c4);
+    __m128i wxs   = _mm_setr_epi16(256 - wx, 256 - wx, 256 - wx, 256 - wx, wx, wx, wx, wx);
+
+    __m128i top    = _mm_mullo_epi16(_mm_unpacklo_epi8(quad, zero), wxs);
+    __m128i bottom = _mm_mullo_epi16(_mm_unpackhi_epi8(quad, zero), wxs);
+
+    top    = _mm_srli_epi16(_mm_add_epi16(top,    _mm_srli_si128(top,    8)), 1);
+    bottom = _mm_srli_epi16(_mm_add_epi16(bottom, _mm_srli_si128(bottom, 8)), 1);
+
+    __m128i sum = _mm_madd_epi16(_mm_unpacklo_epi16(top, bottom), _mm_set1_epi32((wy << 16) | (256 - wy)));
+
+    sr_vec4 result;
+    _mm_storeu_ps(&result.x, _mm_mul_ps(_mm_cvtepi32_ps(sum), _mm_set1_ps(scale)));
+    return result;
+#else
+    sr_f32 result[4];
+
+    for (sr_u32 i = 0; i < 4; i++) {
+        sr_u32 shift = i * 8;
+        sr_u32 top    = (((c1 >> shift) & 0xff) * (256 - wx) + ((c2 >> shift) & 0xff) * wx) >> 1;
+        sr_u32 bottom = (((c3 >> shift) & 0xff) * (256 - wx) + ((c4 >> shift) & 0xff) * wx) >> 1;
+
+        result[i] = (sr_f32)(top * (256 - wy) + bottom * wy) * scale;
+    }
+
+    return sr_vec4 {.x = result[0], .y = result[1], .z = result[2], .w = result[3]};
+#endif
+}
+
+
+
+static sr_u32 sr_texture_wrap(SrSamplingMode sampling_mode, sr_i32 coord, sr_u32 size) {
+    switch (sampling_mode) {
+        case SR_SAMPLING_MODE_CLAMP_TO_EDGE: return (sr_u32)sr_max(0, sr_min(coord, (sr_i32)size - 1));
+        case SR_SAMPLING_MODE_REPEAT: {
+            // most textures are power of two, which avoids the divisions
+            if ((size & (size - 1)) == 0)
+                return (sr_u32)coord & (size - 1);
+
+            return (sr_u32)(((coord % (sr_i32)size) + (sr_i32)size) % (sr_i32)size);
+        }
+    }
+
+    return 0;
+}
+
+
+
+// bilinear sample of a single mip level, the texel centers are at 
+// (i + 0.5) / size so the levels line up with each other
+static sr_vec4 sr_texture_sample_level(SrTexture* texture, sr_u32 level, sr_f32 u, sr_f32 v) {
+    SrMipLevel* mip = &texture->levels[level];
+
+    sr_f32 x = u * mip->width  - 0.5f;
+    sr_f32 y = v * mip->height - 0.5f;
+
+    sr_f32 cell_x = floorf(x);
+    sr_f32 cell_y = floorf(y);
+
+    SrSamplingMode mode = texture->spec.sampling_mode;
+    sr_u32 x0 = sr_texture_wrap(mode, (sr_i32)cell_x + 0, mip->width);
+    sr_u32 x1 = sr_texture_wrap(mode, (sr_i32)cell_x + 1, mip->width);
+    sr_u32 y0 = sr_texture_wrap(mode, (sr_i32)cell_y + 0, mip->height);
+    sr_u32 y1 = sr_texture_wrap(mode, (sr_i32)cell_y + 1, mip->height);
+
+    sr_u32 c1 = sr_texture_fetch(texture, sr_texture_texel_index(texture, level, x0, y0));
+    sr_u32 c2 = sr_texture_fetch(texture, sr_texture_texel_index(texture, level, x1, y0));
+    sr_u32 c3 = sr_texture_fetch(texture, sr_texture_texel_index(texture, level, x0, y1));
+    sr_u32 c4 = sr_texture_fetch(texture, sr_texture_texel_index(texture, level, x1, y1));
+
+    sr_u32 wx = (sr_u32)((x - cell_x) * 256.0f + 0.5f);
+    sr_u32 wy = (sr_u32)((y - cell_y) * 256.0f + 0.5f);
+
+    return sr_bilinear_rgba8(c1, c2, c3, c4, wx, wy);
+}
+
+
+
+static sr_vec4 sr_texture_sample_nearest(SrTexture* texture, sr_f32 u, sr_f32 v) {
+    sr_u32 width = texture->spec.width - 1;
+    sr_u32 height = texture->spec.height - 1;
+
+    u = round(u * width);
+    v = round(v * height);
+
+    sr_u32 x = u;
+    sr_u32 y = v;
+
+    switch (texture->spec.sampling_mode) {
+        case SR_SAMPLING_MODE_CLAMP_TO_EDGE: {
+            x = x < 0 ? 0 : x > width ? width : x;
+            y = y < 0 ? 0 : y > height ? height : y;
+            break;
+        }
+        case SR_SAMPLING_MODE_REPEAT: {
+            x = x % width;
+            y = y % height;
+            break;
+        }
+    }
+
+    return sr_texture_get_pixel(texture, x, y);
+}
+
+
+
+static sr_vec4 sr_texture_sample_bilinear(SrTexture* texture, sr_f32 u, sr_f32 v) {
+    sr_u32 width = texture->spec.width - 1;
+    sr_u32 height = texture->spec.height - 1;
+
+    sr_vec2 curr   = sr_vec2 {.x = u * width, .y = v * height};
+
+    switch (texture->spec.sampling_mode) {
+        case SR_SAMPLING_MODE_CLAMP_TO_EDGE: {
+            curr.x = curr.x < 0.0f ? 0.0f : curr.x > width ? width : curr.x;
+            curr.y = curr.y < 0.0f ? 0.0f : curr.y > height ? height : curr.y;
+            break;
+        }
+        case SR_SAMPLING_MODE_REPEAT: {
+            // one texel wide textures have nothing to wrap around
+            curr.x = width  ? fmodf(curr.x, width)  : 0.0f;
+            curr.y = height ? fmodf(curr.y, height) : 0.0f;
+            break;
+        }
+    }
+
+    sr_vec2 cell   = sr_vec2{.x = floorf(curr.x), .y = floorf(curr.y)};
+    sr_vec2 offset = sr_vec2_sub(curr, cell);
+
+    // the second row and column fall off the edge at u or v = 1 and on
+    // the negative side of the repeat, they wrap like the other taps
+    SrSamplingMode mode = texture->spec.sampling_mode;
+    sr_u32 x0 = sr_texture_wrap(mode, (sr_i32)cell.x + 0, texture->spec.width);
+    sr_u32 x1 = sr_texture_wrap(mode, (sr_i32)cell.x + 1, texture->spec.width);
+    sr_u32 y0 = sr_texture_wrap(mode, (sr_i32)cell.y + 0, texture->spec.height);
+    sr_u32 y1 = sr_texture_wrap(mode, (sr_i32)cell.y + 1, texture->spec.height);
+
+    sr_u32 c1 = sr_texture_fetch(texture, sr_texture_texel_index(texture, 0, x0, y0));
+    sr_u32 c2 = sr_texture_fetch(texture, sr_texture_texel_index(texture, 0, x0, y1));
+    sr_u32 c3 = sr_texture_fetch(texture, sr_texture_texel_index(texture, 0, x1, y0));
+    sr_u32 c4 = sr_texture_fetch(texture, sr_texture_texel_index(texture, 0, x1, y1));
+
+    sr_u32 wx = (sr_u32)(offset.x * 256.0f + 0.5f);
+    sr_u32 wy = (sr_u32)(offset.y * 256.0f + 0.5f);
+
+    return sr_bilinear_rgba8(c1, c2, c3, c4, wx, wy);
+}
+
+
+
+sr_vec4 sr_texture_sample(SrTexture* texture, sr_f32 u, sr_f32 v) {
+    switch (texture->spec.filter) {
+        case SR_FILTER_NEAREST:   return sr_texture_sample_nearest(texture, u, v);
+        case SR_FILTER_BILINEAR:  return sr_texture_sample_bilinear(texture, u, v);
+        case SR_FILTER_TRILINEAR: return sr_texture_sample_level(texture, 0, u, v);
+    }
+
+    return sr_vec4 {};
+}
+
+
+
+sr_vec4 sr_texture_sample_grad(SrTexture* texture, sr_f32 u, sr_f32 v, 
+                               sr_f32 dudx, sr_f32 dvdx, sr_f32 dudy, sr_f32 dvdy) {
+
+    if (texture->spec.filter != SR_FILTER_TRILINEAR)
+        return sr_texture_sample(texture, u, v);
+
+
+    // the level is picked from the longest of the two texel space 
+    // derivatives, log2(sqrt(x)) = 0.5 * log2(x)
+    sr_f32 width  = (sr_f32)texture->spec.width;
+    sr_f32 height = (sr_f32)texture->spec.height;
+
+    sr_f32 dx = (dudx * width) * (dudx * width) + (dvdx * height) * (dvdx * height);
+    sr_f32 dy = (dudy * width) * (dudy * width) + (dvdy * height) * (dvdy * height);
+
+    sr_f32 lod = 0.5f * log2f(sr_max(sr_max(dx, dy), 1e-12f));
+    lod = sr_clamp(lod, 0.0f, (sr_f32)(texture->levels_count - 1));
+
+    sr_u32 level  = (sr_u32)lod;
+    sr_f32 weight = lod - (sr_f32)level;
+
+    sr_vec4 c1 = sr_texture_sample_level(texture, level, u, v);
+
+    if (weight == 0.0f)
+        return c1;
+
+    sr_vec4 c2 = sr_texture_sample_level(texture, level + 1, u, v);
+
+    return sr_vec4_add(sr_vec4_mul_s(c1, 1.0f - weight), sr_vec4_mul_s(c2, weight));
+}
+
+
+
+
+// ==================================================================
+// ======================= BATCHED SAMPLING =========================
+// ==================================================================
+
+
+
+static void sr_sample_batch_store(SrSampleBatch* out, sr_u32 lane, sr_vec4 color) {
+    out->r[lane] = color.x;
+    out->g[lane] = color.y;
+    out->b[lane] = color.z;
+    out->a[lane] = color.w;
+}
+
+
+
+#ifdef SR_ARCH_X86
+
+typedef __m128i (*SrFetch4Function)(SrTexture* texture, __m128i index);
+
+
+
+static __m128i sr_texture_fetch4_scalar(SrTexture* texture, __m128i index) {
+    sr_u32 lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, index);
+
+    return _mm_setr_epi32(sr_texture_fetch(texture, lanes[0]), sr_texture_fetch(texture, lanes[1]),
+                          sr_texture_fetch(texture, lanes[2]), sr_texture_fetch(texture, lanes[3]));
+}
+
+
+
+// the R and RG texels are gathered as whole words and masked, the buffer
+// has a padding word so the last ones don't read past it
+SR_TARGET_AVX2 static __m128i sr_texture_fetch4_avx2(SrTexture* texture, __m128i index) {
+    const int* base = (const int*)texture->buffer;
+
+    switch (texture->texel_size) {
+        case 1: {
+            __m128i texels = _mm_i32gather_epi32(base, index, 1);
+            return _mm_or_si128(_mm_and_si128(texels, _mm_set1_epi32(0xff)), _mm_set1_epi32((int)0xff000000));
+        }
+        case 2: {
+            __m128i texels = _mm_i32gather_epi32(base, index, 2);
+            return _mm_or_si128(_mm_and_si128(texels, _mm_set1_epi32(0xffff)), _mm_set1_epi32((int)0xff000000));
+        }
+        case 4: return _mm_i32gather_epi32(base, index, 4);
+        default: return sr_texture_fetch4_scalar(texture, index);
+    }
+}
+
+
+
+// sse2 has no 32 bit mullo, the even and odd lanes go through the 64 bit one
+static SR_FORCE_INLINE __m128i sr_mullo_epi32(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), 
+                              _mm_shuffle_epi32(odd,  _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+
+
+static SR_FORCE_INLINE __m128i sr_select_epi32(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+
+
+// floorf and round of every lane, valid while the values fit in an int
+static SR_FORCE_INLINE __m128i sr_floor4(__m128 x) {
+    __m128i t = _mm_cvttps_epi32(x);
+    return _mm_add_epi32(t, _mm_castps_si128(_mm_cmplt_ps(x, _mm_cvtepi32_ps(t))));
+}
+
+
+
+static SR_FORCE_INLINE __m128i sr_round4(__m128 x) {
+    __m128i t    = _mm_cvttps_epi32(x);
+    __m128  diff = _mm_sub_ps(x, _mm_cvtepi32_ps(t));
+
+    __m128i up   = _mm_castps_si128(_mm_cmpge_ps(diff, _mm_set1_ps(0.5f)));
+    __m128i down = _mm_castps_si128(_mm_cmple_ps(diff, _mm_set1_ps(-0.5f)));
+
+    return _mm_add_epi32(_mm_sub_epi32(t, up), down);
+}
+
+
+
+// floored modulo of lanes below 2^24 in magnitude. the float quotient is 
+// off by at most one, so a single correction in each direction is enough
+static SR_FORCE_INLINE __m128i sr_mod4(__m128i x, sr_u32 m) {
+    __m128i size = _mm_set1_epi32(m);
+    __m128i q    = sr_floor4(_mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f / m)));
+    __m128i r    = _mm_sub_epi32(x, sr_mullo_epi32(q, size));
+
+    r = _mm_add_epi32(r, _mm_and_si128(_mm_cmplt_epi32(r, _mm_setzero_si128()), size));
+    r = _mm_sub_epi32(r, _mm_andnot_si128(_mm_cmplt_epi32(r, size), size));
+    return r;
+}
+
+
+
+static SR_FORCE_INLINE __m128i sr_texture_wrap4(SrSamplingMode sampling_mode, __m128i coord, sr_u32 size) {
+    __m128i last = _mm_set1_epi32(size - 1);
+
+    if (sampling_mode == SR_SAMPLING_MODE_CLAMP_TO_EDGE) {
+        coord = sr_select_epi32(_mm_cmpgt_epi32(coord, last), last, coord);
+        return _mm_andnot_si128(_mm_cmplt_epi32(coord, _mm_setzero_si128()), coord);
+    }
+
+    if ((size & (size - 1)) == 0)
+        return _mm_and_si128(coord, last);
+
+    return sr_mod4(coord, size);
+}
+
+
+
+static SR_FORCE_INLINE __m128i sr_part_1_by_1_4(__m128i value) {
+    value = _mm_and_si128(_mm_or_si128(value, _mm_slli_epi32(value, 8)), _mm_set1_epi32(0x00ff00ff));
+    value = _mm_and_si128(_mm_or_si128(value, _mm_slli_epi32(value, 4)), _mm_set1_epi32(0x0f0f0f0f));
+    value = _mm_and_si128(_mm_or_si128(value, _mm_slli_epi32(value, 2)), _mm_set1_epi32(0x33333333));
+    value = _mm_and_si128(_mm_or_si128(value, _mm_slli_epi32(value, 1)), _mm_set1_epi32(0x55555555));
+    return value;
+}
+
+
+
+// sr_texture_texel_index of 4 lanes
+static SR_FORCE_INLINE __m128i sr_texture_texel_index4(SrTexture* texture, sr_u32 level, __m128i x, __m128i y) {
+    SrMipLevel* mip = &texture->levels[level];
+
+    __m128i shift = _mm_cvtsi32_si128(mip->block_shift);
+    __m128i mask  = _mm_set1_epi32((1 << mip->block_shift) - 1);
+
+    __m128i block = _mm_add_epi32(sr_mullo_epi32(_mm_srl_epi32(y, shift), _mm_set1_epi32(mip->blocks_x)), 
+                                  _mm_srl_epi32(x, shift));
+    block = _mm_sll_epi32(block, _mm_cvtsi32_si128(mip->block_shift * 2));
+
+    __m128i inner;
+    if (texture->spec.layout == SR_TEXTURE_LAYOUT_MORTON)
+        inner = _mm_or_si128(sr_part_1_by_1_4(_mm_and_si128(x, mask)), _mm_slli_epi32(sr_part_1_by_1_4(_mm_and_si128(y, mask)), 1));
+    else 
+        inner = _mm_or_si128(_mm_sll_epi32(_mm_and_si128(y, mask), shift), _mm_and_si128(x, mask));
+
+    return _mm_add_epi32(_mm_add_epi32(_mm_set1_epi32(mip->offset), block), inner);
+}
+
+
+
+// lanes whose coordinates are outside of the range the simd helpers 
+// handle exactly take the scalar path
+static SR_FORCE_INLINE bool sr_in_range4(__m128 x, __m128 y, sr_f32 limit) {
+    __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 inside   = _mm_and_ps(_mm_cmplt_ps(_mm_and_ps(x, abs_mask), _mm_set1_ps(limit)), 
+                                 _mm_cmplt_ps(_mm_and_ps(y, abs_mask), _mm_set1_ps(limit)));
+    return _mm_movemask_ps(inside) == 0xf;
+}
+
+
+
+// sr_texture_sample_nearest of 4 lanes, false when they need the scalar path
+static SR_FORCE_INLINE bool sr_texture_sample4_nearest(SrTexture* texture, __m128 u, __m128 v, SrFetch4Function fetch, 
+                                                       SrSampleBatch* out, sr_u32 lane) {
+    sr_u32 width  = texture->spec.width - 1;
+    sr_u32 height = texture->spec.height - 1;
+
+    __m128 fx = _mm_mul_ps(u, _mm_set1_ps((sr_f32)width));
+    __m128 fy = _mm_mul_ps(v, _mm_set1_ps((sr_f32)height));
+
+    // the scalar path converts negative coordinates to unsigned, keep it
+    // for them and for the modulo by zero of the one texel wide textures
+    __m128 negative = _mm_or_ps(_mm_cmple_ps(fx, _mm_set1_ps(-0.5f)), _mm_cmple_ps(fy, _mm_set1_ps(-0.5f)));
+    if (width == 0 || height == 0 || !sr_in_range4(fx, fy, 16777216.0f) || _mm_movemask_ps(negative))
+        return false;
+
+    __m128i x = sr_round4(fx);
+    __m128i y = sr_round4(fy);
+
+    if (texture->spec.sampling_mode == SR_SAMPLING_MODE_CLAMP_TO_EDGE) {
+        __m128i w = _mm_set1_epi32(width), h = _mm_set1_epi32(height);
+        x = sr_select_epi32(_mm_cmpgt_epi32(x, w), w, x);
+        y = sr_select_epi32(_mm_cmpgt_epi32(y, h), h, y);
+    }
+    else {
+        x = (width  & (width  - 1)) == 0 ? _mm_and_si128(x, _mm_set1_epi32(width  - 1)) : sr_mod4(x, width);
+        y = (height & (height - 1)) == 0 ? _mm_and_si128(y, _mm_set1_epi32(height - 1)) : sr_mod4(y, height);
+    }
+
+    __m128i texels = fetch(texture, sr_texture_texel_index4(texture, 0, x, y));
+
+    sr_f32* channels[4] = {out->r, out->g, out->b, out->a};
+    for (sr_u32 c = 0; c < 4; c++) {
+        __m128i value = _mm_and_si128(_mm_srli_epi32(texels, c * 8), _mm_set1_epi32(0xff));
+        _mm_storeu_ps(&channels[c][lane], _mm_div_ps(_mm_cvtepi32_ps(value), _mm_set1_ps(255.0f)));
+    }
+
+    return true;
+}
+
+
+
+// sr_texture_sample_level of 4 lanes with the same fixed point filter as 
+// sr_bilinear_rgba8, every channel of the 4 lanes in one register
+static SR_FORCE_INLINE bool sr_texture_sample4_level(SrTexture* texture, sr_u32 level, __m128 u, __m128 v, 
+                                                     SrFetch4Function fetch, SrSampleBatch* out, sr_u32 lane) {
+    SrMipLevel* mip = &texture->levels[level];
+
+    __m128 x = _mm_sub_ps(_mm_mul_ps(u, _mm_set1_ps((sr_f32)mip->width)),  _mm_set1_ps(0.5f));
+    __m128 y = _mm_sub_ps(_mm_mul_ps(v, _mm_set1_ps((sr_f32)mip->height)), _mm_set1_ps(0.5f));
+
+    if (!sr_in_range4(x, y, 8388608.0f))
+        return false;
+
+    __m128i cell_x = sr_floor4(x);
+    __m128i cell_y = sr_floor4(y);
+
+    __m128i one = _mm_set1_epi32(1);
+
+    SrSamplingMode mode = texture->spec.sampling_mode;
+    __m128i x0 = sr_texture_wrap4(mode, cell_x, mip->width);
+    __m128i x1 = sr_texture_wrap4(mode, _mm_add_epi32(cell_x, one), mip->width);
+    __m128i y0 = sr_texture_wrap4(mode, cell_y, mip->height);
+    __m128i y1 = sr_texture_wrap4(mode, _mm_add_epi32(cell_y, one), mip->height);
+
+    __m128i c1 = fetch(texture, sr_texture_texel_index4(texture, level, x0, y0));
+    __m128i c2 = fetch(texture, sr_texture_texel_index4(texture, level, x1, y0));
+    __m128i c3 = fetch(texture, sr_texture_texel_index4(texture, level, x0, y1));
+    __m128i c4 = fetch(texture, sr_texture_texel_index4(texture, level, x1, y1));
+
+    __m128 weight_scale = _mm_set1_ps(256.0f);
+    __m128 rounding     = _mm_set1_ps(0.5f);
+    __m128i wx = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(x, _mm_cvtepi32_ps(cell_x)), weight_scale), rounding));
+    __m128i wy = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(y, _mm_cvtepi32_ps(cell_y)), weight_scale), rounding));
+
+    __m128i full = _mm_set1_epi32(256);
+    __m128i iwx  = _mm_sub_epi32(full, wx);
+    __m128i wys  = _mm_or_si128(_mm_sub_epi32(full, wy), _mm_slli_epi32(wy, 16));
+
+    // the products fit in the low 16 bits of every lane, and the vertical 
+    // lerp takes top and bottom as the two halves of a lane
+    __m128i byte  = _mm_set1_epi32(0xff);
+    __m128  scale = _mm_set1_ps(1.0f / (255.0f * 128.0f * 256.0f));
+
+    sr_f32* channels[4] = {out->r, out->g, out->b, out->a};
+    for (sr_u32 c = 0; c < 4; c++) {
+        __m128i shift = _mm_cvtsi32_si128(c * 8);
+
+        __m128i t1 = _mm_and_si128(_mm_srl_epi32(c1, shift), byte);
+        __m128i t2 = _mm_and_si128(_mm_srl_epi32(c2, shift), byte);
+        __m128i t3 = _mm_and_si128(_mm_srl_epi32(c3, shift), byte);
+        __m128i t4 = _mm_and_si128(_mm_srl_epi32(c4, shift), byte);
+
+        __m128i top    = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi16(t1, iwx), _mm_mullo_epi16(t2, wx)), 1);
+        __m128i bottom = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi16(t3, iwx), _mm_mullo_epi16(t4, wx)), 1);
+
+        __m128i sum = _mm_madd_epi16(_mm_or_si128(top, _mm_slli_epi32(bottom, 16)), wys);
+        _mm_storeu_ps(&channels[c][lane], _mm_mul_ps(_mm_cvtepi32_ps(sum), scale));
+    }
+
+    return true;
+}
+
+
+
+static SR_FORCE_INLINE void sr_texture_sample_batch_lanes(SrTexture* texture, const sr_f32* u, const sr_f32* v, sr_u32 count, 
+                                                          SrSampleBatch* out, SrFetch4Function fetch) {
+    // whole groups of 4 lanes, the padding results land past count
+    sr_f32 us[SR_SAMPLE_BATCH_MAX] = {};
+    sr_f32 vs[SR_SAMPLE_BATCH_MAX] = {};
+    memcpy(us, u, count * sizeof(sr_f32));
+    memcpy(vs, v, count * sizeof(sr_f32));
+
+    for (sr_u32 lane = 0; lane < count; lane += 4) {
+        __m128 u4 = _mm_loadu_ps(&us[lane]);
+        __m128 v4 = _mm_loadu_ps(&vs[lane]);
+
+        bool done = false;
+        switch (texture->spec.filter) {
+            case SR_FILTER_NEAREST:   done = sr_texture_sample4_nearest(texture, u4, v4, fetch, out, lane); break;
+            case SR_FILTER_TRILINEAR: done = sr_texture_sample4_level(texture, 0, u4, v4, fetch, out, lane); break;
+            default: break;
+        }
+
+        if (done)
+            continue;
+
+        for (sr_u32 i = lane; i < lane + 4; i++) {
+            switch (texture->spec.filter) {
+                case SR_FILTER_NEAREST:   sr_sample_batch_store(out, i, sr_texture_sample_nearest(texture, us[i], vs[i])); break;
+                case SR_FILTER_BILINEAR:  sr_sample_batch_store(out, i, sr_texture_sample_bilinear(texture, us[i], vs[i])); break;
+                case SR_FILTER_TRILINEAR: sr_sample_batch_store(out, i, sr_texture_sample_level(texture, 0, us[i], vs[i])); break;
+            }
+        }
+    }
+}
+
+
+
+static void sr_texture_sample_batch_sse2(SrTexture* texture, const sr_f32* u, const sr_f32* v, sr_u32 count, SrSampleBatch* out) {
+    sr_texture_sample_batch_lanes(texture, u, v, count, out, sr_texture_fetch4_scalar);
+}
+
+
+
+SR_TARGET_AVX2 static void sr_texture_sample_batch_avx2(SrTexture* texture, const sr_f32* u, const sr_f32* v, sr_u32 count, SrSampleBatch* out) {
+    sr_texture_sample_batch_lanes(texture, u, v, count, out, sr_texture_fetch4_avx2);
+}
+
+#endif
+
+
+
+void sr_texture_sample_batch(SrTexture* texture, const sr_f32* u, const sr_f32* v, sr_u32 count, SrSampleBatch* out) {
+    assert(count <= SR_SAMPLE_BATCH_MAX);
+
+#ifdef SR_ARCH_X86
+    if (sr_sampling_simd_level == SR_SIMD_LEVEL_AVX2)
+        sr_texture_sample_batch_avx2(texture, u, v, count, out);
+    else
+        sr_texture_sample_batch_sse2(texture, u, v, count, out);
+#else
+    for (sr_u32 i = 0; i < count; i++) {
+        switch (texture->spec.filter) {
+            case SR_FILTER_NEAREST:   sr_sample_batch_store(out, i, sr_texture_sample_nearest(texture, u[i], v[i])); break;
+            case SR_FILTER_BILINEAR:  sr_sample_batch_store(out, i, sr_texture_sample_bilinear(texture, u[i], v[i])); break;
+            case SR_FILTER_TRILINEAR: sr_sample_batch_store(out, i, sr_texture_sample_level(texture, 0, u[i], v[i])); break;
+        }
+    }
+#endif
+}
+
+
+
+static sr_u16 sr_f32_to_f16(sr_f32 value) {
+    sr_u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    sr_u32 sign     = (bits >> 16) & 0x8000;
+    sr_i32 exponent = (sr_i32)((bits >> 23) & 0xff) - 127 + 15;
+    sr_u32 mantissa = bits & 0x7fffff;
+
+    // inf and nan
+    if (((bits >> 23) & 0xff) == 0xff)
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+
+    if (exponent >= 31)
+        return sign | 0x7c00;
+
+    // too small for a normal half, rounded to a subnormal
+    if (exponent <= 0) {
+        if (exponent < -10)
+            return sign;
+
+        mantissa |= 0x800000;
+
+        sr_u32 shift   = 14 - exponent;
+        sr_u32 half    = mantissa >> shift;
+        sr_u32 rest    = mantissa & ((1u << shift) - 1);
+        sr_u32 halfway = 1u << (shift - 1);
+
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half += 1;
+
+        return sign | half;
+    }
+
+    // round to nearest even, a carry out of the mantissa 
+    // correctly bumps the exponent
+    sr_u32 half = sign | (exponent << 10) | (mantissa >> 13);
+    sr_u32 rest = mantissa & 0x1fff;
+
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half += 1;
+
+    return half;
+}
+
+
+
+static sr_f32 sr_f16_to_f32(sr_u16 value) {
+    sr_u32 sign     = (sr_u32)(value & 0x8000) << 16;
+    sr_u32 exponent = (value >> 10) & 0x1f;
+    sr_u32 mantissa = value & 0x3ff;
+    sr_u32 bits;
+
+    if (exponent == 0) {
+        sr_f32 result = mantissa * (1.0f / 16777216.0f);
+        return sign ? -result : result;
+    }
+
+    if (exponent == 31)
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    else
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+    sr_f32 result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+
+
+static sr_u8 sr_f32_to_unorm8(sr_f32 value) {
+    return (sr_u8)(sr_clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+
+
+sr_u32 sr_color_format_get_size(SrColorFormat format) {
+    switch (format) {
+        case SR_COLOR_FORMAT_RGBA32F:     return 16;
+        case SR_COLOR_FORMAT_RGBA8_UNORM: return 4;
+        case SR_COLOR_FORMAT_RGBA16F:     return 8;
+        case SR_COLOR_FORMAT_R32F:        return 4;
+    }
+
+    return 16;
+}
+
+
+
+static void sr_pack_color(SrColorFormat format, sr_vec4 color, void* out) {
+    switch (format) {
+        case SR_COLOR_FORMAT_RGBA32F: {
+            *(sr_vec4*)out = color;
+            break;
+        }
+        case SR_COLOR_FORMAT_RGBA8_UNORM: {
+            sr_u8* texel = (sr_u8*)out;
+            texel[0] = sr_f32_to_unorm8(color.x);
+            texel[1] = sr_f32_to_unorm8(color.y);
+            texel[2] = sr_f32_to_unorm8(color.z);
+            texel[3] = sr_f32_to_unorm8(color.w);
+            break;
+        }
+        case SR_COLOR_FORMAT_RGBA16F: {
+            sr_u16* texel = (sr_u16*)out;
+            texel[0] = sr_f32_to_f16(color.x);
+            texel[1] = sr_f32_to_f16(color.y);
+            texel[2] = sr_f32_to_f16(color.z);
+            texel[3] = sr_f32_to_f16(color.w);
+            break;
+        }
+        case SR_COLOR_FORMAT_R32F: {
+            *(sr_f32*)out = color.x;
+            break;
+        }
+    }
+}
+
+
+
+static sr_vec4 sr_unpack_color(SrColorFormat format, const void* in) {
+    switch (format) {
+        case SR_COLOR_FORMAT_RGBA32F: {
+            return *(const sr_vec4*)in;
+        }
+        case SR_COLOR_FORMAT_RGBA8_UNORM: {
+            const sr_u8* texel = (const sr_u8*)in;
+            return sr_vec4 {
+                .x = texel[0] * (1.0f / 255.0f),
+                .y = texel[1] * (1.0f / 255.0f),
+                .z = texel[2] * (1.0f / 255.0f),
+                .w = texel[3] * (1.0f / 255.0f),
+            };
+        }
+        case SR_COLOR_FORMAT_RGBA16F: {
+            const sr_u16* texel = (const sr_u16*)in;
+            return sr_vec4 {
+                .x = sr_f16_to_f32(texel[0]),
+                .y = sr_f16_to_f32(texel[1]),
+                .z = sr_f16_to_f32(texel[2]),
+                .w = sr_f16_to_f32(texel[3]),
+            };
+        }
+        case SR_COLOR_FORMAT_R32F: {
+            return sr_vec4 {.x = *(const sr_f32*)in, .y = 0.0f, .z = 0.0f, .w = 1.0f};
+        }
+    }
+
+    return sr_vec4 {};
+}
+
+
+
+sr_u32 sr_depth_format_get_size(SrDepthFormat format) {
+    switch (format) {
+        case SR_DEPTH_FORMAT_D32F: return 4;
+        case SR_DEPTH_FORMAT_D24:  return 4;
+        case SR_DEPTH_FORMAT_D16:  return 2;
+    }
+
+    return 4;
+}
+
+
+
+// depth converted to the integer stored by the unorm formats
+static sr_u32 sr_depth_to_d24(sr_f32 depth) {
+    return (sr_u32)(sr_clamp(depth, 0.0f, 1.0f) * 16777215.0 + 0.5);
+}
+
+static sr_u32 sr_depth_to_d16(sr_f32 depth) {
+    return (sr_u32)(sr_clamp(depth, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+
+
+
+// the value the depth buffer ends up holding for depth, as a float that 
+// compares exactly like the stored values (24-bit integers fit in a f32)
+static sr_f32 sr_depth_to_stored(SrDepthFormat format, sr_f32 depth) {
+    switch (format) {
+        case SR_DEPTH_FORMAT_D32F: return depth;
+        case SR_DEPTH_FORMAT_D24:  return (sr_f32)sr_depth_to_d24(depth);
+        case SR_DEPTH_FORMAT_D16:  return (sr_f32)sr_depth_to_d16(depth);
+    }
+
+    return depth;
+}
+
+
+
+static void sr_framebuffer_alloc_buffers(SrFramebuffer* fb) {
+    sr_u32 size     = fb->spec.width * fb->spec.height;
+    sr_u32 blocks_x = (fb->spec.width  + SR_DEPTH_BLOCK_SIZE - 1) / SR_DEPTH_BLOCK_SIZE;
+    sr_u32 blocks_y = (fb->spec.height + SR_DEPTH_BLOCK_SIZE - 1) / SR_DEPTH_BLOCK_SIZE;
+
+    sr_u32 color_size = size * sr_color_format_get_size(fb->spec.color_format);
+    sr_u32 depth_size = size * sr_depth_format_get_size(fb->spec.depth_format);
+
+    fb->color_buffer        = malloc(color_size);
+    fb->depth_buffer        = malloc(depth_size);
+    fb->depth_clear_pending = (sr_u8*)malloc(blocks_x * blocks_y);
+    fb->depth_clear_value   = 0.0f;
+    fb->depth_blocks_x      = blocks_x;
+    fb->depth_block_min     = (sr_f32*)malloc(blocks_x * blocks_y * sizeof(sr_f32));
+    fb->depth_block_max     = (sr_f32*)malloc(blocks_x * blocks_y * sizeof(sr_f32));
+    fb->depth_block_stale   = (sr_u8*)malloc(blocks_x * blocks_y);
+
+    memset(fb->color_buffer, 0, color_size);
+    memset(fb->depth_buffer, 0, depth_size);
+    memset(fb->depth_clear_pending, 0, blocks_x * blocks_y);
+    memset(fb->depth_block_min, 0, blocks_x * blocks_y * sizeof(sr_f32));
+    memset(fb->depth_block_max, 0, blocks_x * blocks_y * sizeof(sr_f32));
+    memset(fb->depth_block_stale, 0, blocks_x * blocks_y);
+}
+
+
+
+SrFramebuffer sr_framebuffer_create(SrFramebufferSpec spec) {
+    SrFramebuffer framebuffer;
+    memset(&framebuffer, 0, sizeof(SrFramebuffer));
+    framebuffer.spec = spec;
+
+    sr_framebuffer_alloc_buffers(&framebuffer);
+
+    return framebuffer;
+}
+
+void sr_framebuffer_resize(SrFramebuffer* fb, sr_u32 width, sr_u32 height) {
+    free(fb->color_buffer);
+    free(fb->depth_buffer);
+    free(fb->depth_clear_pending);
+    free(fb->depth_block_min);
+    free(fb->depth_block_max);
+    free(fb->depth_block_stale);
+
+    fb->spec.width = width; 
+    fb->spec.height = height; 
+    sr_framebuffer_alloc_buffers(fb);
+}
+
+void sr_framebuffer_set_color(SrFramebuffer* fb, sr_u32 x, sr_u32 y, sr_vec4 color) {
+    sr_u32 index = y * fb->spec.width + x;
+    SrColorFormat format = fb->spec.color_format;
+
+    sr_pack_color(format, sr_clamp01_vec4(color), 
+                  (sr_u8*)fb->color_buffer + index * sr_color_format_get_size(format));
+}
+
+
+
+// fills every block flagged by the last depth clear that overlaps the
+// [x0, x1] x [y0, y1] rect
+static void sr_framebuffer_resolve_depth_clear(SrFramebuffer* fb, sr_u32 x0, sr_u32 y0, sr_u32 x1, sr_u32 y1) {
+    sr_u32 width  = fb->spec.width;
+    sr_u32 height = fb->spec.height;
+
+    for (sr_u32 by = y0 / SR_DEPTH_BLOCK_SIZE; by <= y1 / SR_DEPTH_BLOCK_SIZE; by++) {
+        for (sr_u32 bx = x0 / SR_DEPTH_BLOCK_SIZE; bx <= x1 / SR_DEPTH_BLOCK_SIZE; bx++) {
+            sr_u8* pending = &fb->depth_clear_pending[by * fb->depth_blocks_x + bx];
+
+            if (!*pending)
+                continue;
+
+            *pending = 0;
+
+            sr_u32 px0 = bx * SR_DEPTH_BLOCK_SIZE;
+            sr_u32 py0 = by * SR_DEPTH_BLOCK_SIZE;
+            sr_u32 px1 = sr_min(px0 + SR_DEPTH_BLOCK_SIZE, width);
+            sr_u32 py1 = sr_min(py0 + SR_DEPTH_BLOCK_SIZE, height);
+
+            switch (fb->spec.depth_format) {
+                case SR_DEPTH_FORMAT_D32F: {
+                    for (sr_u32 y = py0; y < py1; y++)
+                        for (sr_u32 x = px0; x < px1; x++)
+                            ((sr_f32*)fb->depth_buffer)[y * width + x] = fb->depth_clear_value;
+                    break;
+                }
+                case SR_DEPTH_FORMAT_D24: {
+                    sr_u32 value = sr_depth_to_d24(fb->depth_clear_value);
+                    for (sr_u32 y = py0; y < py1; y++)
+                        for (sr_u32 x = px0; x < px1; x++)
+                            ((sr_u32*)fb->depth_buffer)[y * width + x] = value;
+                    break;
+                }
+                case SR_DEPTH_FORMAT_D16: {
+                    sr_u16 value = sr_depth_to_d16(fb->depth_clear_value);
+                    for (sr_u32 y = py0; y < py1; y++)
+                        for (sr_u32 x = px0; x < px1; x++)
+                            ((sr_u16*)fb->depth_buffer)[y * width + x] = value;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+
+
+// the stored depth of a pixel whose block is already resolved
+static sr_f32 sr_framebuffer_load_stored_depth(SrFramebuffer* fb, sr_u32 index) {
+    switch (fb->spec.depth_format) {
+        case SR_DEPTH_FORMAT_D32F: return ((sr_f32*)fb->depth_buffer)[index];
+        case SR_DEPTH_FORMAT_D24:  return (sr_f32)((sr_u32*)fb->depth_buffer)[index];
+        case SR_DEPTH_FORMAT_D16:  return (sr_f32)((sr_u16*)fb->depth_buffer)[index];
+    }
+
+    return 0.0f;
+}
+
+
+
+// writes the depth of a pixel whose block is already resolved and grows
+// the range of the block to include it
+static void sr_framebuffer_store_depth(SrFramebuffer* fb, sr_u32 x, sr_u32 y, sr_f32 value) {
+    sr_u32 index = y * fb->spec.width + x;
+    sr_u32 block = (y / SR_DEPTH_BLOCK_SIZE) * fb->depth_blocks_x + x / SR_DEPTH_BLOCK_SIZE;
+
+    sr_f32 stored = sr_depth_to_stored(fb->spec.depth_format, value);
+    sr_f32 old    = sr_framebuffer_load_stored_depth(fb, index);
+
+    // the range can only shrink if the value it ended at is gone
+    if (old == fb->depth_block_min[block] || old == fb->depth_block_max[block])
+        fb->depth_block_stale[block] = 1;
+
+    switch (fb->spec.depth_format) {
+        case SR_DEPTH_FORMAT_D32F: ((sr_f32*)fb->depth_buffer)[index] = stored; break;
+        case SR_DEPTH_FORMAT_D24:  ((sr_u32*)fb->depth_buffer)[index] = (sr_u32)stored; break;
+        case SR_DEPTH_FORMAT_D16:  ((sr_u16*)fb->depth_buffer)[index] = (sr_u16)stored; break;
+    }
+
+    fb->depth_block_min[block] = sr_min(fb->depth_block_min[block], stored);
+    fb->depth_block_max[block] = sr_max(fb->depth_block_max[block], stored);
+}
+
+
+
+// recomputes the exact range of a stale block
+static void sr_framebuffer_update_depth_block(SrFramebuffer* fb, sr_u32 block) {
+    sr_u32 width   = fb->spec.width;
+    sr_u32 block_x = (block % fb->depth_blocks_x) * SR_DEPTH_BLOCK_SIZE;
+    sr_u32 block_y = (block / fb->depth_blocks_x) * SR_DEPTH_BLOCK_SIZE;
+    sr_u32 x1 = sr_min(block_x + SR_DEPTH_BLOCK_SIZE, width);
+    sr_u32 y1 = sr_min(block_y + SR_DEPTH_BLOCK_SIZE, fb->spec.height);
+
+    sr_f32 min_depth = INFINITY;
+    sr_f32 max_depth = -INFINITY;
+
+    for (sr_u32 y = block_y; y < y1; y++) {
+        for (sr_u32 x = block_x; x < x1; x++) {
+            sr_f32 stored = sr_framebuffer_load_stored_depth(fb, y * width + x);
+
+            min_depth = sr_min(min_depth, stored);
+            max_depth = sr_max(max_depth, stored);
+        }
+    }
+
+    fb->depth_block_min[block]   = min_depth;
+    fb->depth_block_max[block]   = max_depth;
+    fb->depth_block_stale[block] = 0;
+}
+
+
+
+void sr_framebuffer_set_depth(SrFramebuffer* fb, sr_u32 x, sr_u32 y, sr_f32 value) {
+    sr_framebuffer_resolve_depth_clear(fb, x, y, x, y);
+    sr_framebuffer_store_depth(fb, x, y, value);
+}
+
+
+
+// the color is packed once and the buffer is filled with whole pixels
+void sr_framebuffer_clear_color(SrFramebuffer* fb, sr_vec4 color ) {
+    sr_u32 size = fb->spec.width * fb->spec.height;
+
+    sr_vec4 pixel;
+    sr_pack_color(fb->spec.color_format, color, &pixel);
+
+    switch (sr_color_format_get_size(fb->spec.color_format)) {
+        case 4: {
+            sr_u32 value;
+            memcpy(&value, &pixel, sizeof(value));
+            sr_u32* buffer = (sr_u32*)fb->color_buffer;
+            for (sr_u32 i = 0; i < size; i++)
+                buffer[i] = value;
+            break;
+        }
+        case 8: {
+            sr_u64 value;
+            memcpy(&value, &pixel, sizeof(value));
+            sr_u64* buffer = (sr_u64*)fb->color_buffer;
+            for (sr_u32 i = 0; i < size; i++)
+                buffer[i] = value;
+            break;
+        }
+        default: {
+            sr_vec4* buffer = (sr_vec4*)fb->color_buffer;
+            for (sr_u32 i = 0; i < size; i++)
+                buffer[i] = pixel;
+            break;
+        }
+    }
+}
+
+
+
+// lazy clear, the blocks are only filled once something touches them
+void sr_framebuffer_clear_depth(SrFramebuffer* fb, sr_f32 value) {
+    sr_u32 blocks_y = (fb->spec.height + SR_DEPTH_BLOCK_SIZE - 1) / SR_DEPTH_BLOCK_SIZE;
+
+    fb->depth_clear_value = value;
+    memset(fb->depth_clear_pending, 1, fb->depth_blocks_x * blocks_y);
+    memset(fb->depth_block_stale, 0, fb->depth_blocks_x * blocks_y);
+
+    sr_f32 stored = sr_depth_to_stored(fb->spec.depth_format, value);
+
+    for (sr_u32 i = 0; i < fb->depth_blocks_x * blocks_y; i++) {
+        fb->depth_block_min[i] = stored;
+        fb->depth_block_max[i] = stored;
+    }
+}
+
+
+
+sr_vec4 sr_framebuffer_get_color(SrFramebuffer* fb, sr_u32 x, sr_u32 y) {
+    sr_u32 index = y * fb->spec.width + x;
+    SrColorFormat format = fb->spec.color_format;
+
+    return sr_unpack_color(format, (sr_u8*)fb->color_buffer + index * sr_color_format_get_size(format));
+}
+
+
+
+sr_f32 sr_framebuffer_get_depth(SrFramebuffer* fb, sr_u32 x, sr_u32 y) {
+    sr_u32 index = y * fb->spec.width + x;
+    sr_u32 block = (y / SR_DEPTH_BLOCK_SIZE) * fb->depth_blocks_x + x / SR_DEPTH_BLOCK_SIZE;
+
+    if (fb->depth_clear_pending[block])
+        sr_framebuffer_resolve_depth_clear(fb, x, y, x, y);
+
+    switch (fb->spec.depth_format) {
+        case SR_DEPTH_FORMAT_D32F: return ((sr_f32*)fb->depth_buffer)[index];
+        case SR_DEPTH_FORMAT_D24:  return ((sr_u32*)fb->depth_buffer)[index] * (1.0f / 16777215.0f);
+        case SR_DEPTH_FORMAT_D16:  return ((sr_u16*)fb->depth_buffer)[index] * (1.0f / 65535.0f);
+    }
+
+    return 0.0f;
+}
+
+
+
+void sr_framebuffer_resolve_rgba8(SrFramebuffer* fb, sr_u32* out) {
+    sr_u32 size = fb->spec.width * fb->spec.height;
+    SrColorFormat format = fb->spec.color_format;
+
+    if (format == SR_COLOR_FORMAT_RGBA8_UNORM) {
+        memcpy(out, fb->color_buffer, size * sizeof(sr_u32));
+        return;
+    }
+
+    sr_u32 pixel_size = sr_color_format_get_size(format);
+    sr_u8* in = (sr_u8*)fb->color_buffer;
+
+    for (sr_u32 i = 0; i < size; i++)
+        sr_pack_color(SR_COLOR_FORMAT_RGBA8_UNORM, sr_unpack_color(format, in + i * pixel_size), &out[i]);
+}
+
+
+
+void sr_framebuffer_free(SrFramebuffer* fb) {
+    free(fb->color_buffer);
+    free(fb->depth_buffer);
+    free(fb->depth_clear_pending);
+    free(fb->depth_block_min);
+    free(fb->depth_block_max);
+    free(fb->depth_block_stale);
+}
+
+
+
+static sr_f32 sr_compute_blend_factor(sr_f32 src, sr_f32 dst, sr_f32 src_a, sr_f32 dst_a, SrBlendFactor blend_factor) {
+    switch (blend_factor) {
+        case SR_BLEND_FACTOR_ZERO:                 return 0.0f;
+        case SR_BLEND_FACTOR_ONE:                  return 1.0f;
+        case SR_BLEND_FACTOR_SRC_COLOR:            return src;
+        case SR_BLEND_FACTOR_ONE_MINUS_SRC_COLOR:  return 1.0f - src;
+        case SR_BLEND_FACTOR_DST_COLOR:            return dst;
+        case SR_BLEND_FACTOR_ONE_MINUS_DST_COLOR:  return 1.0f - dst;
+        case SR_BLEND_FACTOR_SRC_ALPHA:            return src_a;
+        case SR_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA:  return 1.0f - src_a;
+        case SR_BLEND_FACTOR_DST_ALPHA:            return dst_a;
+        case SR_BLEND_FACTOR_ONE_MINUS_DST_ALPHA:  return 1.0f - dst_a;
+    }
+}
+
+
+
+static sr_f32 sr_compute_blend_op(sr_f32 lhs, sr_f32 rhs, SrBlendOp blend_op) {
+    switch (blend_op) {
+        case SR_BLEND_OP_ADD:      return lhs + rhs;
+        case SR_BLEND_OP_SUBTRACT: return lhs - rhs;
+        case SR_BLEND_OP_MIN:      return sr_min(lhs, rhs);
+        case SR_BLEND_OP_MAX:      return sr_max(lhs, rhs);
+    }
+}
+
+
+
+// the unorm formats compare the quantized integers, so a depth that
+// rounds to the stored value is equal to it like it would be on a gpu
+#define SR_DEPTH_COMPARE(op, new_depth, old_depth, result) \
+    switch (op) { \
+        case SR_COMPARE_OP_LESS:             result = new_depth <  old_depth; break; \
+        case SR_COMPARE_OP_EQUAL:            result = new_depth == old_depth; break; \
+        case SR_COMPARE_OP_LESS_OR_EQUAL:    result = new_depth <= old_depth; break; \
+        case SR_COMPARE_OP_GREATER:          result = new_depth >  old_depth; break; \
+        case SR_COMPARE_OP_NOT_EQUAL:        result = new_depth != old_depth; break; \
+        case SR_COMPARE_OP_GREATER_OR_EQUAL: result = new_depth >= old_depth; break; \
+    }
+
+
+
+// depth_test is a compare op or SR_DEPTH_TEST_DISABLED, it's a compile time
+// constant in the specialized fragment functions so the switch folds away
+#define SR_DEPTH_TEST_DISABLED 6
+
+static SR_FORCE_INLINE bool sr_compute_depth_compare_op(SrPipeline* pipeline, sr_u32 depth_test, 
+                                                        sr_f32 new_depth, sr_u32 x, sr_u32 y) {
+    SrFramebuffer* fb = pipeline->spec.framebuffer;
+
+    if (depth_test == SR_DEPTH_TEST_DISABLED)
+        return true;
+
+    sr_u32 index = y * fb->spec.width + x;
+    SrCompareOp op = (SrCompareOp)depth_test;
+
+    bool test = true;
+    switch (fb->spec.depth_format) {
+        case SR_DEPTH_FORMAT_D32F: {
+            sr_f32 old_depth = ((sr_f32*)fb->depth_buffer)[index];
+            SR_DEPTH_COMPARE(op, new_depth, old_depth, test);
+            break;
+        }
+        case SR_DEPTH_FORMAT_D24: {
+            sr_u32 old_depth = ((sr_u32*)fb->depth_buffer)[index];
+            sr_u32 quantized = sr_depth_to_d24(new_depth);
+            SR_DEPTH_COMPARE(op, quantized, old_depth, test);
+            break;
+        }
+        case SR_DEPTH_FORMAT_D16: {
+            sr_u32 old_depth = ((sr_u16*)fb->depth_buffer)[index];
+            sr_u32 quantized = sr_depth_to_d16(new_depth);
+            SR_DEPTH_COMPARE(op, quantized, old_depth, test);
+            break;
+        }
+    }
+
+    return test 
+        && new_depth <= pipeline->spec.depth_info.max_depth 
+        && new_depth >= pipeline->spec.depth_info.min_depth;
+}
+
+
+
+static sr_vec3 sr_get_front_face_indices(SrFrontFace ff) {
+    switch (ff) {
+      case SR_FRONT_FACE_COUNTER_CLOCKWISE: return sr_vec3{.x = 0, .y = 1, .z = 2};
+      case SR_FRONT_FACE_CLOCKWISE :        return sr_vec3{.x = 2, .y = 1, .z = 0};
+    }
+}
+
+
+
+static bool sr_should_cull(sr_f32 area, SrCullMode cull_mode) {
+    switch (cull_mode) {
+        case SR_CULL_MODE_FRONT_FACE: return !(area < SR_EP);
+        case SR_CULL_MODE_BACK_FACE: return (area < SR_EP);
+    }
+}
+
+
+
+// ==================================================================
+// =========================== ARENA ================================
+// ==================================================================
+
+
+
+struct SrArenaBlock {
+    SrArenaBlock* prev;
+    sr_usize      capacity;
+    sr_usize      used;
+    sr_u8*        data;
+};
+
+
+
+static sr_usize sr_align_up(sr_usize value, sr_usize alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+
+
+static SrArenaBlock* sr_arena_block_create(sr_usize capacity, SrArenaBlock* prev) {
+    
+    // the header and the data share a single allocation, with enough
+    // slack to align the data to SR_ARENA_ALIGNMENT
+    SrArenaBlock* block = (SrArenaBlock*)malloc(sizeof(SrArenaBlock) + capacity + SR_ARENA_ALIGNMENT);
+    block->prev     = prev;
+    block->capacity = capacity;
+    block->used     = 0;
+    block->data     = (sr_u8*)sr_align_up((sr_uptr)(block + 1), SR_ARENA_ALIGNMENT);
+
+    return block;
+}
+
+
+
+static void sr_arena_free_blocks(SrArenaBlock* block) {
+    while (block) {
+        SrArenaBlock* prev = block->prev;
+        free(block);
+        block = prev;
+    }
+}
+
+
+
+SrArena sr_arena_create(sr_usize capacity) {
+    SrArena arena;
+    memset(&arena, 0, sizeof(SrArena));
+
+    if (capacity > 0)
+        arena.block = sr_arena_block_create(capacity, NULL);
+
+    return arena;
+}
+
+
+
+void* sr_arena_alloc(SrArena* arena, sr_usize size) {
+    size = sr_align_up(sr_max(size, 1), SR_ARENA_ALIGNMENT);
+
+    SrArenaBlock* block = arena->block;
+
+    if (!block || block->used + size > block->capacity) {
+        sr_usize capacity = block ? block->capacity * 2 : 0;
+        capacity = sr_max(capacity, size);
+        capacity = sr_max(capacity, (sr_usize)SR_ARENA_MIN_BLOCK);
+
+        block = sr_arena_block_create(capacity, arena->block);
+        arena->block = block;
+        arena->reallocations_count += 1;
+    }
+
+    void* ptr = block->data + block->used;
+    block->used += size;
+
+    arena->used += size;
+    arena->high_water_mark = sr_max(arena->high_water_mark, arena->used);
+
+    return ptr;
+}
+
+
+
+void* sr_arena_realloc(SrArena* arena, void* ptr, sr_usize old_size, sr_usize new_size) {
+    if (!ptr)
+        return sr_arena_alloc(arena, new_size);
+
+    old_size = sr_align_up(sr_max(old_size, 1), SR_ARENA_ALIGNMENT);
+    new_size = sr_align_up(sr_max(new_size, 1), SR_ARENA_ALIGNMENT);
+
+    SrArenaBlock* block = arena->block;
+
+    // the last allocation of the current block can just grow in place
+    if ((sr_u8*)ptr + old_size == block->data + block->used && 
+        block->used - old_size + new_size <= block->capacity) {
+
+        block->used += new_size - old_size;
+        arena->used += new_size - old_size;
+        arena->high_water_mark = sr_max(arena->high_water_mark, arena->used);
+        return ptr;
+    }
+
+    void* result = sr_arena_alloc(arena, new_size);
+    memcpy(result, ptr, sr_min(old_size, new_size));
+
+    return result;
+}
+
+
+
+void sr_arena_reset(SrArena* arena) {
+    SrArenaBlock* block = arena->block;
+
+    // more than one block means the arena overflowed, so the chain gets 
+    // replaced by one block that fits everything used so far
+    if (block && block->prev) {
+        sr_arena_free_blocks(block);
+
+        arena->block = sr_arena_block_create(arena->high_water_mark, NULL);
+        arena->reallocations_count += 1;
+    }
+    else if (block) {
+        block->used = 0;
+    }
+
+    arena->used = 0;
+}
+
+
+
+void sr_arena_free(SrArena* arena) {
+    sr_arena_free_blocks(arena->block);
+    memset(arena, 0, sizeof(SrArena));
+}
+
+
+
+
+
+
+// ==================================================================
+// =========================== JOBS =================================
+// ==================================================================
+
+
+
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef HANDLE                 SrThread;
+typedef CRITICAL_SECTION       SrMutex;
+typedef CONDITION_VARIABLE     SrCondition;
+
+#else
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+
+typedef pthread_t              SrThread;
+typedef pthread_mutex_t        SrMutex;
+typedef pthread_cond_t         SrCondition;
+
+#endif
+
+
+
+// a job function is called once for every index in [0, job_count),
+// worker_index identifies the thread running it (the caller is worker 0)
+typedef void (*SrJobFunction)(void* data, sr_u32 job_index, sr_u32 worker_index);
+
+
+
+struct SrJobSystem {
+    SrThread*       threads;
+    sr_u32          worker_count;
+
+    SrMutex         mutex;
+    SrCondition     work_ready;
+    SrCondition     work_done;
+
+    SrJobFunction   function;
+    void*           data;
+    sr_u32          job_count;
+    volatile sr_u32 next_job;
+    sr_u32          busy_workers;
+    sr_u32          generation;
+    bool            quit;
+};
+
+
+
+typedef struct {
+    SrJobSystem* system;
+    sr_u32       worker_index;
+
+} SrWorkerInfo;
+
+
+
+#ifdef _WIN32
+
+static void sr_mutex_init(SrMutex* mutex)         { InitializeCriticalSection(mutex); }
+static void sr_mutex_destroy(SrMutex* mutex)      { DeleteCriticalSection(mutex); }
+static void sr_mutex_lock(SrMutex* mutex)         { EnterCriticalSection(mutex); }
+static void sr_mutex_unlock(SrMutex* mutex)       { LeaveCriticalSection(mutex); }
+
+static void sr_condition_init(SrCondition* cond)  { InitializeConditionVariable(cond); }
+static void sr_condition_destroy(SrCondition* cond) { (void)cond; }
+static void sr_condition_wait(SrCondition* cond, SrMutex* mutex) { SleepConditionVariableCS(cond, mutex, INFINITE); }
+static void sr_condition_broadcast(SrCondition* cond) { WakeAllConditionVariable(cond); }
+static void sr_condition_signal(SrCondition* cond) { WakeConditionVariable(cond); }
+
+static sr_u32 sr_atomic_fetch_add(volatile sr_u32* target, sr_u32 value) {
+    return (sr_u32)InterlockedExchangeAdd((volatile LONG*)target, (LONG)value);
+}
+
+static sr_u32 sr_get_hardware_thread_count() {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+
+static sr_f64 sr_get_time_ms() {
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (sr_f64)counter.QuadPart * 1000.0 / (sr_f64)frequency.QuadPart;
+}
+
+#else
+
+static void sr_mutex_init(SrMutex* mutex)         { pthread_mutex_init(mutex, NULL); }
+static void sr_mutex_destroy(SrMutex* mutex)      { pthread_mutex_destroy(mutex); }
+static void sr_mutex_lock(SrMutex* mutex)         { pthread_mutex_lock(mutex); }
+static void sr_mutex_unlock(SrMutex* mutex)       { pthread_mutex_unlock(mutex); }
+
+static void sr_condition_init(SrCondition* cond)  { pthread_cond_init(cond, NULL); }
+static void sr_condition_destroy(SrCondition* cond) { pthread_cond_destroy(cond); }
+static void sr_condition_wait(SrCondition* cond, SrMutex* mutex) { pthread_cond_wait(cond, mutex); }
+static void sr_condition_broadcast(SrCondition* cond) { pthread_cond_broadcast(cond); }
+static void sr_condition_signal(SrCondition* cond) { pthread_cond_signal(cond); }
+
+static sr_u32 sr_atomic_fetch_add(volatile sr_u32* target, sr_u32 value) {
+    return __atomic_fetch_add(target, value, __ATOMIC_ACQ_REL);
+}
+
+static sr_u32 sr_get_hardware_thread_count() {
+    sr_i64 count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (sr_u32)count : 1;
+}
+
+static sr_f64 sr_get_time_ms() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (sr_f64)time.tv_sec * 1000.0 + (sr_f64)time.tv_nsec * 1e-6;
+}
+
+#endif
+
+
+
+static void sr_job_system_run_jobs(SrJobSystem* system, sr_u32 worker_index) {
+    while (true) {
+        sr_u32 job = sr_atomic_fetch_add(&system->next_job, 1);
+        if (job >= system->job_count)
+            break;
+
+        system->function(system->data, job, worker_index);
+    }
+}
+
+
+
+static void sr_worker_loop(SrWorkerInfo* info) {
+    SrJobSystem* system = info->system;
+    sr_u32 seen_generation = 0;
+
+    while (true) {
+        sr_mutex_lock(&system->mutex);
+
+        while (!system->quit && system->generation == seen_generation)
+            sr_condition_wait(&system->work_ready, &system->mutex);
+
+        if (system->quit) {
+            sr_mutex_unlock(&system->mutex);
+            break;
+        }
+
+        seen_generation = system->generation;
+        sr_mutex_unlock(&system->mutex);
+
+
+        sr_job_system_run_jobs(system, info->worker_index);
+
+
+        sr_mutex_lock(&system->mutex);
+        system->busy_workers -= 1;
+        if (system->busy_workers == 0)
+            sr_condition_signal(&system->work_done);
+        sr_mutex_unlock(&system->mutex);
+    }
+
+    free(info);
+}
+
+
+
+#ifdef _WIN32
+
+static DWORD WINAPI sr_worker_entry(LPVOID param) {
+    sr_worker_loop((SrWorkerInfo*)param);
+    return 0;
+}
+
+#else
+
+static void* sr_worker_entry(void* param) {
+    sr_worker_loop((SrWorkerInfo*)param);
+    return NULL;
+}
+
+#endif
+
+
+
+static SrJobSystem* sr_job_system_create(sr_u32 worker_count) {
+    SrJobSystem* system = (SrJobSystem*)malloc(sizeof(SrJobSystem));
+    memset(system, 0, sizeof(SrJobSystem));
+
+    system->worker_count = worker_count == 0 ? 1 : worker_count;
+    system->threads      = (SrThread*)malloc(sizeof(SrThread) * system->worker_count);
+
+    sr_mutex_init(&system->mutex);
+    sr_condition_init(&system->work_ready);
+    sr_condition_init(&system->work_done);
+
+
+    // the calling thread always acts as worker 0, so we only
+    // spawn the remaining ones
+    for (sr_u32 i = 1; i < system->worker_count; i++) {
+        SrWorkerInfo* info = (SrWorkerInfo*)malloc(sizeof(SrWorkerInfo));
+        info->system       = system;
+        info->worker_index = i;
+
+#ifdef _WIN32
+        system->threads[i] = CreateThread(NULL, 0, sr_worker_entry, info, 0, NULL);
+#else
+        pthread_create(&system->threads[i], NULL, sr_worker_entry, info);
+#endif
+    }
+
+    return system;
+}
+
+
+
+static void sr_job_system_destroy(SrJobSystem* system) {
+    sr_mutex_lock(&system->mutex);
+    system->quit = true;
+    sr_condition_broadcast(&system->work_ready);
+    sr_mutex_unlock(&system->mutex);
+
+    for (sr_u32 i = 1; i < system->worker_count; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(system->threads[i], INFINITE);
+        CloseHandle(system->threads[i]);
+#else
+        pthread_join(system->threads[i], NULL);
+#endif
+    }
+
+    sr_condition_destroy(&system->work_done);
+    sr_condition_destroy(&system->work_ready);
+    sr_mutex_destroy(&system->mutex);
+
+    free(system->threads);
+    free(system);
+}
+
+
+
+// runs function for every job index on all the workers and blocks
+// until every job is finished
+static void sr_job_system_dispatch(SrJobSystem* system, SrJobFunction function, void* data, sr_u32 job_count) {
+    if (job_count == 0)
+        return;
+
+    if (system->worker_count == 1 || job_count == 1) {
+        for (sr_u32 i = 0; i < job_count; i++)
+            function(data, i, 0);
+        return;
+    }
+
+    sr_mutex_lock(&system->mutex);
+    system->function     = function;
+    system->data         = data;
+    system->job_count    = job_count;
+    system->next_job     = 0;
+    system->busy_workers = system->worker_count - 1;
+    system->generation  += 1;
+    sr_condition_broadcast(&system->work_ready);
+    sr_mutex_unlock(&system->mutex);
+
+    sr_job_system_run_jobs(system, 0);
+
+    sr_mutex_lock(&system->mutex);
+    while (system->busy_workers > 0)
+        sr_condition_wait(&system->work_done, &system->mutex);
+    sr_mutex_unlock(&system->mutex);
+}
+
+
+
+
+
+
+// ==================================================================
+// ========================= RASTERIZER =============================
+// ==================================================================
+
+
+// post transform triangle with everything the tile workers need
+// to rasterize it
+struct SrTriangle {
+    sr_vec4 p1;
+    sr_vec4 p2;
+    sr_vec4 p3;
+    sr_f32  ooa;
+    sr_f32  min_z;
+    sr_f32  max_z;
+    sr_u32  min_x;
+    sr_u32  min_y;
+    sr_u32  max_x;
+    sr_u32  max_y;
+    sr_u32  vertices[3];
+
+    // snapped 16.8 positions of p1, p2 and p3 when fixed_point is set
+    bool    fixed_point;
+    sr_i32  fixed_x[3];
+    sr_i32  fixed_y[3];
+
+    // plane equations of the variants, see sr_setup_planes
+    sr_f32* planes;
+
+    // the draw the triangle comes from, the triangles of different draws
+    // can share a raster pass (see sr_submit)
+    SrPipeline*       pipeline;
+    SrGlobalRegistry* registry;
+
+};
+
+
+
+// the first SR_CLIP_PLANES_COUNT bits are the planes the triangles get
+// clipped against, the viewport bits are only used to reject triangles
+// that are entirely off screen
+#define SR_CLIP_W             (1 << 0)
+#define SR_CLIP_NEAR          (1 << 1)
+#define SR_CLIP_FAR           (1 << 2)
+#define SR_CLIP_GUARD_LEFT    (1 << 3)
+#define SR_CLIP_GUARD_RIGHT   (1 << 4)
+#define SR_CLIP_GUARD_BOTTOM  (1 << 5)
+#define SR_CLIP_GUARD_TOP     (1 << 6)
+#define SR_CLIP_LEFT          (1 << 7)
+#define SR_CLIP_RIGHT         (1 << 8)
+#define SR_CLIP_BOTTOM        (1 << 9)
+#define SR_CLIP_TOP           (1 << 10)
+
+#define SR_CLIP_PLANES_COUNT  7
+#define SR_CLIP_PLANES_MASK   ((1 << SR_CLIP_PLANES_COUNT) - 1)
+#define SR_CLIP_MIN_W         0.00001f
+#define SR_MAX_CLIP_VERTICES  (3 + SR_CLIP_PLANES_COUNT)
+
+
+
+typedef struct {
+    sr_vec4 pos;
+    sr_u32  vertex;
+
+} SrClipVertex;
+
+
+
+// the variants of the vertices created by the clipper are appended after
+// the ones of the vertex pass, so the triangles can keep referencing their
+// variants by index
+typedef struct {
+    SrArena* arena;
+    sr_u8*  variants;
+    sr_u32  variants_count;
+    sr_u32  variants_capacity;
+    sr_u32  variants_stride;
+    sr_f32  guard_x;
+    sr_f32  guard_y;
+
+} SrClipper;
+
+
+
+typedef struct {
+    SrPipeline*       pipeline;
+    SrGlobalRegistry* registry;
+    sr_u8*       vertices;
+    sr_u8*       variants;
+    sr_vec4*     positions;
+    sr_vec4*     clip_positions;
+    sr_u16*      clip_codes;
+    sr_u8*       referenced;
+    sr_u8*       instances;
+    sr_u32       vertices_count;
+    sr_u32       instances_count;
+    sr_u32       chunk_size;
+    sr_f32       guard_x;
+    sr_f32       guard_y;
+
+} SrVertexContext;
+
+
+
+// triangles per job of the plane setup pass
+#define SR_PLANES_CHUNK_SIZE  256
+
+typedef struct {
+    SrTriangle*  triangles;
+    sr_u8*       variants;
+    sr_f32*      planes;
+    sr_u32       triangles_count;
+    sr_u32       variants_stride;
+    sr_u32       chunk_size;
+
+} SrPlanesContext;
+
+
+
+// pipeline is the one of the first draw of the pass, the variants buffers
+// of the workers are sized for the biggest variant of all the draws
+typedef struct {
+    SrPipeline*  pipeline;
+    SrTriangle*  triangles;
+    sr_u32*      bin_offsets;
+    sr_u32*      bin_triangles;
+    sr_u8*       scratch_variants;
+    sr_f32*      batch_variants;
+    sr_u32*      visibility_ids;
+    sr_u32       tile_size;
+    sr_u32       tiles_x;
+    sr_u32       variants_stride;
+    bool         derivatives;
+
+} SrRasterContext;
+
+
+
+#define SR_INVALID_TRIANGLE_ID 0xffffffff
+
+// triangle ids of the tile a worker is rasterizing in the visibility mode, 
+// the id of a pixel is the index of the last triangle that passed its depth
+// test, the fragments only get shaded once the whole tile is rasterized
+struct SrVisibilityTile {
+    sr_u32*      ids;
+    SrTriangle*  triangles;
+    sr_u32       x0;
+    sr_u32       y0;
+    sr_u32       stride;
+
+};
+
+
+
+// the blend states that get their own fragment functions, the other
+// combinations of factors and ops go through GENERIC
+typedef enum {
+    SR_BLEND_MODE_NONE     = 0,
+    SR_BLEND_MODE_ALPHA    = 1,
+    SR_BLEND_MODE_ADDITIVE = 2,
+    SR_BLEND_MODE_GENERIC  = 3,
+
+} SrBlendMode;
+
+
+
+static SrBlendMode sr_get_blend_mode(SrColorBlendInfo* info) {
+    if (!info->blend_enabled)
+        return SR_BLEND_MODE_NONE;
+
+    if (info->blend_op != SR_BLEND_OP_ADD)
+        return SR_BLEND_MODE_GENERIC;
+
+    if (info->src_blend_factor == SR_BLEND_FACTOR_SRC_ALPHA && 
+        info->dst_blend_factor == SR_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA)
+        return SR_BLEND_MODE_ALPHA;
+
+    if (info->src_blend_factor == SR_BLEND_FACTOR_ONE && info->dst_blend_factor == SR_BLEND_FACTOR_ONE)
+        return SR_BLEND_MODE_ADDITIVE;
+
+    return SR_BLEND_MODE_GENERIC;
+}
+
+
+
+// the specialized modes compute the same products as the generic path
+// so they give the exact same colors
+static SR_FORCE_INLINE void sr_blend_and_write_color(SrPipeline* pipeline, SrBlendMode blend_mode, 
+                                                     sr_u32 x, sr_u32 y, sr_vec4 new_color) {
+
+    if (blend_mode == SR_BLEND_MODE_NONE) {
+        sr_framebuffer_set_color(pipeline->spec.framebuffer, x, y, new_color);
+        return;
+    }
+
+    sr_vec4 final_color {}; 
+    sr_vec4 old_color = sr_framebuffer_get_color(pipeline->spec.framebuffer, x, y);
+
+    SrBlendFactor src_blend_factor = pipeline->spec.color_blend_info.src_blend_factor;
+    SrBlendFactor dst_blend_factor = pipeline->spec.color_blend_info.dst_blend_factor;
+    SrBlendOp blend_op             = pipeline->spec.color_blend_info.blend_op;
+
+    sr_f32* old_c = (sr_f32*)&old_color.x;
+    sr_f32* new_c = (sr_f32*)&new_color.x;
+    sr_f32* final_c = (sr_f32*)&final_color.x;
+
+    for (sr_u32 i = 0; i < 4; i++) {
+        switch (blend_mode) {
+            case SR_BLEND_MODE_ALPHA:
+                final_c[i] = new_color.w * new_c[i] + (1.0f - new_color.w) * old_c[i];
+                break;
+
+            case SR_BLEND_MODE_ADDITIVE:
+                final_c[i] = new_c[i] + old_c[i];
+                break;
+
+            default: {
+                sr_f32 src = sr_compute_blend_factor(new_c[i], old_c[i], 
+                                            new_color.w, old_color.w, src_blend_factor);
+                sr_f32 dst = sr_compute_blend_factor(new_c[i], old_c[i], 
+                                            new_color.w, old_color.w, dst_blend_factor);
+
+                final_c[i] = sr_compute_blend_op(src * new_c[i], dst * old_c[i], blend_op);
+            } break;
+        }
+    }
+
+    sr_framebuffer_set_color(pipeline->spec.framebuffer, x, y, final_color);
+}
+
+
+
+// tests the edge values of a group of consecutive pixels and returns their
+// coverage mask using the fill polygon mode rule (bit i = pixel i), the
+// edge values are read from e[edge * SR_MAX_LANES + lane]
+typedef sr_u32 (*SrCoverageFunction)(const sr_f32* e);
+
+
+
+// the edge values of the coverage functions are laid out like the e of 
+// the fragment functions
+#define SR_MAX_LANES SR_PIXEL_BATCH_SIZE
+#define SR_BLOCK_SIZE SR_DEPTH_BLOCK_SIZE
+#define SR_BLOCK_EDGES_COUNT (SR_BLOCK_SIZE * 3 * SR_PIXEL_BATCH_SIZE)
+
+#define SR_SUBPIXEL_BITS  8
+#define SR_SUBPIXEL_ONE   (1 << SR_SUBPIXEL_BITS)
+#define SR_FIXED_MAX      32767.0f
+
+
+
+static sr_u32 sr_coverage_scalar(const sr_f32* e) {
+    return e[0 * SR_MAX_LANES] > -SR_EP 
+        && e[1 * SR_MAX_LANES] > -SR_EP 
+        && e[2 * SR_MAX_LANES] > -SR_EP;
+}
+
+
+
+#ifdef SR_ARCH_X86
+
+static sr_u32 sr_coverage_sse2(const sr_f32* e) {
+    __m128 min_e  = _mm_set1_ps(-SR_EP);
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+    for (sr_u32 i = 0; i < 3; i++)
+        inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_loadu_ps(&e[i * SR_MAX_LANES]), min_e));
+
+    return _mm_movemask_ps(inside);
+}
+
+
+
+SR_TARGET_AVX2 static sr_u32 sr_coverage_avx2(const sr_f32* e) {
+    __m256 min_e  = _mm256_set1_ps(-SR_EP);
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+    for (sr_u32 i = 0; i < 3; i++)
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_loadu_ps(&e[i * SR_MAX_LANES]), min_e, _CMP_GT_OQ));
+
+    return _mm256_movemask_ps(inside);
+}
+
+#endif
+
+
+
+static sr_u32 sr_count_trailing_zeros(sr_u32 value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return index;
+#else
+    return __builtin_ctz(value);
+#endif
+}
+
+
+
+static sr_u32 sr_count_bits(sr_u32 value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    // __popcnt needs a cpu with popcnt
+    value = value - ((value >> 1) & 0x55555555);
+    value = (value & 0x33333333) + ((value >> 2) & 0x33333333);
+    return (((value + (value >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+#else
+    return __builtin_popcount(value);
+#endif
+}
+
+
+
+// plane equations of 1/w and of every variant float divided by w, in pixels
+// from the top left corner of the bounding box so the constant terms stay 
+// small. planes holds the values at that corner, then the x gradients and 
+// then the y gradients, 1/w first in each of them
+static void sr_setup_planes(SrTriangle* tri, sr_u8* variants, sr_u32 variants_stride, sr_f32* planes) {
+    sr_vec4 p[3] = { tri->p1, tri->p2, tri->p3 };
+    sr_f32  x[3], y[3], ow[3];
+
+    for (sr_u32 i = 0; i < 3; i++) {
+        x[i]  = tri->fixed_point ? (sr_f32)tri->fixed_x[i] / SR_SUBPIXEL_ONE : p[i].x;
+        y[i]  = tri->fixed_point ? (sr_f32)tri->fixed_y[i] / SR_SUBPIXEL_ONE : p[i].y;
+        ow[i] = 1.0f / p[i].w;
+    }
+
+    sr_f32 x21 = x[1] - x[0], x31 = x[2] - x[0];
+    sr_f32 y21 = y[1] - y[0], y31 = y[2] - y[0];
+
+    sr_f32 det = x21 * y31 - x31 * y21;
+    sr_f32 ood = det == 0.0f ? 0.0f : 1.0f / det;
+
+    sr_f32 ox = (sr_f32)tri->min_x - x[0];
+    sr_f32 oy = (sr_f32)tri->min_y - y[0];
+
+    sr_f32* v1 = (sr_f32*)&variants[tri->vertices[0] * variants_stride];
+    sr_f32* v2 = (sr_f32*)&variants[tri->vertices[1] * variants_stride];
+    sr_f32* v3 = (sr_f32*)&variants[tri->vertices[2] * variants_stride];
+
+    sr_u32  count = variants_stride / 4 + 1;
+    sr_f32* c  = planes;
+    sr_f32* dx = planes + count;
+    sr_f32* dy = planes + count * 2;
+
+    for (sr_u32 i = 0; i < count; i++) {
+        sr_f32 q1 = i == 0 ? ow[0] : v1[i - 1] * ow[0];
+        sr_f32 q2 = i == 0 ? ow[1] : v2[i - 1] * ow[1];
+        sr_f32 q3 = i == 0 ? ow[2] : v3[i - 1] * ow[2];
+
+        sr_f32 d21 = q2 - q1;
+        sr_f32 d31 = q3 - q1;
+
+        dx[i] = (d21 * y31 - d31 * y21) * ood;
+        dy[i] = (d31 * x21 - d21 * x31) * ood;
+        c[i]  = q1 + dx[i] * ox + dy[i] * oy;
+    }
+}
+
+
+
+// perspective correct variant at a pixel, a single reciprocal of 1/w 
+// for the whole variant instead of a divide per float
+static SR_FORCE_INLINE void sr_evaluate_planes(SrTriangle* tri, sr_u32 variants_stride, sr_i32 x, sr_i32 y, sr_f32* out) {
+    sr_u32  count = variants_stride / 4 + 1;
+    sr_f32* c  = tri->planes;
+    sr_f32* dx = c + count;
+    sr_f32* dy = dx + count;
+
+    sr_f32 fx = (sr_f32)(x - (sr_i32)tri->min_x);
+    sr_f32 fy = (sr_f32)(y - (sr_i32)tri->min_y);
+
+    sr_f32 w = 1.0f / (c[0] + dx[0] * fx + dy[0] * fy);
+
+    for (sr_u32 i = 1; i < count; i++)
+        out[i - 1] = (c[i] + dx[i] * fx + dy[i] * fy) * w;
+}
+
+
+
+// the variants are evaluated at the top left, top right and bottom left
+// pixels of the 2x2 quad and their differences are written after the pixel
+// variant. the quad pixels outside of the triangle are extrapolated like the
+// helper pixels of a gpu, so all the pixels of a quad get the same derivatives
+static void sr_interpolate_quad_derivatives(SrTriangle* tri, SrVariant current_variant, 
+                                            sr_u32 variants_stride, sr_u32 x, sr_u32 y) {
+
+    sr_i32 qx = x & ~1u;
+    sr_i32 qy = y & ~1u;
+
+    sr_f32* ddx = (sr_f32*)((sr_u8*)current_variant + variants_stride * 1);
+    sr_f32* ddy = (sr_f32*)((sr_u8*)current_variant + variants_stride * 2);
+
+    // the corner itself goes to the variant of the pixel, which is 
+    // evaluated again right after
+    sr_evaluate_planes(tri, variants_stride, qx,     qy,     (sr_f32*)current_variant);
+    sr_evaluate_planes(tri, variants_stride, qx + 1, qy,     ddx);
+    sr_evaluate_planes(tri, variants_stride, qx,     qy + 1, ddy);
+
+    sr_f32* q00 = (sr_f32*)current_variant;
+    for (sr_u32 i = 0; i < variants_stride / 4; i++) {
+        ddx[i] -= q00[i];
+        ddy[i] -= q00[i];
+    }
+}
+
+
+
+// sr_evaluate_planes for all the lanes of a batch, at the columns fx 
+// (relative to the bounding box like the planes) of the row fy
+static SR_FORCE_INLINE void sr_evaluate_planes_lanes(SrTriangle* tri, sr_u32 variants_stride, 
+                                                     const sr_f32* fx, sr_f32 fy, sr_f32* out) {
+    sr_u32  count = variants_stride / 4 + 1;
+    sr_f32* c  = tri->planes;
+    sr_f32* dx = c + count;
+    sr_f32* dy = dx + count;
+
+    sr_f32 w[SR_PIXEL_BATCH_SIZE];
+    for (sr_u32 l = 0; l < SR_PIXEL_BATCH_SIZE; l++)
+        w[l] = 1.0f / (c[0] + dy[0] * fy + dx[0] * fx[l]);
+
+    for (sr_u32 i = 1; i < count; i++) {
+        sr_f32  row = c[i] + dy[i] * fy;
+        sr_f32* lanes = &out[(i - 1) * SR_PIXEL_BATCH_SIZE];
+
+        for (sr_u32 l = 0; l < SR_PIXEL_BATCH_SIZE; l++)
+            lanes[l] = (row + dx[i] * fx[l]) * w[l];
+    }
+}
+
+
+
+// sr_interpolate_quad_derivatives for the lanes of a batch, every lane gets
+// its variant and with derivatives the differences across its 2x2 quad. the quad pixels outside of the triangle 
+// are extrapolated like the helper pixels of a gpu, so all the pixels of a 
+// quad get the same derivatives. the batch starts on an even column so the
+// lanes 2i and 2i + 1 are always in the same quad. the lanes outside of the
+// mask get a copy of a covered pixel so the batch shaders can run on all of 
+// them without reading extrapolated values
+static void sr_interpolate_batch(SrPipeline* pipeline, SrTriangle* tri, SrPixelBatch* batch) {
+    sr_u32 variants_stride = pipeline->spec.variants_info.byte_count;
+    sr_u32 first = sr_count_trailing_zeros(batch->mask);
+
+    sr_f32 fx[SR_PIXEL_BATCH_SIZE];
+    sr_f32 qx[SR_PIXEL_BATCH_SIZE];
+
+    for (sr_u32 l = 0; l < SR_PIXEL_BATCH_SIZE; l++) {
+        sr_u32 lane = (batch->mask >> l) & 1 ? l : first;
+
+        fx[l] = (sr_f32)(sr_i32)(batch->x + lane - tri->min_x);
+        qx[l] = (sr_f32)(sr_i32)(batch->x + (lane & ~1u) - tri->min_x);
+    }
+
+    sr_f32 fy = (sr_f32)(sr_i32)(batch->y - tri->min_y);
+
+    if (batch->ddx) {
+        sr_f32 qx1[SR_PIXEL_BATCH_SIZE];
+        for (sr_u32 l = 0; l < SR_PIXEL_BATCH_SIZE; l++)
+            qx1[l] = qx[l] + 1.0f;
+
+        sr_f32 qy = (sr_f32)(sr_i32)((batch->y & ~1u) - tri->min_y);
+
+        // the top left corner of the quads goes to the variants, which 
+        // get evaluated at the pixels right after
+        sr_evaluate_planes_lanes(tri, variants_stride, qx,  qy,        batch->variants);
+        sr_evaluate_planes_lanes(tri, variants_stride, qx1, qy,        batch->ddx);
+        sr_evaluate_planes_lanes(tri, variants_stride, qx,  qy + 1.0f, batch->ddy);
+
+        for (sr_u32 i = 0; i < variants_stride / 4 * SR_PIXEL_BATCH_SIZE; i++) {
+            batch->ddx[i] -= batch->variants[i];
+            batch->ddy[i] -= batch->variants[i];
+        }
+    }
+
+    sr_evaluate_planes_lanes(tri, variants_stride, fx, fy, batch->variants);
+}
+
+
+
+// runs a per pixel shader over the covered pixels of a batch, the variants
+// are only interpolated for them and straight to the interleaved layout 
+// the per pixel shaders read
+static void sr_pixel_shader_adapter(SrPipeline* pipeline, SrTriangle* tri, SrPixelBatch* batch, 
+                                    SrVariant current_variant) {
+
+    sr_u32 variants_stride = pipeline->spec.variants_info.byte_count;
+    sr_u32 mask = batch->mask;
+
+    while (mask) {
+        sr_u32 lane = sr_count_trailing_zeros(mask);
+        mask &= mask - 1;
+
+        sr_u32 x = batch->x + lane;
+
+        if (pipeline->spec.variants_info.derivatives)
+            sr_interpolate_quad_derivatives(tri, current_variant, variants_stride, x, batch->y);
+
+        sr_evaluate_planes(tri, variants_stride, x, batch->y, (sr_f32*)current_variant);
+
+        sr_vec4 color = pipeline->spec.pixel_shader(current_variant, tri->registry);
+
+        batch->r[lane] = color.x;
+        batch->g[lane] = color.y;
+        batch->b[lane] = color.z;
+        batch->a[lane] = color.w;
+    }
+}
+
+
+
+// interpolation of the variants, shading and blending of the covered
+// pixels of a batch
+static SR_FORCE_INLINE void sr_shade_batch(SrPipeline* pipeline, SrBlendMode blend_mode, SrTriangle* tri, 
+                                           SrPixelBatch* batch, SrVariant current_variant) {
+
+    if (pipeline->spec.batch_pixel_shader) {
+        sr_interpolate_batch(pipeline, tri, batch);
+        pipeline->spec.batch_pixel_shader(batch, tri->registry);
+    }
+    else {
+        sr_pixel_shader_adapter(pipeline, tri, batch, current_variant);
+    }
+
+    sr_u32 mask = batch->mask;
+
+    while (mask) {
+        sr_u32 lane = sr_count_trailing_zeros(mask);
+        mask &= mask - 1;
+
+        sr_vec4 color = { batch->r[lane], batch->g[lane], batch->b[lane], batch->a[lane] };
+        sr_blend_and_write_color(pipeline, blend_mode, batch->x + lane, batch->y, color);
+    }
+}
+
+
+
+// depth test of the covered pixels of a batch, then shading and blending of
+// the ones that passed. with a visibility tile the pixels only get their 
+// triangle id written and are shaded later. depth_test, depth_write and 
+// blend_mode are constants in every specialized version
+static SR_FORCE_INLINE sr_u32 sr_process_fragments(SrPipeline* pipeline, SrTriangle* tri, SrPixelBatch* batch, 
+                                                   SrVariant current_variant, SrVisibilityTile* vis, 
+                                                   sr_u32 x, sr_u32 y, sr_u32 mask, sr_f32* e,
+                                                   sr_u32 depth_test, bool depth_write, SrBlendMode blend_mode) {
+
+    sr_vec4 p1 = tri->p1;
+    sr_vec4 p2 = tri->p2;
+    sr_vec4 p3 = tri->p3;
+
+    sr_u32 passed = 0;
+
+    while (mask) {
+        sr_u32 lane = sr_count_trailing_zeros(mask);
+        mask &= mask - 1;
+
+        // normalizing the barycentric coordinates so we can use
+        // them to interpolate the depth
+        sr_f32 u = e[0 * SR_PIXEL_BATCH_SIZE + lane] * tri->ooa;
+        sr_f32 v = e[1 * SR_PIXEL_BATCH_SIZE + lane] * tri->ooa;
+        sr_f32 w = e[2 * SR_PIXEL_BATCH_SIZE + lane] * tri->ooa;
+
+        // inter_pos = p1 * u + p2 * v + p3 * w
+        sr_vec4 inter_pos = sr_vec4_add(sr_vec4_add(sr_vec4_mul_s(p1, u), 
+                        sr_vec4_mul_s(p2, v)), sr_vec4_mul_s(p3, w));
+
+        // the barycentrics don't sum exactly to one, on small triangles far from the
+        // origin that can push the depth well past the vertices. clamping it keeps 
+        // the depth on the triangle and makes the hierarchical z bounds exact
+        sr_f32 curr_depth = sr_clamp(inter_pos.z, tri->min_z, tri->max_z);
+
+        if (!sr_compute_depth_compare_op(pipeline, depth_test, curr_depth, x + lane, y))
+            continue;
+
+
+        if (depth_write) {
+            sr_framebuffer_store_depth(pipeline->spec.framebuffer, x + lane, y, curr_depth);
+        }
+
+        if (vis) {
+            vis->ids[(y - vis->y0) * vis->stride + (x + lane - vis->x0)] = (sr_u32)(tri - vis->triangles);
+            continue;
+        }
+
+        passed |= 1u << lane;
+    }
+
+    if (!passed)
+        return 0;
+
+    batch->mask = passed;
+    batch->x    = x;
+    batch->y    = y;
+
+    sr_shade_batch(pipeline, blend_mode, tri, batch, current_variant);
+
+    return sr_count_bits(passed);
+}
+
+
+
+#define SR_DEFINE_FRAGMENT_FUNCTION(depth_test, depth_write, blend_mode) \
+    static sr_u32 sr_fragment_##depth_test##_##depth_write##_##blend_mode( \
+                    SrPipeline* pipeline, SrTriangle* tri, SrPixelBatch* batch, SrVariant current_variant, \
+                    SrVisibilityTile* vis, sr_u32 x, sr_u32 y, sr_u32 mask, sr_f32* e) { \
+        return sr_process_fragments(pipeline, tri, batch, current_variant, vis, x, y, mask, e, \
+                                    depth_test, depth_write, blend_mode); \
+    }
+
+#define SR_DEFINE_FRAGMENT_FUNCTIONS_BLEND(depth_test, depth_write) \
+    SR_DEFINE_FRAGMENT_FUNCTION(depth_test, depth_write, SR_BLEND_MODE_NONE) \
+    SR_DEFINE_FRAGMENT_FUNCTION(depth_test, depth_write, SR_BLEND_MODE_ALPHA) \
+    SR_DEFINE_FRAGMENT_FUNCTION(depth_test, depth_write, SR_BLEND_MODE_ADDITIVE) \
+    SR_DEFINE_FRAGMENT_FUNCTION(depth_test, depth_write, SR_BLEND_MODE_GENERIC)
+
+#define SR_DEFINE_FRAGMENT_FUNCTIONS(depth_test) \
+    SR_DEFINE_FRAGMENT_FUNCTIONS_BLEND(depth_test, false) \
+    SR_DEFINE_FRAGMENT_FUNCTIONS_BLEND(depth_test, true)
+
+SR_DEFINE_FRAGMENT_FUNCTIONS(SR_COMPARE_OP_LESS)
+SR_DEFINE_FRAGMENT_FUNCTIONS(SR_COMPARE_OP_EQUAL)
+SR_DEFINE_FRAGMENT_FUNCTIONS(SR_COMPARE_OP_LESS_OR_EQUAL)
+SR_DEFINE_FRAGMENT_FUNCTIONS(SR_COMPARE_OP_GREATER)
+SR_DEFINE_FRAGMENT_FUNCTIONS(SR_COMPARE_OP_NOT_EQUAL)
+SR_DEFINE_FRAGMENT_FUNCTIONS(SR_COMPARE_OP_GREATER_OR_EQUAL)
+SR_DEFINE_FRAGMENT_FUNCTIONS(SR_DEPTH_TEST_DISABLED)
+
+
+
+#define SR_FRAGMENT_FUNCTIONS_BLEND(depth_test, depth_write) { \
+    sr_fragment_##depth_test##_##depth_write##_SR_BLEND_MODE_NONE, \
+    sr_fragment_##depth_test##_##depth_write##_SR_BLEND_MODE_ALPHA, \
+    sr_fragment_##depth_test##_##depth_write##_SR_BLEND_MODE_ADDITIVE, \
+    sr_fragment_##depth_test##_##depth_write##_SR_BLEND_MODE_GENERIC }
+
+#define SR_FRAGMENT_FUNCTIONS(depth_test) { \
+    SR_FRAGMENT_FUNCTIONS_BLEND(depth_test, false), \
+    SR_FRAGMENT_FUNCTIONS_BLEND(depth_test, true) }
+
+// indexed by [depth test][depth write][blend mode]
+static SrFragmentFunction sr_fragment_functions[7][2][4] = {
+    SR_FRAGMENT_FUNCTIONS(SR_COMPARE_OP_LESS),
+    SR_FRAGMENT_FUNCTIONS(SR_COMPARE_OP_EQUAL),
+    SR_FRAGMENT_FUNCTIONS(SR_COMPARE_OP_LESS_OR_EQUAL),
+    SR_FRAGMENT_FUNCTIONS(SR_COMPARE_OP_GREATER),
+    SR_FRAGMENT_FUNCTIONS(SR_COMPARE_OP_NOT_EQUAL),
+    SR_FRAGMENT_FUNCTIONS(SR_COMPARE_OP_GREATER_OR_EQUAL),
+    SR_FRAGMENT_FUNCTIONS(SR_DEPTH_TEST_DISABLED),
+};
+
+
+
+typedef enum {
+    SR_BLOCK_OUTSIDE,
+    SR_BLOCK_PARTIAL,
+    SR_BLOCK_INSIDE,
+
+} SrBlockCoverage;
+
+
+
+// classifies a block of pixels against the edges using its corners, since the
+// edge functions are linear the corners bound every pixel of the block. error
+// is a bound of the rounding error of the per pixel evaluation so the blocks 
+// that are reported inside or outside give the same result as the pixel test
+static SrBlockCoverage sr_classify_block(sr_f32* a, sr_f32* b, sr_f32* c, sr_f32* error,
+                                         sr_u32 x0, sr_u32 y0, sr_u32 x1, sr_u32 y1) {
+    bool inside = true;
+
+    for (sr_u32 i = 0; i < 3; i++) {
+        sr_f32 row0 = b[i] * (sr_f32)y0 + c[i];
+        sr_f32 row1 = b[i] * (sr_f32)y1 + c[i];
+
+        sr_f32 e00 = a[i] * (sr_f32)x0 + row0;
+        sr_f32 e10 = a[i] * (sr_f32)x1 + row0;
+        sr_f32 e01 = a[i] * (sr_f32)x0 + row1;
+        sr_f32 e11 = a[i] * (sr_f32)x1 + row1;
+
+        sr_f32 min_e = sr_min(sr_min(e00, e10), sr_min(e01, e11));
+        sr_f32 max_e = sr_max(sr_max(e00, e10), sr_max(e01, e11));
+
+        if (max_e < -SR_EP - error[i])
+            return SR_BLOCK_OUTSIDE;
+
+        // written this way so nan edges end up as partial blocks
+        if (!(min_e > -SR_EP + error[i]))
+            inside = false;
+    }
+
+    return inside ? SR_BLOCK_INSIDE : SR_BLOCK_PARTIAL;
+}
+
+
+
+// hierarchical z, depth is the nearest stored depth the triangle can write
+// (the farthest one for the greater compare ops) and it's tested against
+// the depth range of every block before walking it
+typedef struct {
+    bool        enabled;
+    SrCompareOp op;
+    sr_f32      depth;
+
+} SrHiZ;
+
+
+
+static SrHiZ sr_setup_hiz(SrPipeline* pipeline, SrTriangle* tri) {
+    SrHiZ hiz;
+    hiz.enabled = false;
+    hiz.op      = pipeline->spec.depth_info.depth_compare_op;
+    hiz.depth   = 0.0f;
+
+    if (!pipeline->spec.depth_info.depth_test_enabled || 
+        hiz.op == SR_COMPARE_OP_EQUAL || hiz.op == SR_COMPARE_OP_NOT_EQUAL)
+        return hiz;
+
+    // the fragments depth is clamped to the vertices range, so the nearest
+    // (or farthest) vertex bounds every depth the triangle can write
+    SrDepthFormat format = pipeline->spec.framebuffer->spec.depth_format;
+
+    if (hiz.op == SR_COMPARE_OP_LESS || hiz.op == SR_COMPARE_OP_LESS_OR_EQUAL)
+        hiz.depth = sr_depth_to_stored(format, tri->min_z);
+    else
+        hiz.depth = sr_depth_to_stored(format, tri->max_z);
+
+    // nan depths are left to the per pixel test
+    hiz.enabled = hiz.depth == hiz.depth;
+
+    return hiz;
+}
+
+
+
+// true when no pixel of the triangle can pass the depth test in the block
+static bool sr_hiz_reject_block(SrFramebuffer* fb, SrHiZ* hiz, sr_u32 block_x, sr_u32 block_y) {
+    if (!hiz->enabled)
+        return false;
+
+    sr_u32 block = (block_y / SR_DEPTH_BLOCK_SIZE) * fb->depth_blocks_x + block_x / SR_DEPTH_BLOCK_SIZE;
+
+    if (fb->depth_block_stale[block])
+        sr_framebuffer_update_depth_block(fb, block);
+
+    switch (hiz->op) {
+        case SR_COMPARE_OP_LESS:             return hiz->depth >= fb->depth_block_max[block];
+        case SR_COMPARE_OP_LESS_OR_EQUAL:    return hiz->depth >  fb->depth_block_max[block];
+        case SR_COMPARE_OP_GREATER:          return hiz->depth <= fb->depth_block_min[block];
+        case SR_COMPARE_OP_GREATER_OR_EQUAL: return hiz->depth <  fb->depth_block_min[block];
+        default:                             return false;
+    }
+}
+
+
+
+// rasterizes the part of the triangle that falls inside the given rect. the 
+// rect is walked in SR_BLOCK_SIZE blocks, the blocks outside of the triangle are
+// skipped and the ones fully inside are shaded without testing their pixels.
+// the edge functions are stepped from the bounding box corner one row and one
+// column at a time like the single threaded rasterizer always did, every tile
+// replays the steps that lead to its pixels, so a pixel gets the same edge
+// values whatever tile (or thread) rasterizes it, the simd width or the block
+// used to test it. e is the scratch of the edge values of a block, with
+// every row laid out like the e of the fragment functions, the caller
+// zeroes it once so the lanes the coverage groups read outside of the rect
+// are never left uninitialized
+static void sr_rasterize_triangle(SrPipeline* pipeline, SrTriangle* tri, SrPixelBatch* batch, 
+                                  SrVariant current_variant, SrVisibilityTile* vis, SrWorkerStats* stats, 
+                                  sr_f32* e, sr_u32 x0, sr_u32 y0, sr_u32 x1, sr_u32 y1) {
+
+    sr_vec4 p1 = tri->p1;
+    sr_vec4 p2 = tri->p2;
+    sr_vec4 p3 = tri->p3;
+
+
+    SrCoverageFunction coverage = sr_coverage_scalar;
+    sr_u32 lanes = 1;
+
+#ifdef SR_ARCH_X86
+    switch (pipeline->spec.rasterizer_info.simd_level) {
+        case SR_SIMD_LEVEL_AVX2: coverage = sr_coverage_avx2; lanes = 8; break;
+        case SR_SIMD_LEVEL_SSE2: coverage = sr_coverage_sse2; lanes = 4; break;
+        default: break;
+    }
+#endif
+
+
+    // edge function coefficients, e(x, y) = a * x + b * y + c, a is the step
+    // from a column to the next one and b the step from a row to the next one
+    sr_f32 a[3] = { p2.y - p3.y, p3.y - p1.y, p1.y - p2.y };
+    sr_f32 b[3] = { p3.x - p2.x, p1.x - p3.x, p2.x - p1.x };
+    sr_f32 c[3] = {
+        p2.x * p3.y - p2.y * p3.x,
+        p3.x * p1.y - p3.y * p1.x,
+        p1.x * p2.y - p1.y * p2.x,
+    };
+
+
+    sr_u32 min_x = sr_max(tri->min_x, x0);
+    sr_u32 min_y = sr_max(tri->min_y, y0);
+    sr_u32 max_x = sr_min(tri->max_x, x1);
+    sr_u32 max_y = sr_min(tri->max_y, y1);
+
+
+    // every step rounds with a relative error of at most FLT_EPSILON / 2, so
+    // a FLT_EPSILON of the terms magnitude per step (plus a few for the corner
+    // evaluations of the blocks) bounds how far the stepped values drift from
+    // a * x + b * y + c
+    sr_f32 steps = (sr_f32)(max_x - tri->min_x + max_y - tri->min_y + 8);
+
+    sr_f32 error[3];
+    for (sr_u32 i = 0; i < 3; i++)
+        error[i] = (fabsf(a[i]) * max_x + fabsf(b[i]) * max_y + fabsf(c[i])) * steps * FLT_EPSILON;
+
+
+    // the edges at the bounding box corner, stepped down to the first row of the rect
+    sr_vec4 corner = sr_vec4 {(sr_f32)tri->min_x, (sr_f32)tri->min_y, 0.0f, 0.0f};
+
+    sr_f32 row_start[3] = {
+        sr_edge_function(p2, p3, corner),
+        sr_edge_function(p3, p1, corner),
+        sr_edge_function(p1, p2, corner),
+    };
+
+    for (sr_u32 y = tri->min_y; y < min_y; y++)
+        for (sr_u32 i = 0; i < 3; i++)
+            row_start[i] += b[i];
+
+
+    // the edges of the rows of a band of blocks at the column col, as
+    // rows[edge * SR_BLOCK_SIZE + row]
+    sr_f32 rows[3 * SR_BLOCK_SIZE];
+
+    SrFramebuffer* fb = pipeline->spec.framebuffer;
+    SrHiZ hiz = sr_setup_hiz(pipeline, tri);
+    SrFragmentFunction fragment = pipeline->fragment_function;
+
+
+    for (sr_u32 block_y = min_y & ~(SR_BLOCK_SIZE - 1); block_y <= max_y; block_y += SR_BLOCK_SIZE) {
+
+        sr_u32 by0 = sr_max(block_y, min_y);
+        sr_u32 by1 = sr_min(block_y + SR_BLOCK_SIZE - 1, max_y);
+        sr_u32 rows_count = by1 - by0 + 1;
+
+        for (sr_u32 r = 0; r < SR_BLOCK_SIZE; r++) {
+            for (sr_u32 i = 0; i < 3; i++) {
+                rows[i * SR_BLOCK_SIZE + r] = r < rows_count ? row_start[i] : 0.0f;
+
+                if (r < rows_count)
+                    row_start[i] += b[i];
+            }
+        }
+
+        sr_u32 col = tri->min_x;
+
+        for (sr_u32 block_x = min_x & ~(SR_BLOCK_SIZE - 1); block_x <= max_x; block_x += SR_BLOCK_SIZE) {
+
+            if (sr_hiz_reject_block(fb, &hiz, block_x, block_y)) {
+                stats->hiz_blocks_rejected += 1;
+                continue;
+            }
+
+            sr_u32 bx0 = sr_max(block_x, min_x);
+            sr_u32 bx1 = sr_min(block_x + SR_BLOCK_SIZE - 1, max_x);
+
+            sr_u32 block_pixels = (bx1 - bx0 + 1) * rows_count;
+
+            // lanes of the batches of the block between bx0 and bx1
+            sr_u32 span = ((2u << (bx1 - block_x)) - 1) & ~((1u << (bx0 - block_x)) - 1);
+
+            SrBlockCoverage block = sr_classify_block(a, b, c, error, bx0, by0, bx1, by1);
+
+            if (block == SR_BLOCK_OUTSIDE) {
+                stats->coverage_tests_skipped += block_pixels;
+                continue;
+            }
+
+
+            // the columns of the skipped blocks are stepped over on the way
+            for (; col < bx0; col++)
+                for (sr_u32 i = 0; i < 3; i++)
+                    for (sr_u32 r = 0; r < SR_BLOCK_SIZE; r++)
+                        rows[i * SR_BLOCK_SIZE + r] += a[i];
+
+            for (; col <= bx1; col++) {
+                sr_u32 lane = col - block_x;
+
+                for (sr_u32 r = 0; r < rows_count; r++)
+                    for (sr_u32 i = 0; i < 3; i++)
+                        e[(r * 3 + i) * SR_PIXEL_BATCH_SIZE + lane] = rows[i * SR_BLOCK_SIZE + r];
+
+                for (sr_u32 i = 0; i < 3; i++)
+                    for (sr_u32 r = 0; r < SR_BLOCK_SIZE; r++)
+                        rows[i * SR_BLOCK_SIZE + r] += a[i];
+            }
+
+
+            if (block == SR_BLOCK_INSIDE) {
+                stats->coverage_tests_skipped += block_pixels;
+
+                for (sr_u32 r = 0; r < rows_count; r++)
+                    stats->pixels_count += fragment(pipeline, tri, batch, current_variant, vis, 
+                                                    block_x, by0 + r, span, &e[r * 3 * SR_PIXEL_BATCH_SIZE]);
+
+                continue;
+            }
+
+
+            stats->coverage_tests += block_pixels;
+
+            for (sr_u32 r = 0; r < rows_count; r++) {
+                sr_f32* row_e = &e[r * 3 * SR_PIXEL_BATCH_SIZE];
+
+                // the groups of lanes start on multiples of lanes so the bits
+                // land on the lane of their pixel in the batch
+                sr_u32 mask = 0;
+
+                for (sr_u32 x = bx0 & ~(lanes - 1); x <= bx1; x += lanes)
+                    mask |= coverage(&row_e[x - block_x]) << (x - block_x);
+
+                // dropping the lanes outside of the span
+                mask &= span;
+
+                if (mask)
+                    stats->pixels_count += fragment(pipeline, tri, batch, current_variant, vis, 
+                                                    block_x, by0 + r, mask, row_e);
+            }
+        }
+    }  
+}
+
+
+
+// snaps the triangle to the 16.8 grid, returns false if no pixel center can 
+// be covered after snapping. triangles outside of the fixed point range keep 
+// using the floating point rasterizer
+static bool sr_setup_fixed_point_triangle(SrTriangle* tri, sr_u32 width, sr_u32 height) {
+    sr_vec4 points[3] = { tri->p1, tri->p2, tri->p3 };
+
+    tri->fixed_point = false;
+
+    for (sr_u32 i = 0; i < 3; i++) {
+        if (!(fabsf(points[i].x) < SR_FIXED_MAX && fabsf(points[i].y) < SR_FIXED_MAX))
+            return true;
+    }
+
+    for (sr_u32 i = 0; i < 3; i++) {
+        tri->fixed_x[i] = (sr_i32)lroundf(points[i].x * SR_SUBPIXEL_ONE);
+        tri->fixed_y[i] = (sr_i32)lroundf(points[i].y * SR_SUBPIXEL_ONE);
+    }
+
+
+    // twice the signed area in 16.16, triangles that became degenerate 
+    // or flipped by the snapping don't cover anything
+    sr_i64 area = (sr_i64)(tri->fixed_y[0] - tri->fixed_y[1]) * tri->fixed_x[2] 
+                + (sr_i64)(tri->fixed_x[1] - tri->fixed_x[0]) * tri->fixed_y[2]
+                + (sr_i64)tri->fixed_x[0] * tri->fixed_y[1] - (sr_i64)tri->fixed_y[0] * tri->fixed_x[1];
+
+    if (area <= 0)
+        return false;
+
+
+    // the pixel centers are at the integer coordinates, so the bounding box is
+    // made of the centers that fall between the snapped min and max
+    sr_i32 min_fx = sr_min(tri->fixed_x[0], sr_min(tri->fixed_x[1], tri->fixed_x[2]));
+    sr_i32 min_fy = sr_min(tri->fixed_y[0], sr_min(tri->fixed_y[1], tri->fixed_y[2]));
+    sr_i32 max_fx = sr_max(tri->fixed_x[0], sr_max(tri->fixed_x[1], tri->fixed_x[2]));
+    sr_i32 max_fy = sr_max(tri->fixed_y[0], sr_max(tri->fixed_y[1], tri->fixed_y[2]));
+
+    sr_i32 min_x = sr_max((min_fx + SR_SUBPIXEL_ONE - 1) >> SR_SUBPIXEL_BITS, 0);
+    sr_i32 min_y = sr_max((min_fy + SR_SUBPIXEL_ONE - 1) >> SR_SUBPIXEL_BITS, 0);
+    sr_i32 max_x = sr_min(max_fx >> SR_SUBPIXEL_BITS, (sr_i32)width  - 1);
+    sr_i32 max_y = sr_min(max_fy >> SR_SUBPIXEL_BITS, (sr_i32)height - 1);
+
+    if (min_x > max_x || min_y > max_y)
+        return false;
+
+    tri->min_x = min_x;
+    tri->min_y = min_y;
+    tri->max_x = max_x;
+    tri->max_y = max_y;
+
+    tri->ooa = 1.0f / (sr_f32)area;
+    tri->fixed_point = true;
+
+    return true;
+}
+
+
+
+// integer version of sr_rasterize_triangle, every edge function is exact so
+// the blocks can be classified without any error margin and the pixels are
+// stepped with integer additions. a pixel exactly on an edge is only covered
+// if the edge is a top or a left edge, the two triangles sharing an edge see
+// it with opposite orientations so exactly one of them owns it
+static void sr_rasterize_triangle_fixed(SrPipeline* pipeline, SrTriangle* tri, SrPixelBatch* batch, 
+                                        SrVariant current_variant, SrVisibilityTile* vis, SrWorkerStats* stats, 
+                                        sr_u32 x0, sr_u32 y0, sr_u32 x1, sr_u32 y1) {
+
+    // edge i goes from vertex (i + 1) to vertex (i + 2), e(x, y) = a * x + b * y + c
+    // in 16.16, with x and y the pixel center in 16.8
+    sr_i64 a[3], b[3], c[3], bias[3];
+
+    for (sr_u32 i = 0; i < 3; i++) {
+        sr_u32 v1 = (i + 1) % 3;
+        sr_u32 v2 = (i + 2) % 3;
+
+        a[i] = (sr_i64)tri->fixed_y[v1] - tri->fixed_y[v2];
+        b[i] = (sr_i64)tri->fixed_x[v2] - tri->fixed_x[v1];
+        c[i] = (sr_i64)tri->fixed_x[v1] * tri->fixed_y[v2] - (sr_i64)tri->fixed_y[v1] * tri->fixed_x[v2];
+
+        // the inside of the edge is the side the (a, b) normal points to
+        bool top_left = a[i] > 0 || (a[i] == 0 && b[i] < 0);
+        bias[i] = top_left ? 0 : -1;
+    }
+
+
+    sr_u32 min_x = sr_max(tri->min_x, x0);
+    sr_u32 min_y = sr_max(tri->min_y, y0);
+    sr_u32 max_x = sr_min(tri->max_x, x1);
+    sr_u32 max_y = sr_min(tri->max_y, y1);
+
+    sr_f32 e_lanes[3 * SR_PIXEL_BATCH_SIZE];
+
+    SrFramebuffer* fb = pipeline->spec.framebuffer;
+    SrHiZ hiz = sr_setup_hiz(pipeline, tri);
+    SrFragmentFunction fragment = pipeline->fragment_function;
+
+
+    for (sr_u32 block_y = min_y & ~(SR_BLOCK_SIZE - 1); block_y <= max_y; block_y += SR_BLOCK_SIZE) {
+        for (sr_u32 block_x = min_x & ~(SR_BLOCK_SIZE - 1); block_x <= max_x; block_x += SR_BLOCK_SIZE) {
+
+            if (sr_hiz_reject_block(fb, &hiz, block_x, block_y)) {
+                stats->hiz_blocks_rejected += 1;
+                continue;
+            }
+
+            sr_u32 bx0 = sr_max(block_x, min_x);
+            sr_u32 by0 = sr_max(block_y, min_y);
+            sr_u32 bx1 = sr_min(block_x + SR_BLOCK_SIZE - 1, max_x);
+            sr_u32 by1 = sr_min(block_y + SR_BLOCK_SIZE - 1, max_y);
+
+            sr_u32 block_pixels = (bx1 - bx0 + 1) * (by1 - by0 + 1);
+
+            bool outside = false;
+            bool inside  = true;
+
+            for (sr_u32 i = 0; i < 3; i++) {
+                sr_i64 e00 = a[i] * ((sr_i64)bx0 << SR_SUBPIXEL_BITS) + b[i] * ((sr_i64)by0 << SR_SUBPIXEL_BITS) + c[i] + bias[i];
+                sr_i64 e10 = e00 + a[i] * ((sr_i64)(bx1 - bx0) << SR_SUBPIXEL_BITS);
+                sr_i64 e01 = e00 + b[i] * ((sr_i64)(by1 - by0) << SR_SUBPIXEL_BITS);
+                sr_i64 e11 = e10 + b[i] * ((sr_i64)(by1 - by0) << SR_SUBPIXEL_BITS);
+
+                sr_i64 min_e = sr_min(sr_min(e00, e10), sr_min(e01, e11));
+                sr_i64 max_e = sr_max(sr_max(e00, e10), sr_max(e01, e11));
+
+                outside = outside || max_e < 0;
+                inside  = inside  && min_e >= 0;
+            }
+
+            if (outside) {
+                stats->coverage_tests_skipped += block_pixels;
+                continue;
+            }
+
+            if (inside)
+                stats->coverage_tests_skipped += block_pixels;
+            else
+                stats->coverage_tests += block_pixels;
+
+
+
+            for (sr_u32 y = by0; y <= by1; y += 1) {
+
+                sr_i64 e[3];
+                for (sr_u32 i = 0; i < 3; i++)
+                    e[i] = a[i] * ((sr_i64)bx0 << SR_SUBPIXEL_BITS) + b[i] * ((sr_i64)y << SR_SUBPIXEL_BITS) + c[i];
+
+                sr_u32 mask = 0;
+
+                for (sr_u32 x = bx0; x <= bx1; x += 1) {
+
+                    if (inside || (e[0] + bias[0] >= 0 && e[1] + bias[1] >= 0 && e[2] + bias[2] >= 0)) {
+                        sr_u32 lane = x - block_x;
+                        e_lanes[0 * SR_PIXEL_BATCH_SIZE + lane] = (sr_f32)e[0];
+                        e_lanes[1 * SR_PIXEL_BATCH_SIZE + lane] = (sr_f32)e[1];
+                        e_lanes[2 * SR_PIXEL_BATCH_SIZE + lane] = (sr_f32)e[2];
+                        mask |= 1u << lane;
+                    }
+
+                    e[0] += a[0] << SR_SUBPIXEL_BITS;
+                    e[1] += a[1] << SR_SUBPIXEL_BITS;
+                    e[2] += a[2] << SR_SUBPIXEL_BITS;
+                }
+
+                if (mask)
+                    stats->pixels_count += fragment(pipeline, tri, batch, current_variant, vis, 
+                                                    block_x, y, mask, e_lanes);
+            }
+        }
+    }
+}
+
+
+
+// the lanes of the derivatives are right after the lanes of the variants
+// and they are only handed to the pipelines that read them
+static void sr_batch_set_triangle(SrPixelBatch* batch, SrTriangle* tri, sr_u32 lanes_count) {
+    bool derivatives = tri->pipeline->spec.variants_info.derivatives;
+
+    batch->ddx = derivatives ? batch->variants + lanes_count     : NULL;
+    batch->ddy = derivatives ? batch->variants + lanes_count * 2 : NULL;
+}
+
+
+
+// second pass of the visibility mode, every pixel of the tile that kept a
+// triangle gets shaded once. the pixels of a batch that kept the same 
+// triangle are shaded together
+static void sr_shade_visibility_tile(SrVisibilityTile* vis, SrPixelBatch* batch, sr_u32 lanes_count,
+                                     SrVariant current_variant, SrWorkerStats* stats, sr_u32 x1, sr_u32 y1) {
+
+    for (sr_u32 y = vis->y0; y <= y1; y++) {
+        for (sr_u32 x = vis->x0; x <= x1; x += SR_PIXEL_BATCH_SIZE) {
+            sr_u32* ids   = &vis->ids[(y - vis->y0) * vis->stride + (x - vis->x0)];
+            sr_u32  count = sr_min(x1 - x + 1, SR_PIXEL_BATCH_SIZE);
+
+            sr_u32 pending = 0;
+            for (sr_u32 l = 0; l < count; l++)
+                pending |= (sr_u32)(ids[l] != SR_INVALID_TRIANGLE_ID) << l;
+
+            while (pending) {
+                sr_u32 id = ids[sr_count_trailing_zeros(pending)];
+
+                sr_u32 mask = 0;
+                for (sr_u32 l = 0; l < count; l++)
+                    mask |= (sr_u32)(ids[l] == id) << l;
+
+                pending &= ~mask;
+
+                SrTriangle* tri = &vis->triangles[id];
+                sr_batch_set_triangle(batch, tri, lanes_count);
+
+                batch->mask = mask;
+                batch->x    = x;
+                batch->y    = y;
+
+                // the visibility mode is never used with blending
+                sr_shade_batch(tri->pipeline, SR_BLEND_MODE_NONE, tri, batch, current_variant);
+
+                stats->pixels_count += sr_count_bits(mask);
+            }
+        }
+    }
+}
+
+
+
+static sr_vec4 sr_clip_to_screen(sr_vec4 pos, sr_u32 width, sr_u32 height) {
+
+    // converting to NDC coordinates
+    pos.x /= pos.w;
+    pos.y /= pos.w;
+    pos.z /= pos.w;
+
+    // converting from NDC coordintates to the Screen coordinates
+    sr_vec4 result;
+    result.x = (pos.x * 0.5f + 0.5f) * (width); 
+    result.y = (pos.y * 0.5f + 0.5f) * (height);
+    result.z = pos.z;
+    result.w = pos.w;
+
+    return result;
+}
+
+
+
+static sr_u16 sr_compute_clip_codes(sr_vec4 pos, sr_f32 guard_x, sr_f32 guard_y, bool far_clip_enabled) {
+    sr_u16 codes = 0;
+
+    if (pos.w < SR_CLIP_MIN_W)                    codes |= SR_CLIP_W;
+    if (pos.z < -pos.w)                           codes |= SR_CLIP_NEAR;
+    if (far_clip_enabled && pos.z > pos.w)        codes |= SR_CLIP_FAR;
+
+    if (pos.x < -pos.w * guard_x)                 codes |= SR_CLIP_GUARD_LEFT;
+    if (pos.x >  pos.w * guard_x)                 codes |= SR_CLIP_GUARD_RIGHT;
+    if (pos.y < -pos.w * guard_y)                 codes |= SR_CLIP_GUARD_BOTTOM;
+    if (pos.y >  pos.w * guard_y)                 codes |= SR_CLIP_GUARD_TOP;
+
+    if (pos.x < -pos.w)                           codes |= SR_CLIP_LEFT;
+    if (pos.x >  pos.w)                           codes |= SR_CLIP_RIGHT;
+    if (pos.y < -pos.w)                           codes |= SR_CLIP_BOTTOM;
+    if (pos.y >  pos.w)                           codes |= SR_CLIP_TOP;
+
+    return codes;
+}
+
+
+
+// signed distance to the plane, positive on the visible side
+static sr_f32 sr_clip_plane_distance(SrClipper* clipper, sr_vec4 pos, sr_u32 plane) {
+    switch (plane) {
+        case 0: return pos.w - SR_CLIP_MIN_W;
+        case 1: return pos.w + pos.z;
+        case 2: return pos.w - pos.z;
+        case 3: return pos.w * clipper->guard_x + pos.x;
+        case 4: return pos.w * clipper->guard_x - pos.x;
+        case 5: return pos.w * clipper->guard_y + pos.y;
+        case 6: return pos.w * clipper->guard_y - pos.y;
+    }
+
+    return 0.0f;
+}
+
+
+
+// the attributes are linear in clip space so both the position and the
+// variants are interpolated before the perspective divide
+static SrClipVertex sr_clip_lerp(SrClipper* clipper, SrClipVertex a, SrClipVertex b, sr_f32 t) {
+
+    if (clipper->variants_count == clipper->variants_capacity) {
+        clipper->variants = (sr_u8*)sr_arena_realloc(clipper->arena, clipper->variants, 
+                                clipper->variants_stride * clipper->variants_capacity,
+                                clipper->variants_stride * clipper->variants_capacity * 2);
+        clipper->variants_capacity *= 2;
+    }
+
+    SrClipVertex result;
+    result.pos.x  = a.pos.x + (b.pos.x - a.pos.x) * t;
+    result.pos.y  = a.pos.y + (b.pos.y - a.pos.y) * t;
+    result.pos.z  = a.pos.z + (b.pos.z - a.pos.z) * t;
+    result.pos.w  = a.pos.w + (b.pos.w - a.pos.w) * t;
+    result.vertex = clipper->variants_count++;
+
+    sr_f32* v1  = (sr_f32*)&clipper->variants[a.vertex * clipper->variants_stride];
+    sr_f32* v2  = (sr_f32*)&clipper->variants[b.vertex * clipper->variants_stride];
+    sr_f32* out = (sr_f32*)&clipper->variants[result.vertex * clipper->variants_stride];
+
+    for (sr_u32 i = 0; i < clipper->variants_stride / 4; i++)
+        out[i] = v1[i] + (v2[i] - v1[i]) * t;
+
+    return result;
+}
+
+
+
+// sutherland-hodgman against every plane in planes, returns the vertex count
+// of the clipped convex polygon or 0 if nothing is left of it
+static sr_u32 sr_clip_polygon(SrClipper* clipper, SrClipVertex* polygon, sr_u32 count, sr_u32 planes) {
+    SrClipVertex scratch[SR_MAX_CLIP_VERTICES];
+
+    SrClipVertex* in  = polygon;
+    SrClipVertex* out = scratch;
+
+    for (sr_u32 plane = 0; plane < SR_CLIP_PLANES_COUNT; plane++) {
+        if (!(planes & (1 << plane)))
+            continue;
+
+        sr_u32 out_count = 0;
+
+        for (sr_u32 i = 0; i < count; i++) {
+            SrClipVertex a = in[i];
+            SrClipVertex b = in[(i + 1) % count];
+
+            sr_f32 da = sr_clip_plane_distance(clipper, a.pos, plane);
+            sr_f32 db = sr_clip_plane_distance(clipper, b.pos, plane);
+
+            if (da >= 0.0f)
+                out[out_count++] = a;
+
+            // always interpolating from the inside vertex so an edge shared
+            // by two triangles gets the exact same new vertex
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                if (da >= 0.0f)
+                    out[out_count++] = sr_clip_lerp(clipper, a, b, da / (da - db));
+                else
+                    out[out_count++] = sr_clip_lerp(clipper, b, a, db / (db - da));
+            }
+        }
+
+        SrClipVertex* tmp = in;
+        in    = out;
+        out   = tmp;
+        count = out_count;
+
+        if (count < 3)
+            return 0;
+    }
+
+    if (in != polygon)
+        memcpy(polygon, in, sizeof(SrClipVertex) * count);
+
+    return count;
+}
+
+
+
+// the vertices of every instance are shaded back to back, vertex v of
+// instance n is written at n * vertices_count + v
+static void sr_vertex_chunk_job(void* data, sr_u32 chunk_index, sr_u32 worker_index) {
+    SrVertexContext* ctx = (SrVertexContext*)data;
+    SrPipeline* pipeline = ctx->pipeline;
+
+    sr_f64 start = sr_get_time_ms();
+
+    sr_u32 width  = pipeline->spec.framebuffer->spec.width;
+    sr_u32 height = pipeline->spec.framebuffer->spec.height;
+    sr_u32 vertex_stride   = pipeline->spec.vertex_input_info.byte_count;
+    sr_u32 instance_stride = pipeline->spec.vertex_input_info.instance_byte_count;
+    sr_u32 variants_stride = pipeline->spec.variants_info.byte_count;
+    bool far_clip_enabled  = pipeline->spec.rasterizer_info.far_clip_enabled;
+
+    sr_u32 first = chunk_index * ctx->chunk_size;
+    sr_u32 last  = sr_min(first + ctx->chunk_size, ctx->vertices_count * ctx->instances_count);
+    sr_u32 shaded_count = 0;
+
+    // the registry is copied so the instance can be set without 
+    // racing the other workers
+    SrGlobalRegistry registry = *ctx->registry;
+
+    for (sr_u32 begin = first; begin < last; ) {
+        sr_u32 instance = begin / ctx->vertices_count;
+        sr_u32 base     = instance * ctx->vertices_count;
+        sr_u32 end      = sr_min(last, base + ctx->vertices_count);
+
+        registry.instance      = instance;
+        registry.instance_data = ctx->instances ? &ctx->instances[instance * instance_stride] : NULL;
+
+        // the batch shader gets every run of referenced vertices in one call
+        if (pipeline->spec.batch_vertex_shader) {
+            for (sr_u32 i = begin; i < end; ) {
+                if (ctx->referenced && !ctx->referenced[i - base]) {
+                    i++;
+                    continue;
+                }
+
+                sr_u32 run_end = i + 1;
+                while (run_end < end && (!ctx->referenced || ctx->referenced[run_end - base]))
+                    run_end++;
+
+                SrVertexBatch batch;
+                batch.vertices        = &ctx->vertices[(i - base) * vertex_stride];
+                batch.variants        = &ctx->variants[i * variants_stride];
+                batch.positions       = &ctx->clip_positions[i];
+                batch.vertex_stride   = vertex_stride;
+                batch.variants_stride = variants_stride;
+                batch.first           = i - base;
+                batch.count           = run_end - i;
+
+                pipeline->spec.batch_vertex_shader(&batch, &registry);
+                i = run_end;
+            }
+        }
+
+        for (sr_u32 i = begin; i < end; i++) {
+
+            // vertices that no index points to are never read so we 
+            // don't bother shading them
+            if (ctx->referenced && !ctx->referenced[i - base])
+                continue;
+
+            shaded_count += 1;
+
+            // getting the vertex shader output
+            sr_vec4 pos;
+            if (pipeline->spec.batch_vertex_shader)
+                pos = ctx->clip_positions[i];
+            else
+                pos = pipeline->spec.vertex_shader(
+                                &ctx->vertices[(i - base) * vertex_stride], 
+                                &ctx->variants[i * variants_stride], 
+                                &registry );
+
+
+            ctx->clip_positions[i] = pos;
+            ctx->clip_codes[i]     = sr_compute_clip_codes(pos, ctx->guard_x, ctx->guard_y, far_clip_enabled);
+
+            // the screen position is only read when none of the
+            // triangle's vertices needs clipping
+            ctx->positions[i] = sr_clip_to_screen(pos, width, height);
+        }
+
+        begin = end;
+    }
+
+    SrWorkerStats* stats = &pipeline->stats.workers[worker_index];
+    stats->vertices_count += shaded_count;
+    stats->vertex_ms      += sr_get_time_ms() - start;
+}
+
+
+
+// the planes of a triangle take 3 floats per variant float plus 3 for 1/w
+static void sr_setup_planes_job(void* data, sr_u32 chunk_index, sr_u32 worker_index) {
+    (void)worker_index;
+
+    SrPlanesContext* ctx = (SrPlanesContext*)data;
+    sr_u32 planes_stride = (ctx->variants_stride / 4 + 1) * 3;
+
+    sr_u32 first = chunk_index * ctx->chunk_size;
+    sr_u32 last  = sr_min(first + ctx->chunk_size, ctx->triangles_count);
+
+    for (sr_u32 i = first; i < last; i++) {
+        SrTriangle* tri = &ctx->triangles[i];
+        tri->planes = &ctx->planes[i * planes_stride];
+
+        sr_setup_planes(tri, ctx->variants, ctx->variants_stride, tri->planes);
+    }
+}
+
+
+
+// every tile is owned by exactly one worker, and its triangles are walked in
+// submission order, so the color and depth buffers don't need any locking
+static void sr_rasterize_tile_job(void* data, sr_u32 tile_index, sr_u32 worker_index) {
+    SrRasterContext* ctx = (SrRasterContext*)data;
+    SrFramebuffer* fb = ctx->pipeline->spec.framebuffer;
+
+    sr_f64 start = sr_get_time_ms();
+
+    sr_u32 variants_stride = ctx->variants_stride;
+    bool   derivatives     = ctx->derivatives;
+
+    // the quad derivatives are stored right after the pixel variant
+    sr_u32 scratch_stride = variants_stride * (derivatives ? 3 : 1);
+    SrVariant current_variant = &ctx->scratch_variants[worker_index * scratch_stride];
+
+    // and right after the lanes of the variants in the batch
+    sr_u32  lanes_count = variants_stride / 4 * SR_PIXEL_BATCH_SIZE;
+
+    SrPixelBatch batch;
+    batch.variants = &ctx->batch_variants[worker_index * lanes_count * (derivatives ? 3 : 1)];
+
+    sr_u32 x0 = (tile_index % ctx->tiles_x) * ctx->tile_size;
+    sr_u32 y0 = (tile_index / ctx->tiles_x) * ctx->tile_size;
+    sr_u32 x1 = sr_min(x0 + ctx->tile_size, fb->spec.width)  - 1;
+    sr_u32 y1 = sr_min(y0 + ctx->tile_size, fb->spec.height) - 1;
+
+    SrWorkerStats* stats = &ctx->pipeline->stats.workers[worker_index];
+
+    sr_u32 first = ctx->bin_offsets[tile_index];
+    sr_u32 last  = ctx->bin_offsets[tile_index + 1];
+
+    // the tile sizes are multiples of SR_DEPTH_BLOCK_SIZE so no other
+    // worker touches the blocks of this tile
+    if (first != last)
+        sr_framebuffer_resolve_depth_clear(fb, x0, y0, x1, y1);
+
+    sr_f32 block_edges[SR_BLOCK_EDGES_COUNT];
+    memset(block_edges, 0, sizeof(block_edges));
+
+    SrVisibilityTile  visibility;
+    SrVisibilityTile* vis = NULL;
+
+    if (ctx->visibility_ids && first != last) {
+        visibility.ids       = &ctx->visibility_ids[worker_index * ctx->tile_size * ctx->tile_size];
+        visibility.triangles = ctx->triangles;
+        visibility.x0        = x0;
+        visibility.y0        = y0;
+        visibility.stride    = ctx->tile_size;
+        vis = &visibility;
+
+        memset(visibility.ids, 0xff, sizeof(sr_u32) * ctx->tile_size * ctx->tile_size);
+    }
+
+    for (sr_u32 i = first; i < last; i++) {
+        SrTriangle* tri = &ctx->triangles[ctx->bin_triangles[i]];
+        sr_batch_set_triangle(&batch, tri, lanes_count);
+
+        if (tri->fixed_point)
+            sr_rasterize_triangle_fixed(tri->pipeline, tri, &batch, current_variant, vis, stats, x0, y0, x1, y1);
+        else
+            sr_rasterize_triangle(tri->pipeline, tri, &batch, current_variant, vis, stats, block_edges, 
+                                  x0, y0, x1, y1);
+    }
+
+    if (vis)
+        sr_shade_visibility_tile(vis, &batch, lanes_count, current_variant, stats, x1, y1);
+
+    stats->tiles_count += 1;
+    stats->raster_ms   += sr_get_time_ms() - start;
+}
+
+
+
+
+
+
+// ==================================================================
+// ========================= PIPELINE ===============================
+// ==================================================================
+
+
+
+SrPipeline sr_create_pipeline(SrPipelineSpec specs) {
+    SrPipeline pipeline;
+    memset(&pipeline, 0, sizeof(SrPipeline));
+    pipeline.spec = specs;
+
+    SrThreadingInfo* info = &pipeline.spec.threading_info;
+
+    if (info->thread_count == 0)
+        info->thread_count = sr_get_hardware_thread_count();
+
+    if (info->tile_size == 0)
+        info->tile_size = SR_DEFAULT_TILE_SIZE;
+
+    // the tiles must not share the lazily cleared depth blocks
+    info->tile_size = (info->tile_size + SR_DEPTH_BLOCK_SIZE - 1) / SR_DEPTH_BLOCK_SIZE * SR_DEPTH_BLOCK_SIZE;
+
+    if (info->vertex_chunk_size == 0)
+        info->vertex_chunk_size = SR_DEFAULT_CHUNK_SIZE;
+
+    if (pipeline.spec.rasterizer_info.guard_band_size <= 0.0f)
+        pipeline.spec.rasterizer_info.guard_band_size = SR_DEFAULT_GUARD_BAND;
+
+    // blending needs every fragment, not only the visible one
+    if (pipeline.spec.color_blend_info.blend_enabled)
+        pipeline.spec.shading_mode = SR_SHADING_MODE_FORWARD;
+
+    SrDepthInfo* depth_info = &pipeline.spec.depth_info;
+    sr_u32 depth_test = depth_info->depth_test_enabled ? depth_info->depth_compare_op : SR_DEPTH_TEST_DISABLED;
+
+    pipeline.fragment_function = sr_fragment_functions[depth_test][depth_info->depth_write_enabled]
+                                                      [sr_get_blend_mode(&pipeline.spec.color_blend_info)];
+
+    info->thread_count = sr_min(info->thread_count, SR_MAX_WORKERS);
+
+
+    SrSimdLevel supported_level = sr_get_supported_simd_level();
+    SrSimdLevel* simd_level     = &pipeline.spec.rasterizer_info.simd_level;
+
+    if (*simd_level == SR_SIMD_LEVEL_AUTO || *simd_level > supported_level)
+        *simd_level = supported_level;
+
+    sr_resolve_sampling_simd_level();
+
+    pipeline.job_system  = sr_job_system_create(info->thread_count);
+    pipeline.frame_arena = sr_arena_create(0);
+    pipeline.stats.worker_count = pipeline.job_system->worker_count;
+
+    return pipeline;
+}
+
+
+
+void sr_destroy_pipeline(SrPipeline* pipeline) {
+    if (pipeline->job_system)
+        sr_job_system_destroy(pipeline->job_system);
+
+    pipeline->job_system = NULL;
+
+    sr_arena_free(&pipeline->frame_arena);
+}
+
+
+
+void sr_pipeline_upload_texture(SrPipeline* pipeline, SrTexture* texture, sr_usize texture_slot) {
+    assert(texture_slot < SR_MAX_TEXTURES_SLOTS);
+
+    pipeline->registry.textures[texture_slot] = texture;
+}
+
+
+
+void sr_pipeline_upload_uniform_buffer(SrPipeline* pipeline, void* data, sr_u32 slot) {
+    assert(slot < SR_MAX_UNIFORMS_SLOTS);
+
+    pipeline->registry.uniforms[slot].data = data;
+}
+
+
+static sr_u32 sr_get_index(void* indices, SrIndexType index_type, sr_u32 i) {
+    if (!indices)
+        return i;
+
+    switch (index_type) {
+        case SR_INDEX_TYPE_U16: return ((sr_u16*)indices)[i];
+        case SR_INDEX_TYPE_U32: return ((sr_u32*)indices)[i];
+    }
+
+    return i;
+}
+
+
+
+typedef struct {
+    SrPipeline*       pipeline;
+    SrGlobalRegistry* registry;
+    SrArena*     arena;
+    SrTriangle*  triangles;
+    sr_u32       triangles_count;
+    sr_u32       triangles_capacity;
+    sr_u32*      bin_offsets;
+    sr_u32       tile_size;
+    sr_u32       tiles_x;
+    sr_vec3      idx;
+
+} SrSetupContext;
+
+
+
+// culls the triangle, computes its bounding box and counts it in every
+// tile it touches, positions are the screen positions of vertices
+static void sr_push_triangle(SrSetupContext* ctx, sr_vec4* positions, sr_u32* vertices) {
+    SrPipeline* pipeline = ctx->pipeline;
+
+    sr_u32 width  = pipeline->spec.framebuffer->spec.width;
+    sr_u32 height = pipeline->spec.framebuffer->spec.height;
+    sr_u32 tile_size = ctx->tile_size;
+
+    sr_vec4 p1 = positions[(sr_u32)ctx->idx.x];
+    sr_vec4 p2 = positions[(sr_u32)ctx->idx.y];
+    sr_vec4 p3 = positions[(sr_u32)ctx->idx.z];
+
 
+    sr_f32 area = sr_edge_function(p1, p2, p3); 
+
+
+    // face culling
+    if (sr_should_cull(area, pipeline->spec.rasterizer_info.cull_mode))
+        return;
+
+
+    if (ctx->triangles_count == ctx->triangles_capacity) {
+        ctx->triangles = (SrTriangle*)sr_arena_realloc(ctx->arena, ctx->triangles, 
+                                sizeof(SrTriangle) * ctx->triangles_capacity,
+                                sizeof(SrTriangle) * ctx->triangles_capacity * 2);
+        ctx->triangles_capacity *= 2;
     }
 
-    return texture;
-}
+    SrTriangle* tri = &ctx->triangles[ctx->triangles_count];
+    tri->p1  = p1;
+    tri->p2  = p2;
+    tri->p3  = p3;
+    tri->ooa = area == 0 ? 0.001f : 1.0f / area;
+    tri->min_z = sr_min(p1.z, sr_min(p2.z, p3.z));
+    tri->max_z = sr_max(p1.z, sr_max(p2.z, p3.z));
+    tri->vertices[0] = vertices[0];
+    tri->vertices[1] = vertices[1];
+    tri->vertices[2] = vertices[2];
+    tri->fixed_point = false;
+    tri->pipeline    = pipeline;
+    tri->registry    = ctx->registry;
 
 
-void sr_texture_set_sampling_mode(SrTexture* texture, SrSamplingMode sampling_mode) {
-    assert(texture);
+    // getting the bounding box of the triangle 
+    tri->min_x = round(sr_clamp(sr_min(p1.x, sr_min(p2.x, p3.x)) - 0.5f, 0.0f, (sr_f32)width  - 1));
+    tri->min_y = round(sr_clamp(sr_min(p1.y, sr_min(p2.y, p3.y)) - 0.5f, 0.0f, (sr_f32)height - 1));
+    tri->max_x = round(sr_clamp(sr_max(p1.x, sr_max(p2.x, p3.x)) + 0.5f, 0.0f, (sr_f32)width  - 1));
+    tri->max_y = round(sr_clamp(sr_max(p1.y, sr_max(p2.y, p3.y)) + 0.5f, 0.0f, (sr_f32)height - 1));
 
-    texture->spec.sampling_mode = sampling_mode;
-}
 
+    if (pipeline->spec.rasterizer_info.fixed_point_enabled && !sr_setup_fixed_point_triangle(tri, width, height))
+        return;
 
-void sr_texture_set_filter_mode(SrTexture* texture, SrFilter filter) {
-    assert(texture);
+    ctx->triangles_count += 1;
 
-    texture->spec.filter = filter;
+
+    // counting how many triangles touch every tile
+    for (sr_u32 ty = tri->min_y / tile_size; ty <= tri->max_y / tile_size; ty++)
+        for (sr_u32 tx = tri->min_x / tile_size; tx <= tri->max_x / tile_size; tx++)
+            ctx->bin_offsets[ty * ctx->tiles_x + tx + 1] += 1;
 }
 
 
 
-sr_vec4 sr_texture_get_pixel(SrTexture* texture, sr_u32 x, sr_u32 y) {
-    assert((x < texture->spec.width) && (y < texture->spec.height));
-    
-    return texture->buffer[y * texture->spec.width + x];
+// one draw as given to the sr_draw functions, a NULL index buffer means
+// the vertex buffer is a plain triangle list
+typedef struct {
+    SrPipeline*       pipeline;
+    SrGlobalRegistry* registry;
+    void*             indices;
+    sr_usize          index_count;
+    void*             vertices;
+    sr_usize          vertices_count;
+    void*             instances;
+    sr_usize          instances_count;
+
+} SrDrawCall;
+
+
+
+// the triangles of all the draws of a pass go through a single binning and
+// raster pass. the job system, frame arena and tile size are the ones of
+// the pipeline of the first draw, every draw of the pass has to render to
+// its framebuffer with the same shading mode
+typedef struct {
+    SrPipeline*    pipeline;
+    SrArena*       arena;
+    SrSetupContext setup;
+    sr_u32         tiles_count;
+    sr_u32         variants_stride;
+    bool           derivatives;
+
+} SrRasterPass;
+
+
+
+static void sr_reset_stats(SrPipeline* pipeline) {
+    memset(pipeline->stats.workers, 0, sizeof(SrWorkerStats) * pipeline->job_system->worker_count);
+    pipeline->stats.triangles_rejected = 0;
+    pipeline->stats.triangles_clipped  = 0;
 }
 
 
 
-void sr_texture_free(SrTexture* texture) {
-    free(texture->buffer);
+static void sr_begin_raster_pass(SrRasterPass* pass, SrPipeline* pipeline, sr_usize triangles_capacity) {
+    sr_u32 width     = pipeline->spec.framebuffer->spec.width;
+    sr_u32 height    = pipeline->spec.framebuffer->spec.height;
+    sr_u32 tile_size = pipeline->spec.threading_info.tile_size;
+    sr_u32 tiles_x   = (width  + tile_size - 1) / tile_size;
+    sr_u32 tiles_y   = (height + tile_size - 1) / tile_size;
+
+    // everything of the pass only lives until sr_end_raster_pass
+    pass->pipeline        = pipeline;
+    pass->arena           = &pipeline->frame_arena;
+    pass->tiles_count     = tiles_x * tiles_y;
+    pass->variants_stride = 0;
+    pass->derivatives     = false;
+
+    SrSetupContext* setup_ctx = &pass->setup;
+    setup_ctx->pipeline           = pipeline;
+    setup_ctx->registry           = &pipeline->registry;
+    setup_ctx->arena              = pass->arena;
+    setup_ctx->triangles          = (SrTriangle*)sr_arena_alloc(pass->arena, sizeof(SrTriangle) * (triangles_capacity + 1));
+    setup_ctx->triangles_count    = 0;
+    setup_ctx->triangles_capacity = triangles_capacity + 1;
+    setup_ctx->bin_offsets        = (sr_u32*)sr_arena_alloc(pass->arena, sizeof(sr_u32) * (pass->tiles_count + 1));
+    setup_ctx->tile_size          = tile_size;
+    setup_ctx->tiles_x            = tiles_x;
+
+    memset(setup_ctx->bin_offsets, 0, sizeof(sr_u32) * (pass->tiles_count + 1));
 }
 
 
 
-sr_vec4 sr_texture_sample(SrTexture* texture, sr_f32 u, sr_f32 v) {
+// vertex, setup and plane passes of a draw, its triangles are appended to
+// the ones of the pass
+static void sr_draw_geometry(SrRasterPass* pass, SrDrawCall* draw) {
+    SrPipeline* pipeline = draw->pipeline;
 
-    sr_u32 width = texture->spec.width - 1;
-    sr_u32 height = texture->spec.height - 1;
+    sr_u32 width  = pipeline->spec.framebuffer->spec.width;
+    sr_u32 height = pipeline->spec.framebuffer->spec.height;
+    sr_u32 variants_stride = pipeline->spec.variants_info.byte_count;
+    sr_u32 chunk_size      = pipeline->spec.threading_info.vertex_chunk_size;
+
+    // every instance gets its own copy of the shaded vertices and all of 
+    // them go through the same setup, binning and raster passes
+    sr_usize outputs_count = draw->vertices_count * draw->instances_count;
+
+    SrArena* arena = pass->arena;
+
+    SrVariant rm_variants       = sr_arena_alloc(arena, variants_stride  * (outputs_count + 1));
+    sr_vec4* rm_positions       = (sr_vec4*)sr_arena_alloc(arena, sizeof(sr_vec4) * outputs_count);
+    sr_vec4* clip_positions     = (sr_vec4*)sr_arena_alloc(arena, sizeof(sr_vec4) * outputs_count);
+    sr_u16* clip_codes          = (sr_u16*)sr_arena_alloc(arena, sizeof(sr_u16) * outputs_count);
+
+
+    sr_u8* variants_ptr = (sr_u8*)rm_variants;
+
+    SrIndexType index_type = pipeline->spec.vertex_input_info.index_type;
 
-    switch (texture->spec.filter) {
-        case SR_FILTER_NEAREST:
-        {
-            u = round(u * width);
-            v = round(v * height);
-
-            sr_u32 x = u;
-            sr_u32 y = v;
-
-            switch (texture->spec.sampling_mode) {
-                case SR_SAMPLING_MODE_CLAMP_TO_EDGE: {
-                    x = x < 0 ? 0 : x > width ? width : x;
-                    y = y < 0 ? 0 : y > height ? height : y;
-                    break;
-                }
-                case SR_SAMPLING_MODE_REPEAT: {
-                    x = x % width;
-                    y = y % height;
-                    break;
-                }
-            }
 
-            return sr_texture_get_pixel(texture, x, y);
+    // the constants live in the frame arena like the rest of the draw
+    if (pipeline->spec.prologue) {
+        draw->registry->constants = sr_arena_alloc(arena, pipeline->spec.constants_info.byte_count);
+        pipeline->spec.prologue(draw->registry->constants, draw->registry);
+    }
+
+
+    // post transform cache, rm_positions and rm_variants are indexed by
+    // the vertex index so every vertex shared between triangles is shaded
+    // once and its output is reused by all of them
+    sr_u8* referenced = NULL;
+
+    if (draw->indices) {
+        referenced = (sr_u8*)sr_arena_alloc(arena, draw->vertices_count);
+        memset(referenced, 0, draw->vertices_count);
 
+        for (sr_u32 i = 0; i < draw->index_count; i++) {
+            sr_u32 index = sr_get_index(draw->indices, index_type, i);
+            assert(index < draw->vertices_count);
+
+            referenced[index] = 1;
         }
-        case SR_FILTER_BILINEAR:
-        {
-            sr_vec2 curr   = sr_vec2 {.x = u * width, .y = v * height};
-
-            switch (texture->spec.sampling_mode) {
-                case SR_SAMPLING_MODE_CLAMP_TO_EDGE: {
-                    curr.x = curr.y < 0.0f ? 0.0f : curr.x > width ? width : curr.x;
-                    curr.y = curr.y < 0.0f ? 0.0f : curr.y > height ? height : curr.y;
-                    break;
-                }
-                case SR_SAMPLING_MODE_REPEAT: {
-                    curr.x = fmodf(curr.x, width);
-                    curr.y = fmodf(curr.y, height);
-                    break;
-                }
+    }
+
+
+    // the guard band expressed as a multiple of w, the same way
+    // the viewport is [-w, w] in clip space
+    sr_f32 guard_band = pipeline->spec.rasterizer_info.guard_band_size;
+    sr_f32 guard_x = 1.0f + 2.0f * guard_band / width;
+    sr_f32 guard_y = 1.0f + 2.0f * guard_band / height;
+
+
+    // vertex pass, split into chunks of vertices that get
+    // shaded on all the workers
+    SrVertexContext vertex_ctx;
+    vertex_ctx.pipeline        = pipeline;
+    vertex_ctx.registry        = draw->registry;
+    vertex_ctx.vertices        = (sr_u8*)draw->vertices;
+    vertex_ctx.variants        = variants_ptr;
+    vertex_ctx.positions       = rm_positions;
+    vertex_ctx.clip_positions  = clip_positions;
+    vertex_ctx.clip_codes      = clip_codes;
+    vertex_ctx.referenced      = referenced;
+    vertex_ctx.instances       = (sr_u8*)draw->instances;
+    vertex_ctx.vertices_count  = draw->vertices_count;
+    vertex_ctx.instances_count = draw->instances_count;
+    vertex_ctx.chunk_size      = chunk_size;
+    vertex_ctx.guard_x         = guard_x;
+    vertex_ctx.guard_y         = guard_y;
+
+    sr_job_system_dispatch(pipeline->job_system, sr_vertex_chunk_job, &vertex_ctx, 
+                           (outputs_count + chunk_size - 1) / chunk_size);
+
+
+
+    // triangle setup pass
+    SrSetupContext* setup_ctx = &pass->setup;
+    setup_ctx->pipeline = pipeline;
+    setup_ctx->registry = draw->registry;
+    setup_ctx->idx      = sr_get_front_face_indices(pipeline->spec.rasterizer_info.front_face);
+
+    sr_u32 first_triangle = setup_ctx->triangles_count;
+
+    SrClipper clipper;
+    clipper.arena             = arena;
+    clipper.variants          = variants_ptr;
+    clipper.variants_count    = outputs_count;
+    clipper.variants_capacity = outputs_count + 1;
+    clipper.variants_stride   = variants_stride;
+    clipper.guard_x           = guard_x;
+    clipper.guard_y           = guard_y;
+
+    for (sr_u32 instance = 0; instance < draw->instances_count; instance++) {
+        sr_u32 base = instance * draw->vertices_count;
+
+        for (sr_u32 i = 0; i + 2 < draw->index_count; i += 3) {
+
+            sr_u32 vertices[3] = {
+                base + sr_get_index(draw->indices, index_type, i + 0),
+                base + sr_get_index(draw->indices, index_type, i + 1),
+                base + sr_get_index(draw->indices, index_type, i + 2),
+            };
+
+            sr_u16 c1 = clip_codes[vertices[0]];
+            sr_u16 c2 = clip_codes[vertices[1]];
+            sr_u16 c3 = clip_codes[vertices[2]];
+
+
+            // every vertex is on the outer side of the same plane
+            if (c1 & c2 & c3) {
+                pipeline->stats.triangles_rejected += 1;
+                continue;
             }
 
-            sr_vec2 cell   = sr_vec2{.x = floorf(curr.x), .y = floorf(curr.y)};
-            sr_vec2 offset = sr_vec2_sub(curr, cell);
 
+            // fully inside the near/far planes and the guard band, 
+            // the rasterizer can take it as is
+            sr_u16 planes = (c1 | c2 | c3) & SR_CLIP_PLANES_MASK;
 
-            sr_vec4 c1 = sr_texture_get_pixel(texture, cell.x + 0, cell.y + 0);
-            sr_vec4 c2 = sr_texture_get_pixel(texture, cell.x + 0, cell.y + 1);
-            sr_vec4 c3 = sr_texture_get_pixel(texture, cell.x + 1, cell.y + 0);
-            sr_vec4 c4 = sr_texture_get_pixel(texture, cell.x + 1, cell.y + 1);
+            if (!planes) {
+                sr_vec4 positions[3] = {
+                    rm_positions[vertices[0]],
+                    rm_positions[vertices[1]],
+                    rm_positions[vertices[2]],
+                };
 
-            return sr_bilinear(offset.x, offset.y, c1, c2, c3, c4);
-        }
+                sr_push_triangle(setup_ctx, positions, vertices);
+                continue;
+            }
 
-    }
 
-}
+            pipeline->stats.triangles_clipped += 1;
 
+            SrClipVertex polygon[SR_MAX_CLIP_VERTICES];
 
+            for (sr_u32 j = 0; j < 3; j++) {
+                polygon[j].pos    = clip_positions[vertices[j]];
+                polygon[j].vertex = vertices[j];
+            }
 
+            sr_u32 count = sr_clip_polygon(&clipper, polygon, 3, planes);
 
-SrFramebuffer sr_framebuffer_create(SrFramebufferSpec spec) {
-    SrFramebuffer framebuffer = {spec};
 
-    sr_u32 size = spec.width * spec.height;
+            // the clipped polygon is convex so it's re-emitted as a fan
+            for (sr_u32 j = 1; j + 1 < count; j++) {
+                sr_vec4 positions[3] = {
+                    sr_clip_to_screen(polygon[0].pos,     width, height),
+                    sr_clip_to_screen(polygon[j].pos,     width, height),
+                    sr_clip_to_screen(polygon[j + 1].pos, width, height),
+                };
 
-    framebuffer.color_buffer = (sr_vec4*)malloc(size * sizeof(sr_vec4));
-    framebuffer.depth_buffer = (sr_f32*)malloc(size * sizeof(sr_f32));
+                sr_u32 fan_vertices[3] = {polygon[0].vertex, polygon[j].vertex, polygon[j + 1].vertex};
 
-    memset(framebuffer.color_buffer, 0, size * sizeof(sr_vec4));
-    memset(framebuffer.depth_buffer, 0, size * sizeof(sr_f32));
+                sr_push_triangle(setup_ctx, positions, fan_vertices);
+            }
+        }
+    }
 
-    return framebuffer;
-}
+    variants_ptr = clipper.variants;
 
-void sr_framebuffer_resize(SrFramebuffer* fb, sr_u32 width, sr_u32 height) {
-    free(fb->color_buffer);
-    free(fb->depth_buffer);
+    sr_u32 triangles_count = setup_ctx->triangles_count - first_triangle;
 
-    fb->spec.width = width; 
-    fb->spec.height = height; 
-    fb->color_buffer = (sr_vec4*)malloc(width * height * sizeof(sr_vec4));
-    fb->depth_buffer = (sr_f32*)malloc(width * height * sizeof(sr_f32));
-}
 
-void sr_framebuffer_set_color(SrFramebuffer* fb, sr_u32 x, sr_u32 y, sr_vec4 color) {
-    sr_u32 index = y * fb->spec.width + x;
 
-    fb->color_buffer[index] = sr_clamp01_vec4(color);
+    // plane equations of the variants, done once per triangle so the 
+    // pixels only pay for the multiply adds and a single reciprocal
+    sr_u32 planes_stride = (variants_stride / 4 + 1) * 3;
+
+    SrPlanesContext planes_ctx;
+    planes_ctx.triangles       = &setup_ctx->triangles[first_triangle];
+    planes_ctx.variants        = variants_ptr;
+    planes_ctx.planes          = (sr_f32*)sr_arena_alloc(arena, sizeof(sr_f32) * planes_stride * (triangles_count + 1));
+    planes_ctx.triangles_count = triangles_count;
+    planes_ctx.variants_stride = variants_stride;
+    planes_ctx.chunk_size      = SR_PLANES_CHUNK_SIZE;
+
+    sr_job_system_dispatch(pipeline->job_system, sr_setup_planes_job, &planes_ctx, 
+                           (triangles_count + SR_PLANES_CHUNK_SIZE - 1) / SR_PLANES_CHUNK_SIZE);
+
+    pass->variants_stride = sr_max(pass->variants_stride, variants_stride);
+    pass->derivatives     = pass->derivatives || pipeline->spec.variants_info.derivatives;
 }
 
 
 
-void sr_framebuffer_set_depth(SrFramebuffer* fb, sr_u32 x, sr_u32 y, sr_f32 value) {
-    sr_u32 index = y * fb->spec.width + x;
+// binning and raster passes over the triangles of all the draws of the pass
+static void sr_end_raster_pass(SrRasterPass* pass) {
+    SrPipeline* pipeline = pass->pipeline;
+    SrArena* arena = pass->arena;
 
-    fb->depth_buffer[index] = value;
-}
+    sr_u32 worker_count    = pipeline->job_system->worker_count;
+    sr_u32 tile_size       = pass->setup.tile_size;
+    sr_u32 tiles_x         = pass->setup.tiles_x;
+    sr_u32 tiles_count     = pass->tiles_count;
+    sr_u32 variants_stride = pass->variants_stride;
+    bool derivatives       = pass->derivatives;
 
+    SrTriangle* triangles  = pass->setup.triangles;
+    sr_u32 triangles_count = pass->setup.triangles_count;
+    sr_u32* bin_offsets    = pass->setup.bin_offsets;
 
+    SrVariant scratch_variants  = sr_arena_alloc(arena, variants_stride  * worker_count * (derivatives ? 3 : 1));
+    sr_f32* batch_variants      = (sr_f32*)sr_arena_alloc(arena, variants_stride * SR_PIXEL_BATCH_SIZE * worker_count * (derivatives ? 3 : 1));
 
-void sr_framebuffer_clear_color(SrFramebuffer* fb, sr_vec4 color ) {
-    sr_u32 size = fb->spec.width * fb->spec.height;
 
-    for (sr_u32 i = 0; i < size; i++)
-        fb->color_buffer[i] = color;
+    // binning pass, the bins are laid out back to back so every tile
+    // gets the [bin_offsets[tile], bin_offsets[tile + 1]) range
+    for (sr_u32 i = 0; i < tiles_count; i++)
+        bin_offsets[i + 1] += bin_offsets[i];
+
+    sr_u32* bin_triangles = (sr_u32*)sr_arena_alloc(arena, sizeof(sr_u32) * (bin_offsets[tiles_count] + 1));
+    sr_u32* bin_cursors   = (sr_u32*)sr_arena_alloc(arena, sizeof(sr_u32) * tiles_count);
+    memcpy(bin_cursors, bin_offsets, sizeof(sr_u32) * tiles_count);
+
+    for (sr_u32 i = 0; i < triangles_count; i++) {
+        SrTriangle* tri = &triangles[i];
+
+        for (sr_u32 ty = tri->min_y / tile_size; ty <= tri->max_y / tile_size; ty++)
+            for (sr_u32 tx = tri->min_x / tile_size; tx <= tri->max_x / tile_size; tx++)
+                bin_triangles[bin_cursors[ty * tiles_x + tx]++] = i;
+    }
+
+
+
+    // rasteration pass
+    SrRasterContext ctx;
+    ctx.pipeline         = pipeline;
+    ctx.triangles        = triangles;
+    ctx.bin_offsets      = bin_offsets;
+    ctx.bin_triangles    = bin_triangles;
+    ctx.scratch_variants = (sr_u8*)scratch_variants;
+    ctx.batch_variants   = batch_variants;
+    ctx.visibility_ids   = NULL;
+    ctx.tile_size        = tile_size;
+    ctx.tiles_x          = tiles_x;
+    ctx.variants_stride  = variants_stride;
+    ctx.derivatives      = derivatives;
+
+    // one id buffer per worker, the tiles are resolved one at a time
+    if (pipeline->spec.shading_mode == SR_SHADING_MODE_VISIBILITY)
+        ctx.visibility_ids = (sr_u32*)sr_arena_alloc(arena, sizeof(sr_u32) * tile_size * tile_size * worker_count);
+
+    sr_job_system_dispatch(pipeline->job_system, sr_rasterize_tile_job, &ctx, tiles_count);
+
+
+    sr_arena_reset(arena);
 }
 
 
 
-void sr_framebuffer_clear_depth(SrFramebuffer* fb, sr_f32 value) {
-    sr_u32 size = fb->spec.width * fb->spec.height;
+// shared path of the sr_draw functions, the draw gets a raster pass 
+// of its own
+static void sr_draw_internal(SrPipeline* pipeline, void* indices, sr_usize index_count, 
+                             void* buff, sr_usize vertices_count, 
+                             void* instances, sr_usize instances_count) {
 
-    for (sr_u32 i = 0; i < size; i++)
-        fb->depth_buffer[i] = value;
+    SrDrawCall draw;
+    draw.pipeline        = pipeline;
+    draw.registry        = &pipeline->registry;
+    draw.indices         = indices;
+    draw.index_count     = index_count;
+    draw.vertices        = buff;
+    draw.vertices_count  = vertices_count;
+    draw.instances       = instances;
+    draw.instances_count = instances_count;
+
+    sr_reset_stats(pipeline);
+
+    SrRasterPass pass;
+    sr_begin_raster_pass(&pass, pipeline, index_count / 3 * instances_count);
+    sr_draw_geometry(&pass, &draw);
+    sr_end_raster_pass(&pass);
+
+    pipeline->registry.constants = NULL;
 }
 
 
 
-sr_vec4 sr_framebuffer_get_color(SrFramebuffer* fb, sr_u32 x, sr_u32 y) {
-    return fb->color_buffer[y * fb->spec.width + x];
+void sr_draw(SrPipeline* pipeline, sr_usize vertices_count, void* buff) {
+    sr_draw_internal(pipeline, NULL, vertices_count, buff, vertices_count, NULL, 1);
 }
 
 
 
-sr_f32 sr_framebuffer_get_depth(SrFramebuffer* fb, sr_u32 x, sr_u32 y) {
-    return fb->depth_buffer[y * fb->spec.width + x];
+void sr_draw_indexed(SrPipeline* pipeline, void* index_buffer, sr_usize index_count, 
+                     void* vertex_buffer, sr_usize vertices_count) {
+    sr_draw_internal(pipeline, index_buffer, index_count, vertex_buffer, vertices_count, NULL, 1);
 }
 
 
 
-void sr_framebuffer_free(SrFramebuffer* fb) {
-    free(fb->color_buffer);
-    free(fb->depth_buffer);
+void sr_draw_instanced(SrPipeline* pipeline, sr_usize vertices_count, void* vertex_buffer, 
+                       sr_usize instances_count, void* instance_buffer) {
+    sr_draw_internal(pipeline, NULL, vertices_count, vertex_buffer, vertices_count, 
+                     instance_buffer, instances_count);
 }
 
 
 
-static sr_f32 sr_compute_blend_factor(sr_f32 src, sr_f32 dst, sr_f32 src_a, sr_f32 dst_a, SrBlendFactor blend_factor) {
-    switch (blend_factor) {
-        case SR_BLEND_FACTOR_ZERO:                 return 0.0f;
-        case SR_BLEND_FACTOR_ONE:                  return 1.0f;
-        case SR_BLEND_FACTOR_SRC_COLOR:            return src;
-        case SR_BLEND_FACTOR_ONE_MINUS_SRC_COLOR:  return 1.0f - src;
-        case SR_BLEND_FACTOR_DST_COLOR:            return dst;
-        case SR_BLEND_FACTOR_ONE_MINUS_DST_COLOR:  return 1.0f - dst;
-        case SR_BLEND_FACTOR_SRC_ALPHA:            return src_a;
-        case SR_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA:  return 1.0f - src_a;
-        case SR_BLEND_FACTOR_DST_ALPHA:            return dst_a;
-        case SR_BLEND_FACTOR_ONE_MINUS_DST_ALPHA:  return 1.0f - dst_a;
-    }
+void sr_draw_indexed_instanced(SrPipeline* pipeline, void* index_buffer, sr_usize index_count, 
+                               void* vertex_buffer, sr_usize vertices_count, 
+                               sr_usize instances_count, void* instance_buffer) {
+    sr_draw_internal(pipeline, index_buffer, index_count, vertex_buffer, vertices_count, 
+                     instance_buffer, instances_count);
 }
 
 
 
-static sr_f32 sr_compute_blend_op(sr_f32 lhs, sr_f32 rhs, SrBlendOp blend_op) {
-    switch (blend_op) {
-        case SR_BLEND_OP_ADD:      return lhs + rhs;
-        case SR_BLEND_OP_SUBTRACT: return lhs - rhs;
-        case SR_BLEND_OP_MIN:      return sr_min(lhs, rhs);
-        case SR_BLEND_OP_MAX:      return sr_max(lhs, rhs);
-    }
+
+
+
+
+// ==================================================================
+// ======================== COMMAND BUFFERS =========================
+// ==================================================================
+
+
+
+typedef enum {
+    SR_COMMAND_BIND_PIPELINE       = 0,
+    SR_COMMAND_BIND_TEXTURE        = 1,
+    SR_COMMAND_BIND_UNIFORM_BUFFER = 2,
+    SR_COMMAND_CLEAR_COLOR         = 3,
+    SR_COMMAND_CLEAR_DEPTH         = 4,
+    SR_COMMAND_DRAW                = 5,
+
+} SrCommandType;
+
+
+
+// draw.pipeline is also the pipeline of SR_COMMAND_BIND_PIPELINE, and 
+// the registry of a draw is only resolved when it gets submitted
+struct SrCommand {
+    SrCommandType  type;
+    SrDrawCall     draw;
+    void*          binding;
+    sr_u32         slot;
+    SrFramebuffer* framebuffer;
+    sr_vec4        clear_color;
+    sr_f32         clear_depth;
+
+};
+
+
+
+struct SrFence {
+    SrThread        thread;
+    bool            pending;
+    volatile sr_u32 signaled;
+
+};
+
+
+
+// the commands of all the command buffers of a submit, only the clears 
+// and the draws are left once the bindings are resolved
+typedef struct {
+    SrArena    arena;
+    SrCommand* commands;
+    sr_u32     commands_count;
+    SrFence*   fence;
+
+} SrSubmission;
+
+
+
+SrCommandBuffer sr_command_buffer_create() {
+    SrCommandBuffer cmd;
+    memset(&cmd, 0, sizeof(SrCommandBuffer));
+    cmd.arena = sr_arena_create(0);
+
+    return cmd;
 }
 
 
 
-static bool sr_compute_depth_compare_op(SrPipeline* pipeline, sr_f32 new_depth, sr_u32 x, sr_u32 y) {
-    SrFramebuffer* fb = pipeline->spec.framebuffer;
+void sr_command_buffer_reset(SrCommandBuffer* cmd) {
+    sr_arena_reset(&cmd->arena);
 
-    sr_f32 old_depth = fb->depth_buffer[y * fb->spec.width + x];
+    cmd->commands          = NULL;
+    cmd->commands_count    = 0;
+    cmd->commands_capacity = 0;
+    cmd->pipeline          = NULL;
+}
 
-    if (!pipeline->spec.depth_info.depth_test_enabled)
-        return true;
 
-    bool test = true;
-    switch (pipeline->spec.depth_info.depth_compare_op) {
-        case SR_COMPARE_OP_LESS:             test = new_depth < old_depth; break;
-        case SR_COMPARE_OP_EQUAL:            test = new_depth == old_depth; break;
-        case SR_COMPARE_OP_LESS_OR_EQUAL:    test = new_depth <= old_depth; break;
-        case SR_COMPARE_OP_GREATER:          test = new_depth > old_depth; break;
-        case SR_COMPARE_OP_NOT_EQUAL:        test = new_depth != old_depth; break;
-        case SR_COMPARE_OP_GREATER_OR_EQUAL: test = new_depth >= old_depth; break;
-    }
 
-    return test 
-        && new_depth <= pipeline->spec.depth_info.max_depth 
-        && new_depth >= pipeline->spec.depth_info.min_depth;
+void sr_command_buffer_free(SrCommandBuffer* cmd) {
+    sr_arena_free(&cmd->arena);
+    memset(cmd, 0, sizeof(SrCommandBuffer));
 }
 
 
 
-static sr_vec3 sr_get_front_face_indices(SrFrontFace ff) {
-    switch (ff) {
-      case SR_FRONT_FACE_COUNTER_CLOCKWISE: return sr_vec3{.x = 0, .y = 1, .z = 2};
-      case SR_FRONT_FACE_CLOCKWISE :        return sr_vec3{.x = 2, .y = 1, .z = 0};
+static SrCommand* sr_command_buffer_push(SrCommandBuffer* cmd, SrCommandType type) {
+
+    if (cmd->commands_count == cmd->commands_capacity) {
+        sr_u32 capacity = cmd->commands_capacity ? cmd->commands_capacity * 2 : 64;
+
+        cmd->commands = (SrCommand*)sr_arena_realloc(&cmd->arena, cmd->commands, 
+                                sizeof(SrCommand) * cmd->commands_capacity,
+                                sizeof(SrCommand) * capacity);
+        cmd->commands_capacity = capacity;
     }
+
+    SrCommand* command = &cmd->commands[cmd->commands_count++];
+    memset(command, 0, sizeof(SrCommand));
+    command->type = type;
+
+    return command;
 }
 
 
 
-static bool sr_is_point_inside_polygon(SrRasterizerInfo* info, sr_f32 e1, sr_f32 e2, sr_f32 e3) {
-    switch (info->polygon_mode) {
-        case SR_POLYGON_MODE_FILL : 
-        {
-            return e1 > -SR_EP 
-                && e2 > -SR_EP 
-                && e3 > -SR_EP;
-        }
-    }
+void sr_cmd_bind_pipeline(SrCommandBuffer* cmd, SrPipeline* pipeline) {
+    SrCommand* command = sr_command_buffer_push(cmd, SR_COMMAND_BIND_PIPELINE);
+    command->draw.pipeline = pipeline;
+
+    cmd->pipeline = pipeline;
 }
 
 
 
-static bool sr_should_cull(sr_f32 area, SrCullMode cull_mode) {
-    switch (cull_mode) {
-        case SR_CULL_MODE_FRONT_FACE: return !(area < SR_EP);
-        case SR_CULL_MODE_BACK_FACE: return (area < SR_EP);
-    }
+void sr_cmd_bind_texture(SrCommandBuffer* cmd, SrTexture* texture, sr_usize texture_slot) {
+    assert(cmd->pipeline && texture_slot < SR_MAX_TEXTURES_SLOTS);
+
+    SrCommand* command = sr_command_buffer_push(cmd, SR_COMMAND_BIND_TEXTURE);
+    command->binding = texture;
+    command->slot    = texture_slot;
 }
 
 
 
-static void sr_interpolate_variant(void* out, void* curr, sr_u32 size, sr_f32 u, sr_f32 v, sr_f32 w, sr_f32 z) {
+void sr_cmd_bind_uniform_buffer(SrCommandBuffer* cmd, void* data, sr_u32 slot) {
+    assert(cmd->pipeline && slot < SR_MAX_UNIFORMS_SLOTS);
 
-    sr_f32* ptr1 = (sr_f32*)((sr_u8*)curr);
-    sr_f32* ptr2 = (sr_f32*)((sr_u8*)curr + size);
-    sr_f32* ptr3 = (sr_f32*)((sr_u8*)curr + size + size);
+    SrCommand* command = sr_command_buffer_push(cmd, SR_COMMAND_BIND_UNIFORM_BUFFER);
+    command->binding = data;
+    command->slot    = slot;
+}
 
-    sr_f32* out_ptr = (sr_f32*)out;
 
-    for (sr_u32 i = 0; i < size / 4; i++)
-        out_ptr[i] = (ptr1[i] * u + ptr2[i] * v + ptr3[i] * w) / z;
 
+void sr_cmd_clear_color(SrCommandBuffer* cmd, SrFramebuffer* fb, sr_vec4 color) {
+    SrCommand* command = sr_command_buffer_push(cmd, SR_COMMAND_CLEAR_COLOR);
+    command->framebuffer = fb;
+    command->clear_color = color;
 }
 
 
 
-SrPipeline sr_create_pipeline(SrPipelineSpec specs) {
-    SrPipeline pipeline;
-    pipeline.spec = specs;
-    return pipeline;
+void sr_cmd_clear_depth(SrCommandBuffer* cmd, SrFramebuffer* fb, sr_f32 value) {
+    SrCommand* command = sr_command_buffer_push(cmd, SR_COMMAND_CLEAR_DEPTH);
+    command->framebuffer = fb;
+    command->clear_depth = value;
 }
 
 
 
-void sr_pipeline_upload_texture(SrPipeline* pipeline, SrTexture* texture, sr_usize texture_slot) {
-    assert(texture_slot < SR_MAX_TEXTURES_SLOTS);
+void sr_cmd_draw_indexed_instanced(SrCommandBuffer* cmd, void* index_buffer, sr_usize index_count, 
+                                   void* vertex_buffer, sr_usize vertices_count, 
+                                   sr_usize instances_count, void* instance_buffer) {
+    assert(cmd->pipeline);
 
-    pipeline->registry.textures[texture_slot] = texture;
+    SrCommand* command = sr_command_buffer_push(cmd, SR_COMMAND_DRAW);
+    command->draw.pipeline        = cmd->pipeline;
+    command->draw.indices         = index_buffer;
+    command->draw.index_count     = index_count;
+    command->draw.vertices        = vertex_buffer;
+    command->draw.vertices_count  = vertices_count;
+    command->draw.instances       = instance_buffer;
+    command->draw.instances_count = instances_count;
 }
 
 
 
-void sr_pipeline_upload_uniform_buffer(SrPipeline* pipeline, void* data, sr_u32 slot) {
-    assert(slot < SR_MAX_UNIFORMS_SLOTS);
+void sr_cmd_draw(SrCommandBuffer* cmd, sr_usize vertices_count, void* buff) {
+    sr_cmd_draw_indexed_instanced(cmd, NULL, vertices_count, buff, vertices_count, 1, NULL);
+}
 
-    pipeline->registry.uniforms[slot].data = data;
+
+
+void sr_cmd_draw_indexed(SrCommandBuffer* cmd, void* index_buffer, sr_usize index_count, 
+                         void* vertex_buffer, sr_usize vertices_count) {
+    sr_cmd_draw_indexed_instanced(cmd, index_buffer, index_count, vertex_buffer, vertices_count, 1, NULL);
 }
 
 
-void sr_draw(SrPipeline* pipeline, sr_usize vertices_count, void* buff) {
 
-    sr_u32 width  = pipeline->spec.framebuffer->spec.width;
-    sr_u32 height = pipeline->spec.framebuffer->spec.height;
-    sr_u32 vertex_stride   = pipeline->spec.vertex_input_info.byte_count;
-    sr_u32 variants_stride = pipeline->spec.variants_info.byte_count;
+void sr_cmd_draw_instanced(SrCommandBuffer* cmd, sr_usize vertices_count, void* vertex_buffer, 
+                           sr_usize instances_count, void* instance_buffer) {
+    sr_cmd_draw_indexed_instanced(cmd, NULL, vertices_count, vertex_buffer, vertices_count, 
+                                  instances_count, instance_buffer);
+}
 
-    
 
-    SrVariant rm_variants     = malloc(variants_stride  * vertices_count);
-    SrVariant current_variant = malloc(variants_stride);
-    sr_vec4* rm_positions      = (sr_vec4*)malloc(sizeof(sr_vec4) * vertices_count);
 
+// replays the bindings of every command buffer so each draw gets the 
+// registry it would have had, the draws that follow the same bindings 
+// share their registry
+static SrSubmission* sr_resolve_commands(SrCommandBuffer* cmds, sr_u32 count) {
+    SrSubmission* submission = (SrSubmission*)malloc(sizeof(SrSubmission));
+    submission->arena          = sr_arena_create(0);
+    submission->commands_count = 0;
+    submission->fence          = NULL;
 
-    sr_u8* vertex_ptr   = (sr_u8*)buff;
-    sr_u8* variants_ptr = (sr_u8*)rm_variants;
+    sr_u32 total_count = 0;
+    for (sr_u32 i = 0; i < count; i++)
+        total_count += cmds[i].commands_count;
+
+    submission->commands = (SrCommand*)sr_arena_alloc(&submission->arena, sizeof(SrCommand) * total_count);
 
+    for (sr_u32 i = 0; i < count; i++) {
+        SrPipeline* pipeline = NULL;
+        SrGlobalRegistry* registry = NULL;
+        bool registry_used = false;
 
-    // vertex pass
-    for (sr_u32 i = 0; i < vertices_count; i++) {
+        for (sr_u32 j = 0; j < cmds[i].commands_count; j++) {
+            SrCommand* command = &cmds[i].commands[j];
 
+            switch (command->type) {
+                case SR_COMMAND_BIND_PIPELINE:
+                    pipeline = command->draw.pipeline;
+                    registry = NULL;
+                    break;
+
+                case SR_COMMAND_BIND_TEXTURE:
+                case SR_COMMAND_BIND_UNIFORM_BUFFER: {
 
-        // getting the vertex shader output
-        sr_vec4 pos = pipeline->spec.vertex_shader(
-                            &vertex_ptr[i * vertex_stride], 
-                            &variants_ptr[i * variants_stride], 
-                            &pipeline->registry );
+                    // the registry of the previous draws is left untouched
+                    if (!registry || registry_used) {
+                        SrGlobalRegistry* copy = (SrGlobalRegistry*)sr_arena_alloc(&submission->arena, sizeof(SrGlobalRegistry));
+                        *copy = registry ? *registry : pipeline->registry;
+
+                        registry      = copy;
+                        registry_used = false;
+                    }
 
+                    if (command->type == SR_COMMAND_BIND_TEXTURE)
+                        registry->textures[command->slot] = (SrTexture*)command->binding;
+                    else
+                        registry->uniforms[command->slot].data = command->binding;
 
-        // converting to NDC coordinates
-        pos.x /= pos.w;
-        pos.y /= pos.w;
-        pos.z /= pos.w;
+                    break;
+                }
 
+                case SR_COMMAND_CLEAR_COLOR:
+                case SR_COMMAND_CLEAR_DEPTH:
+                    submission->commands[submission->commands_count++] = *command;
+                    break;
 
+                case SR_COMMAND_DRAW: {
+                    if (!registry) {
+                        registry  = (SrGlobalRegistry*)sr_arena_alloc(&submission->arena, sizeof(SrGlobalRegistry));
+                        *registry = pipeline->registry;
+                    }
 
-        // converting from NDC coordintates to the Screen coordinates
-        rm_positions[i].x = (pos.x * 0.5f + 0.5f) * (width); 
-        rm_positions[i].y = (pos.y * 0.5f + 0.5f) * (height);
-        rm_positions[i].z = pos.z;
-        rm_positions[i].w = pos.w;
+                    registry_used = true;
 
+                    SrCommand* draw = &submission->commands[submission->commands_count++];
+                    *draw = *command;
+                    draw->draw.registry = registry;
+                    break;
+                }
+            }
+        }
     }
 
+    return submission;
+}
 
 
-    // rasteration pass
-    for (sr_u32 i = 0; i < vertices_count; i += 3) {
 
-        sr_vec3 idx = sr_get_front_face_indices(pipeline->spec.rasterizer_info.front_face);
-        sr_vec4 p1 = rm_positions[i + (sr_u32)idx.x];
-        sr_vec4 p2 = rm_positions[i + (sr_u32)idx.y];
-        sr_vec4 p3 = rm_positions[i + (sr_u32)idx.z];
+// the draws between two clears. a raster pass bins and rasterizes its
+// triangles in draw order, each with the state of its own pipeline, so
+// the adjacent draws that share a framebuffer and a shading mode can go
+// through the same pass and still give the image of separate draws
+static void sr_run_draws(SrCommand* commands, sr_u32 count) {
+    sr_u32 first = 0;
 
+    while (first < count) {
+        SrPipeline* pipeline = commands[first].draw.pipeline;
+        sr_usize triangles_capacity = 0;
 
-        sr_f32 area = sr_edge_function(p1, p2, p3); 
-        sr_f32 ooa = area == 0 ? 0.001f : 1.0f / area;
+        sr_u32 last = first;
+        while (last < count) {
+            SrPipeline* other = commands[last].draw.pipeline;
 
+            if (other->spec.framebuffer  != pipeline->spec.framebuffer || 
+                other->spec.shading_mode != pipeline->spec.shading_mode)
+                break;
 
-        // face culling
-        if (sr_should_cull(area, pipeline->spec.rasterizer_info.cull_mode))
-            continue;
+            triangles_capacity += commands[last].draw.index_count / 3 * commands[last].draw.instances_count;
+            last += 1;
+        }
 
+        SrRasterPass pass;
+        sr_begin_raster_pass(&pass, pipeline, triangles_capacity);
 
-        // calculating some constants that will be used later to update 
-        // the edge functions
-        sr_f32 dy12 = p1.y - p2.y;    sr_f32 dx21 = p2.x - p1.x; 
-        sr_f32 dy23 = p2.y - p3.y;    sr_f32 dx32 = p3.x - p2.x;
-        sr_f32 dy31 = p3.y - p1.y;    sr_f32 dx13 = p1.x - p3.x;
+        for (sr_u32 i = first; i < last; i++)
+            sr_draw_geometry(&pass, &commands[i].draw);
+
+        sr_end_raster_pass(&pass);
+
+        first = last;
+    }
+}
 
 
-        // getting the bounding box of the triangle 
-        sr_f32 min_x = round(sr_clamp(sr_min(p1.x, sr_min(p2.x, p3.x)) - 0.5f, 0.0f, (sr_f32)width  - 1));
-        sr_f32 min_y = round(sr_clamp(sr_min(p1.y, sr_min(p2.y, p3.y)) - 0.5f, 0.0f, (sr_f32)height - 1));
-        sr_f32 max_x = round(sr_clamp(sr_max(p1.x, sr_max(p2.x, p3.x)) + 0.5f, 0.0f, (sr_f32)width  - 1));
-        sr_f32 max_y = round(sr_clamp(sr_max(p1.y, sr_max(p2.y, p3.y)) + 0.5f, 0.0f, (sr_f32)height - 1));
 
+static void sr_run_submission(SrSubmission* submission) {
+    SrCommand* commands = submission->commands;
+    sr_u32 count = submission->commands_count;
 
+    // the stats of the pipelines cover the whole submission
+    for (sr_u32 i = 0; i < count; i++)
+        if (commands[i].type == SR_COMMAND_DRAW)
+            sr_reset_stats(commands[i].draw.pipeline);
 
-        // pre calculating the edge functions so we update them using DDA 
-        // instead of recalculating them every pixel
-        sr_f32 edge1 = sr_edge_function(p2, p3, sr_vec4 {min_x, min_y, 0.0f, 0.0f});
-        sr_f32 edge2 = sr_edge_function(p3, p1, sr_vec4 {min_x, min_y, 0.0f, 0.0f});
-        sr_f32 edge3 = sr_edge_function(p1, p2, sr_vec4 {min_x, min_y, 0.0f, 0.0f});
+    sr_u32 i = 0;
 
+    while (i < count) {
 
-        for (sr_u32 y = min_y; y <= max_y; y += 1) {
+        // only the last of consecutive clears of the same buffer matters
+        sr_u32 clears_end = i;
+        while (clears_end < count && commands[clears_end].type != SR_COMMAND_DRAW)
+            clears_end++;
 
-            sr_f32 e1 = edge1;
-            sr_f32 e2 = edge2;
-            sr_f32 e3 = edge3;
+        for (sr_u32 c = i; c < clears_end; c++) {
+            bool overridden = false;
 
+            for (sr_u32 n = c + 1; n < clears_end; n++)
+                if (commands[n].type == commands[c].type && commands[n].framebuffer == commands[c].framebuffer)
+                    overridden = true;
 
-            for (sr_u32 x = min_x; x <= max_x; x += 1) {
+            if (overridden)
+                continue;
 
-                if (sr_is_point_inside_polygon(&pipeline->spec.rasterizer_info, e1, e2, e3)) {
+            if (commands[c].type == SR_COMMAND_CLEAR_COLOR)
+                sr_framebuffer_clear_color(commands[c].framebuffer, commands[c].clear_color);
+            else
+                sr_framebuffer_clear_depth(commands[c].framebuffer, commands[c].clear_depth);
+        }
 
-                    // normalizing the barycentric coordinates so we can use
-                    // them to interpolate the attributes 
-                    sr_f32 u = e1 * ooa;
-                    sr_f32 v = e2 * ooa;
-                    sr_f32 w = e3 * ooa;
+        sr_u32 draws_end = clears_end;
+        while (draws_end < count && commands[draws_end].type == SR_COMMAND_DRAW)
+            draws_end++;
 
-                    // inter_pos = p1 * u + p2 * v + p3 * w
-                    sr_vec4 inter_pos = sr_vec4_add(sr_vec4_add(sr_vec4_mul_s(p1, u), 
-                                    sr_vec4_mul_s(p2, v)), sr_vec4_mul_s(p3, w));
+        sr_run_draws(&commands[clears_end], draws_end - clears_end);
 
-                    sr_f32 curr_depth = inter_pos.z;
+        i = draws_end;
+    }
 
-                    if (sr_compute_depth_compare_op(pipeline, curr_depth, x, y)) {
+    SrFence* fence = submission->fence;
 
-                        if (pipeline->spec.depth_info.depth_write_enabled) {
-                            sr_framebuffer_set_depth(pipeline->spec.framebuffer, x, y, curr_depth);
-                        }
+    sr_arena_free(&submission->arena);
+    free(submission);
 
-                        sr_f32 z = u / p1.w + v / p2.w + w / p3.w;
-                        u /= p1.w;
-                        v /= p2.w;
-                        w /= p3.w;
+    if (fence)
+        sr_atomic_fetch_add(&fence->signaled, 1);
+}
 
 
-                        sr_interpolate_variant(current_variant, &variants_ptr[i * variants_stride], 
-                                            variants_stride, u, v, w, z);
 
+#ifdef _WIN32
 
-                        sr_vec4 new_color = pipeline->spec.pixel_shader(current_variant, &pipeline->registry);
+static DWORD WINAPI sr_submission_entry(LPVOID param) {
+    sr_run_submission((SrSubmission*)param);
+    return 0;
+}
 
+#else
 
-                        if (!pipeline->spec.color_blend_info.blend_enabled) {
-                            sr_framebuffer_set_color(pipeline->spec.framebuffer, x, y, new_color);
+static void* sr_submission_entry(void* param) {
+    sr_run_submission((SrSubmission*)param);
+    return NULL;
+}
 
-                        } else {
+#endif
 
-                            sr_vec4 final_color {}; 
-                            sr_vec4 old_color = sr_framebuffer_get_color(pipeline->spec.framebuffer, x, y);
 
-                            SrBlendFactor src_blend_factor = pipeline->spec.color_blend_info.src_blend_factor;
-                            SrBlendFactor dst_blend_factor = pipeline->spec.color_blend_info.dst_blend_factor;
-                            SrBlendOp blend_op             = pipeline->spec.color_blend_info.blend_op;
 
-                            sr_f32* old_c = (sr_f32*)&old_color.x;
-                            sr_f32* new_c = (sr_f32*)&new_color.x;
-                            sr_f32* final_c = (sr_f32*)&final_color.x;
+void sr_submit(SrCommandBuffer* cmds, sr_u32 count, SrFence* fence) {
+    SrSubmission* submission = sr_resolve_commands(cmds, count);
 
-                            for (sr_u32 i = 0; i < 4; i++) {
-                                sr_f32 src = sr_compute_blend_factor(new_c[i], old_c[i], 
-                                                            new_color.w, old_color.w, src_blend_factor);
-                                sr_f32 dst = sr_compute_blend_factor(new_c[i], old_c[i], 
-                                                            new_color.w, old_color.w, dst_blend_factor);
+    if (!fence) {
+        sr_run_submission(submission);
+        return;
+    }
 
-                                final_c[i] = sr_compute_blend_op(src * new_c[i], dst * old_c[i], blend_op);
-                            }
+    // a fence only tracks one submission at a time
+    sr_fence_wait(fence);
 
-                            sr_framebuffer_set_color(pipeline->spec.framebuffer, x, y, final_color);
-                        }
-                    }
-                }
+    fence->signaled   = 0;
+    submission->fence = fence;
 
-                e1 += dy23;
-                e2 += dy31;
-                e3 += dy12;
-            }
+#ifdef _WIN32
+    fence->thread = CreateThread(NULL, 0, sr_submission_entry, submission, 0, NULL);
+    bool started  = fence->thread != NULL;
+#else
+    bool started  = pthread_create(&fence->thread, NULL, sr_submission_entry, submission) == 0;
+#endif
 
-            edge1 += dx32;
-            edge2 += dx13;
-            edge3 += dx21;
-        }  
+    // without a thread the submission runs here and signals the fence
+    // before returning, there's nothing left for sr_fence_wait to join
+    if (!started) {
+        sr_run_submission(submission);
+        return;
     }
 
-    free(rm_positions);
-    free(rm_variants);
-    free(current_variant);
+    fence->pending = true;
+}
+
+
+
+// a fence without a pending submission counts as signaled
+SrFence* sr_fence_create() {
+    SrFence* fence = (SrFence*)malloc(sizeof(SrFence));
+    memset(fence, 0, sizeof(SrFence));
+    fence->signaled = 1;
+
+    return fence;
 }
 
 
 
+bool sr_fence_is_signaled(SrFence* fence) {
+    return sr_atomic_fetch_add(&fence->signaled, 0) != 0;
+}
+
+
+
+void sr_fence_wait(SrFence* fence) {
+    if (!fence->pending)
+        return;
+
+#ifdef _WIN32
+    WaitForSingleObject(fence->thread, INFINITE);
+    CloseHandle(fence->thread);
+#else
+    pthread_join(fence->thread, NULL);
+#endif
+
+    fence->pending = false;
+}
+
+
+
+void sr_fence_destroy(SrFence* fence) {
+    sr_fence_wait(fence);
+    free(fence);
+}
+
+
+
+
 
 
 #endif // __SOFTWARE_RENDERER_IMPLEMENTATION